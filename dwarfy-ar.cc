@@ -0,0 +1,69 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "archive.hh"
+#include "archive-index.hh"
+#include "mapped-file.hh"
+
+//indexes the functions of every object in a static (or thin) archive without extracting it, and
+//looks names up in the merged index
+//with no names, lists the archive's members and what was indexed
+
+namespace {
+
+void index(const std::string& path, const std::vector<std::string>& names, unsigned threads) {
+    elfy::mapped_file mf{path};
+    elfy::archive a{mf.data, path};
+    auto start = std::chrono::steady_clock::now();
+    dwarfy::archive_index index{a, threads};
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (names.empty()) {
+        for (const elfy::archive_member& m: a.members()) {
+            printf("%.*s\t%zu bytes\n", static_cast<int>(m.name.size()), m.name.data(), m.data.size());
+        }
+        printf("%zu members, %zu indexed, %zu functions in %.3fs\n", a.members().size(), index.members(), index.entries().size(), seconds);
+        return;
+    }
+    for (const std::string& name: names) {
+        std::span<const dwarfy::archive_function> found = index.find(name);
+        if (found.empty()) {
+            printf("%s\tnot found\n", name.c_str());
+        }
+        for (const dwarfy::archive_function& f: found) {
+            std::string_view member = a.members()[f.member].name;
+            printf("%s\t%.*s\t0x%lx-0x%lx\n", name.c_str(), static_cast<int>(member.size()), member.data(), f.begin, f.end);
+        }
+    }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    unsigned threads = 0;
+    const char* archive = nullptr;
+    std::vector<std::string> names;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = strtoul(argv[++i], nullptr, 0);
+        } else if (!archive) {
+            archive = argv[i];
+        } else {
+            names.push_back(argv[i]);
+        }
+    }
+    if (!archive) {
+        fprintf(stderr, "usage: %s [--threads N] ARCHIVE [FUNCTION...]\n", argv[0]);
+        return 1;
+    }
+    try {
+        index(archive, names, threads);
+    } catch (std::exception &e) {
+        fprintf(stderr, "error indexing '%s': %s\n", archive, e.what());
+        return 1;
+    }
+    return 0;
+}
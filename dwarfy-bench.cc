@@ -0,0 +1,463 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "elfy.hh"
+#include "dwarfy.hh"
+#include "die-view.hh"
+#include "mapped-file.hh"
+#include "aranges.hh"
+#include "line-table.hh"
+#include "module-set.hh"
+#include "split-dwarf.hh"
+#include "symbol-cache.hh"
+
+//micro benchmarks over a set of fixture binaries, results as JSON on stdout
+//the layout follows Google Benchmark's JSON output so the usual comparison scripts work on it
+
+namespace {
+
+template<typename T>
+void do_not_optimize(const T& v) {
+    asm volatile("" : : "g"(&v) : "memory");
+}
+
+struct result {
+    std::string name;
+    std::string fixture;
+    size_t iterations;
+    double ns_per_iteration;
+    //items processed per iteration (DIEs, lookups, ...), 0 if the iteration is the item
+    size_t items;
+};
+
+double min_seconds = 0.5;
+
+//runs f(iterations) with doubling iteration counts until one run takes at least min_seconds
+result run(const std::string& name, const std::string& fixture, size_t items, const std::function<void(size_t)>& f) {
+    size_t iterations = 1;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        f(iterations);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (seconds >= min_seconds || iterations >= (1ULL << 40)) {
+            fprintf(stderr, "%-24s %-40s %12.1f ns\n", name.c_str(), fixture.c_str(), seconds * 1e9 / iterations);
+            return {name, fixture, iterations, seconds * 1e9 / iterations, items};
+        }
+        //aim straight for the target once there's a usable estimate
+        double estimate = seconds > 0.01 ? min_seconds / seconds * iterations * 1.2 : iterations * 10.0;
+        iterations = std::max<size_t>(iterations * 2, estimate);
+    }
+}
+
+//every DIE of every unit, through dwarf::read_attributes, keeping their offsets if asked
+size_t walk_dies(dwarfy::dwarf& d, std::vector<uint64_t>* offsets = nullptr) {
+    size_t dies = 0;
+    for (uint64_t offset: dwarfy::unit_offsets(d.debug_info, d.initial_endianness)) {
+        span_reader r {d.debug_info.subspan(offset)};
+        r.file_endianness = d.initial_endianness;
+        dwarfy::compilation_unit_header cu;
+        r & cu;
+        const std::byte* end = d.debug_info.data() + offset + cu.unit_length + cu.unit_length.size();
+        while (r.data.data() < end) {
+            if (offsets) {
+                offsets->push_back(r.data.data() - d.debug_info.data());
+            }
+            dwarfy::debug_abbrev_entry dae;
+            std::vector<dwarfy::attribute> attributes = d.read_attributes(r, cu, dae);
+            dies += !dae.is_last();
+            do_not_optimize(attributes.size());
+        }
+    }
+    return dies;
+}
+
+std::vector<uint64_t> text_addresses(elfy::elf& e, size_t count) {
+    std::optional<elfy::section_header> text = e.get_section_by_name(".text");
+    std::vector<uint64_t> addresses;
+    if (!text) {
+        return addresses;
+    }
+    std::mt19937_64 rng{1};
+    uint64_t size = text->data(e).size();
+    for (size_t i = 0; i < count && size > 0; i++) {
+        addresses.push_back(text->address() + rng() % size);
+    }
+    return addresses;
+}
+
+void bench_fixture(const std::string& path, std::vector<result>& results) {
+    elfy::mapped_file mf{path};
+
+    results.push_back(run("elf_open", path, 0, [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            elfy::mapped_file f{path};
+            elfy::elf e{f.data};
+            do_not_optimize(e.machine());
+        }
+    }));
+
+    elfy::elf e{mf.data};
+    const std::string_view names[] = {".debug_info", ".debug_abbrev", ".debug_line", ".debug_str", ".text", ".symtab"};
+    results.push_back(run("section_lookup", path, std::size(names), [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            for (std::string_view name: names) {
+                do_not_optimize(e.get_section_by_name(name));
+            }
+        }
+    }));
+
+    //the first dwarf over each elf decompresses its compressed sections, which dwarf_open includes
+    results.push_back(run("dwarf_open", path, 0, [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            elfy::elf fresh{mf.data};
+            dwarfy::dwarf d{fresh};
+            do_not_optimize(d.debug_info.size());
+        }
+    }));
+
+    dwarfy::dwarf d{e};
+    if (d.debug_info.empty()) {
+        fprintf(stderr, "'%s' has no .debug_info, skipping the DWARF benchmarks\n", path.c_str());
+        return;
+    }
+
+    size_t units = 0;
+    for (auto it = d.cu_iter(); it != it.end(); ++it) {
+        units++;
+    }
+    results.push_back(run("cu_iteration", path, units, [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            size_t count = 0;
+            for (auto it = d.cu_iter(); it != it.end(); ++it) {
+                count++;
+            }
+            do_not_optimize(count);
+        }
+    }));
+
+    std::vector<uint64_t> die_offsets;
+    size_t dies = walk_dies(d, &die_offsets);
+    results.push_back(run("die_walk", path, dies, [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            do_not_optimize(walk_dies(d));
+        }
+    }));
+
+    //the same DIEs through visit, decoding only a subprogram's name and address range
+    results.push_back(run("die_visit", path, dies, [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            size_t count = 0;
+            for (auto it = d.cu_iter(); it != it.end(); ++it) {
+                dwarfy::visit<dwarfy::dw_tag::subprogram>(it, dwarfy::projection<dwarfy::dw_at::name, dwarfy::dw_at::low_pc, dwarfy::dw_at::high_pc>, [&](const auto& die) {
+                    count += die.template get<dwarfy::dw_at::low_pc>() != nullptr;
+                });
+            }
+            do_not_optimize(count);
+        }
+    }));
+
+    //random access to DIEs anywhere in .debug_info, as following DW_FORM_ref_addr does
+    std::shuffle(die_offsets.begin(), die_offsets.end(), std::mt19937_64{1});
+    die_offsets.resize(std::min<size_t>(die_offsets.size(), 4096));
+    d.units();
+    results.push_back(run("die_at", path, die_offsets.size(), [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            for (uint64_t offset: die_offsets) {
+                do_not_optimize(d.die_at(offset).attributes.size());
+            }
+        }
+    }));
+
+    //abbreviation codes of the first unit, looked up in a shuffled order
+    {
+        auto cu_it = d.cu_iter();
+        dwarfy::compilation_unit_header cu = *cu_it;
+        std::vector<uint64_t> codes;
+        span_reader ar {d.debug_abbrev.subspan(cu.debug_abbrev_offset)};
+        ar.file_endianness = d.initial_endianness;
+        while (!ar.data.empty()) {
+            dwarfy::debug_abbrev_entry dae;
+            ar & dae;
+            if (dae.is_last()) {
+                break;
+            }
+            codes.push_back(dae.abbrev_code);
+            while (true) {
+                dwarfy::attribute a;
+                ar & a.name & a.form;
+                if (a.form == dwarfy::dw_form::implicit_const) {
+                    sleb128 v;
+                    ar & v;
+                }
+                if (a.is_last()) {
+                    break;
+                }
+            }
+        }
+        std::shuffle(codes.begin(), codes.end(), std::mt19937_64{1});
+        results.push_back(run("abbrev_lookup", path, codes.size(), [&](size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                for (uint64_t code: codes) {
+                    do_not_optimize(d.find_abbrev(uleb128{code}, cu));
+                }
+            }
+        }));
+    }
+
+    std::vector<uint64_t> pcs = text_addresses(e, 4096);
+
+    results.push_back(run("aranges_build", path, 0, [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            dwarfy::cu_aranges a{d};
+            do_not_optimize(a.size());
+        }
+    }));
+    dwarfy::cu_aranges aranges{d};
+    results.push_back(run("aranges_lookup", path, pcs.size(), [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            for (uint64_t pc: pcs) {
+                do_not_optimize(aranges.find(pc));
+            }
+        }
+    }));
+
+    std::optional<uint64_t> first_cu = pcs.empty() ? std::nullopt : aranges.find(pcs.front());
+    if (first_cu) {
+        results.push_back(run("line_table_decode", path, 0, [&](size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                do_not_optimize(dwarfy::read_line_table(d, *first_cu)->rows.size());
+            }
+        }));
+    }
+    //pc to line through aranges, with each unit's table decoded once
+    std::unordered_map<uint64_t, dwarfy::line_table> tables;
+    for (uint64_t pc: pcs) {
+        if (std::optional<uint64_t> cu = aranges.find(pc); cu && !tables.contains(*cu)) {
+            if (std::optional<dwarfy::line_table> t = dwarfy::read_line_table(d, *cu)) {
+                tables.emplace(*cu, std::move(*t));
+            }
+        }
+    }
+    results.push_back(run("line_table_lookup", path, pcs.size(), [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            for (uint64_t pc: pcs) {
+                std::optional<uint64_t> cu = aranges.find(pc);
+                auto it = cu ? tables.find(*cu) : tables.end();
+                do_not_optimize(it != tables.end() ? it->second.find(pc) : nullptr);
+            }
+        }
+    }));
+}
+
+//a stripped binary whose DWARF is in a separate, compressed debug file: the resolver's combined dwarf
+//must still read the debug file's decompressed sections after open returns
+void check_debug_file(const std::string& path) {
+    dwarfy::debug_file_resolver resolver;
+    dwarfy::debug_file_pair files = resolver.open(path);
+    if (!files.debug) {
+        throw std::runtime_error("no separate debug file found for " + path);
+    }
+    elfy::elf de{files.debug->data};
+    dwarfy::dwarf direct{de};
+    size_t combined = walk_dies(files.d);
+    size_t expected = walk_dies(direct);
+    if (combined != expected || expected == 0) {
+        throw std::runtime_error("combined dwarf of " + path + " has " + std::to_string(combined) + " DIEs, its debug file " + std::to_string(expected));
+    }
+    fprintf(stderr, "%-24s %-40s %12zu DIEs\n", "debug_file_check", path.c_str(), combined);
+}
+
+//a -gsplit-dwarf binary: every skeleton unit's split half has to open, and every function it describes
+//has to start at a .symtab symbol, which only happens when its DW_FORM_addrx operands are read from
+//the skeleton's DW_AT_addr_base
+void check_split(const std::string& path) {
+    elfy::mapped_file mf{path};
+    elfy::elf e{mf.data};
+    dwarfy::dwarf d{e};
+    dwarfy::split_dwarf split{d};
+    size_t functions = 0;
+    for (size_t i = 0; i < split.skeleton_units().size(); i++) {
+        std::shared_ptr<dwarfy::dwarf> half = split.unit(i);
+        if (!half) {
+            throw std::runtime_error("can't find the split unit " + split.skeleton_units()[i].dwo_name);
+        }
+        dwarfy::function_index index{*half};
+        for (const dwarfy::function_range& f: index.ranges()) {
+            std::optional<elfy::symbol> sym = e.find_symbol(f.begin);
+            if (!sym || sym->value != f.begin) {
+                throw std::runtime_error("split unit " + split.skeleton_units()[i].dwo_name + " puts " + std::string{f.name} + " at " + std::to_string(f.begin) + ", which isn't a symbol");
+            }
+        }
+        functions += index.size();
+    }
+    if (functions == 0) {
+        throw std::runtime_error("no functions in the split units of " + path);
+    }
+    fprintf(stderr, "%-24s %-40s %12zu functions\n", "split_check", path.c_str(), functions);
+}
+
+//profile-like lookups: distinct pcs drawn with Zipf(1) weights, so a few thousand make up most of them
+std::vector<uint64_t> zipf_addresses(const std::vector<uint64_t>& pcs, size_t count) {
+    std::vector<double> cdf;
+    double sum = 0;
+    for (size_t rank = 1; rank <= pcs.size(); rank++) {
+        sum += 1.0 / rank;
+        cdf.push_back(sum);
+    }
+    std::mt19937_64 rng{1};
+    std::uniform_real_distribution<double> u{0, sum};
+    std::vector<uint64_t> addresses;
+    for (size_t i = 0; i < count; i++) {
+        size_t rank = std::lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin();
+        addresses.push_back(pcs[std::min(rank, pcs.size() - 1)]);
+    }
+    return addresses;
+}
+
+//pc to function and line, resolved every time and through a symbol_cache smaller than the set of pcs
+void bench_symbol_cache(const std::string& path, std::vector<result>& results) {
+    dwarfy::debug_file_resolver resolver;
+    std::shared_ptr<dwarfy::loaded_module> m = dwarfy::open_module(resolver, path);
+    dwarfy::build_function_index(*m);
+    std::vector<uint64_t> pcs = text_addresses(m->files.d.elf, 1 << 16);
+    if (pcs.empty()) {
+        return;
+    }
+    std::vector<uint64_t> addresses = zipf_addresses(pcs, 1 << 16);
+
+    dwarfy::string_pool strings;
+    results.push_back(run("symbolize_zipf", path, addresses.size(), [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            for (uint64_t pc: addresses) {
+                do_not_optimize(dwarfy::resolve_frame(*m, pc, strings));
+            }
+        }
+    }));
+    dwarfy::symbol_cache cache {4096};
+    results.push_back(run("symbol_cache_zipf", path, addresses.size(), [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            for (uint64_t pc: addresses) {
+                do_not_optimize(cache.resolve(*m, pc));
+            }
+        }
+    }));
+    dwarfy::symbol_cache_stats stats = cache.stats();
+    fprintf(stderr, "%-24s %-40s %12.1f %% hits, %lu evictions\n", "symbol_cache_zipf", path.c_str(), stats.hit_rate() * 100, stats.evictions);
+}
+
+void bench_leb128(std::vector<result>& results) {
+    //a mix of lengths like real .debug_info: mostly short, some long
+    std::vector<std::byte> buffer;
+    std::mt19937_64 rng{1};
+    size_t count = 1 << 16;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t v = rng() >> (rng() % 4 == 0 ? 8 : 57);
+        do {
+            uint8_t b = v & 0x7f;
+            v >>= 7;
+            buffer.push_back(static_cast<std::byte>(b | (v ? 0x80 : 0)));
+        } while (v);
+    }
+    results.push_back(run("leb128_decode", "", count, [&](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            span_reader r {buffer};
+            uint64_t sum = 0;
+            while (!r.data.empty()) {
+                uleb128 v;
+                r & v;
+                sum += v;
+            }
+            do_not_optimize(sum);
+        }
+    }));
+}
+
+void print_json(const std::vector<result>& results) {
+    char date[64];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    printf("{\n");
+    printf("  \"context\": {\n");
+    printf("    \"date\": \"%s\",\n", date);
+    printf("    \"executable\": \"dwarfy-bench\",\n");
+    printf("    \"num_cpus\": %u\n", std::thread::hardware_concurrency());
+    printf("  },\n");
+    printf("  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const result& r = results[i];
+        std::string name = r.name;
+        if (!r.fixture.empty()) {
+            name += "/" + r.fixture.substr(r.fixture.find_last_of('/') + 1);
+        }
+        double items = r.items ? r.items : 1;
+        printf("    {\"name\": \"%s\", \"run_type\": \"iteration\", \"iterations\": %zu, \"real_time\": %.3f, \"cpu_time\": %.3f, \"time_unit\": \"ns\", \"items_per_second\": %.1f}%s\n",
+            name.c_str(), r.iterations, r.ns_per_iteration, r.ns_per_iteration, items * 1e9 / r.ns_per_iteration, i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> fixtures;
+    std::vector<std::string> debug_file_fixtures;
+    std::vector<std::string> split_fixtures;
+    for (argv++, argc--; argc > 0; argv++, argc--) {
+        if (!strcmp(*argv, "--min-time") && argc > 1) {
+            min_seconds = atof(*++argv);
+            argc--;
+        } else if (!strcmp(*argv, "--debug-file") && argc > 1) {
+            debug_file_fixtures.push_back(*++argv);
+            argc--;
+        } else if (!strcmp(*argv, "--split") && argc > 1) {
+            split_fixtures.push_back(*++argv);
+            argc--;
+        } else {
+            fixtures.push_back(*argv);
+        }
+    }
+
+    std::vector<result> results;
+    bench_leb128(results);
+    for (const std::string& fixture: fixtures) {
+        try {
+            bench_fixture(fixture, results);
+            bench_symbol_cache(fixture, results);
+        } catch (std::runtime_error &e) {
+            fprintf(stderr, "error benchmarking '%s': %s\n", fixture.c_str(), e.what());
+            return 1;
+        } catch (std::invalid_argument &e) {
+            fprintf(stderr, "error benchmarking '%s': %s\n", fixture.c_str(), e.what());
+            return 1;
+        }
+    }
+    for (const std::string& fixture: debug_file_fixtures) {
+        try {
+            check_debug_file(fixture);
+            bench_symbol_cache(fixture, results);
+        } catch (std::runtime_error &e) {
+            fprintf(stderr, "error benchmarking '%s': %s\n", fixture.c_str(), e.what());
+            return 1;
+        }
+    }
+    for (const std::string& fixture: split_fixtures) {
+        try {
+            check_split(fixture);
+        } catch (std::runtime_error &e) {
+            fprintf(stderr, "error checking '%s': %s\n", fixture.c_str(), e.what());
+            return 1;
+        }
+    }
+    print_json(results);
+    return 0;
+}
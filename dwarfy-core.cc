@@ -0,0 +1,90 @@
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "core-file.hh"
+#include "mapped-file.hh"
+#include "module-set.hh"
+
+//prints the modules a core file's process had mapped, with their build-ids, and the function each
+//thread was in, symbolized in one batch through the modules' DWARF
+//the core is mapped, not read, so multi-GB cores cost no more than their notes
+
+namespace {
+
+void print_core(const std::string& path, const std::vector<std::string>& debug_directories) {
+    elfy::mapped_file mf{path};
+    elfy::elf e{mf.data};
+    elfy::core_file core{e};
+
+    printf("mappings:\n");
+    for (const elfy::core_mapping& m: core.mappings()) {
+        printf("  0x%016lx-0x%016lx 0x%08lx %-40s %.*s\n", m.start, m.end, m.file_offset, m.build_id.empty() ? "-" : m.build_id.c_str(), static_cast<int>(m.path.size()), m.path.data());
+    }
+
+    dwarfy::module_set modules{dwarfy::core_modules(core)};
+    if (!debug_directories.empty()) {
+        modules.resolver.debug_directories = debug_directories;
+    }
+    std::vector<uint64_t> pcs;
+    for (const elfy::core_thread& t: core.threads()) {
+        pcs.push_back(t.pc);
+    }
+    //open every module with a pc in it first and let their DWARF indexes build, rather than resolving
+    //through the symbol tables while they're in progress
+    std::set<size_t> used;
+    for (uint64_t pc: pcs) {
+        if (std::optional<size_t> i = modules.find_module(pc)) {
+            used.insert(*i);
+        }
+    }
+    for (size_t i: used) {
+        modules.module(i);
+    }
+    modules.wait_for_indexes();
+
+    std::vector<dwarfy::symbolized_frame> frames = modules.symbolize(pcs);
+    printf("threads:\n");
+    for (size_t i = 0; i < frames.size(); i++) {
+        const elfy::core_thread& t = core.threads()[i];
+        const dwarfy::symbolized_frame& f = frames[i];
+        printf("  %u pc 0x%016lx sp 0x%016lx", t.pid, t.pc, t.sp);
+        if (f.module >= 0) {
+            printf(" %s", modules.modules()[f.module].path.c_str());
+        }
+        if (!f.function.empty()) {
+            printf(" %s+0x%lx", f.function.c_str(), f.offset);
+        }
+        printf("\n");
+    }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> debug_directories;
+    const char* core = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--debug-dir") && i + 1 < argc) {
+            debug_directories.push_back(argv[++i]);
+        } else if (!core) {
+            core = argv[i];
+        } else {
+            fprintf(stderr, "unexpected argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!core) {
+        fprintf(stderr, "usage: %s [--debug-dir DIR]... CORE\n", argv[0]);
+        return 1;
+    }
+    try {
+        print_core(core, debug_directories);
+    } catch (std::exception &e) {
+        fprintf(stderr, "error reading '%s': %s\n", core, e.what());
+        return 1;
+    }
+    return 0;
+}
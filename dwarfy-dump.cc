@@ -0,0 +1,369 @@
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "elfy.hh"
+#include "dwarfy.hh"
+#include "mapped-file.hh"
+#include "parallel.hh"
+
+//dumps .debug_info in the style of llvm-dwarfdump --debug-info
+//units are formatted in parallel into their own buffers and written out in order in batches, so
+//memory stays bounded on large binaries and nothing is flushed per line
+
+namespace {
+
+struct filter {
+    std::vector<dwarfy::dw_tag> tags;
+    std::vector<std::string> names;
+    uint64_t cu_begin = 0;
+    uint64_t cu_end = UINT64_MAX;
+    //DIEs deeper than this (the unit DIE is depth 0) are skipped along with their subtrees
+    size_t max_depth = SIZE_MAX;
+
+    bool matches_everything() const {
+        return tags.empty() && names.empty();
+    }
+};
+
+void append_hex(std::string& out, uint64_t v, int width = 0) {
+    char buffer[20];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), v, 16);
+    out += "0x";
+    for (int i = end - buffer; i < width; i++) {
+        out += '0';
+    }
+    out.append(buffer, end);
+}
+
+void append_decimal(std::string& out, int64_t v) {
+    char buffer[24];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), v);
+    out.append(buffer, end);
+}
+
+void append_bytes(std::string& out, std::span<std::byte> bytes) {
+    static const char digits[] = "0123456789abcdef";
+    out += '<';
+    for (size_t i = 0; i < bytes.size(); i++) {
+        if (i) {
+            out += ' ';
+        }
+        uint8_t b = static_cast<uint8_t>(bytes[i]);
+        out += "0x";
+        out += digits[b >> 4];
+        out += digits[b & 0xf];
+    }
+    out += '>';
+}
+
+//DW_TAG_name, or DW_TAG_0x4109 style for values without a name
+void append_name(std::string& out, std::string_view prefix, std::string_view name, uint64_t value) {
+    out += prefix;
+    if (name.empty()) {
+        append_hex(out, value, 4);
+    } else {
+        out += name;
+    }
+}
+
+struct unit_state {
+    const dwarfy::dwarf& d;
+    uint64_t offset;
+    dwarfy::compilation_unit_header cu;
+    //the header's context, with str_offsets_base filled in from the unit DIE
+    dwarfy::unit_context context;
+};
+
+void append_value(std::string& out, unit_state& u, const dwarfy::attribute& a) {
+    using dwarfy::dw_form;
+    std::endian endianness = u.d.initial_endianness;
+    switch (a.form) {
+        case dw_form::string:
+        case dw_form::strp:
+        case dw_form::line_strp:
+        case dw_form::strx:
+        case dw_form::strx1:
+        case dw_form::strx2:
+        case dw_form::strx3:
+        case dw_form::strx4:
+        case dw_form::GNU_str_index:
+            out += '"';
+            out += u.d.read_string(a, u.context);
+            out += '"';
+            break;
+        case dw_form::ref1:
+        case dw_form::ref2:
+        case dw_form::ref4:
+        case dw_form::ref8:
+        case dw_form::ref_udata:
+            append_hex(out, u.offset + a.unsigned_value(endianness), 8);
+            break;
+        case dw_form::ref_addr:
+        case dw_form::sec_offset:
+            append_hex(out, a.unsigned_value(endianness), 8);
+            break;
+        case dw_form::addr:
+        case dw_form::ref_sig8:
+            append_hex(out, a.unsigned_value(endianness), 16);
+            break;
+        case dw_form::flag:
+        case dw_form::flag_present:
+            out += a.unsigned_value(endianness) ? "true" : "false";
+            break;
+        case dw_form::sdata:
+        case dw_form::implicit_const:
+            append_decimal(out, a.signed_value(endianness));
+            break;
+        case dw_form::data1:
+        case dw_form::data2:
+        case dw_form::data4:
+        case dw_form::data8:
+        case dw_form::udata:
+            append_hex(out, a.unsigned_value(endianness), a.data.size() * 2);
+            break;
+        case dw_form::addrx:
+        case dw_form::addrx1:
+        case dw_form::addrx2:
+        case dw_form::addrx3:
+        case dw_form::addrx4:
+        case dw_form::GNU_addr_index:
+        case dw_form::loclistx:
+        case dw_form::rnglistx:
+            out += "indexed (";
+            append_hex(out, a.unsigned_value(endianness), 8);
+            out += ')';
+            break;
+        default:
+            append_bytes(out, a.data);
+            break;
+    }
+}
+
+//the unit's DIEs that pass the filter, each with its subtree, appended to out
+void dump_unit(std::string& out, const dwarfy::dwarf& d, uint64_t offset, const filter& f) {
+    span_reader r {d.debug_info.subspan(offset)};
+    r.file_endianness = d.initial_endianness;
+    unit_state u {d, offset, {}, {}};
+    r & u.cu;
+    u.context = u.cu.context;
+    r = u.context.reader(r.data);
+    const std::byte* end = d.debug_info.data() + offset + u.cu.unit_length + u.cu.unit_length.size();
+    size_t start_size = out.size();
+    bool any = false;
+
+    std::vector<dwarfy::attribute> attributes;
+    size_t depth = 0;
+    //depth of the DIE whose subtree is being printed, SIZE_MAX when there isn't one
+    size_t printing = SIZE_MAX;
+    while (r.data.data() < end) {
+        uint64_t die_offset = r.data.data() - d.debug_info.data();
+        uleb128 code;
+        r & code;
+        if (code == 0) {
+            if (depth == 0) {
+                //padding after the unit DIE's children
+                continue;
+            }
+            depth--;
+            if (printing != SIZE_MAX) {
+                if (depth <= f.max_depth) {
+                    append_hex(out, die_offset, 8);
+                    out += ": ";
+                    out.append(2 * depth, ' ');
+                    out += "NULL\n\n";
+                }
+                if (depth == printing) {
+                    printing = SIZE_MAX;
+                }
+            }
+            continue;
+        }
+        span_reader ar {d.debug_abbrev.subspan(d.find_abbrev(code, u.cu))};
+        ar.file_endianness = d.initial_endianness;
+        dwarfy::debug_abbrev_entry dae;
+        ar & dae;
+        attributes.clear();
+        std::optional<uint64_t> sibling;
+        while (true) {
+            dwarfy::attribute a;
+            read(r, ar, a);
+            if (a.is_last()) {
+                break;
+            }
+            if (a.name == dwarfy::dw_at::sibling) {
+                sibling = u.offset + a.unsigned_value(d.initial_endianness);
+            } else if (a.name == dwarfy::dw_at::str_offsets_base && depth == 0) {
+                u.context.str_offsets_base = a.unsigned_value(d.initial_endianness);
+            }
+            attributes.push_back(a);
+        }
+        bool children = dae.debug_info_sibling == dwarfy::dw_children::yes;
+
+        if (depth > f.max_depth) {
+            //below the depth limit, in a subtree without a DW_AT_sibling to jump over it
+            if (children) {
+                depth++;
+            }
+            continue;
+        }
+
+        bool matched = printing != SIZE_MAX || f.matches_everything();
+        if (!matched) {
+            bool tag_ok = f.tags.empty() || std::find(f.tags.begin(), f.tags.end(), dae.tag) != f.tags.end();
+            bool name_ok = f.names.empty();
+            for (const dwarfy::attribute& a: attributes) {
+                if (!name_ok && (a.name == dwarfy::dw_at::name || a.name == dwarfy::dw_at::linkage_name)) {
+                    std::string_view name = d.read_string(a, u.context);
+                    name_ok = std::find(f.names.begin(), f.names.end(), name) != f.names.end();
+                }
+            }
+            matched = tag_ok && name_ok;
+            if (matched && children) {
+                printing = depth;
+            }
+        }
+        if (matched) {
+            any = true;
+            append_hex(out, die_offset, 8);
+            out += ": ";
+            out.append(2 * depth, ' ');
+            append_name(out, "DW_TAG_", to_string_view(dae.tag), static_cast<uint64_t>(dae.tag));
+            out += '\n';
+            for (const dwarfy::attribute& a: attributes) {
+                out.append(12 + 2 * depth, ' ');
+                append_name(out, "DW_AT_", to_string_view(a.name), static_cast<uint64_t>(a.name));
+                out += "\t(";
+                append_value(out, u, a);
+                out += ")\n";
+            }
+            out += '\n';
+        }
+        if (children && depth == f.max_depth && sibling && *sibling > die_offset && d.debug_info.data() + *sibling <= end) {
+            //the children are all past the depth limit: jump straight to the sibling
+            r.data = d.debug_info.subspan(*sibling, end - (d.debug_info.data() + *sibling));
+            if (printing == depth) {
+                printing = SIZE_MAX;
+            }
+        } else if (children) {
+            depth++;
+        }
+    }
+
+    if (any) {
+        std::string header;
+        append_hex(header, offset, 8);
+        header += ": Compile Unit: length = ";
+        append_hex(header, u.cu.unit_length, 8);
+        header += ", version = ";
+        append_hex(header, u.cu.version, 4);
+        header += ", abbr_offset = ";
+        append_hex(header, u.cu.debug_abbrev_offset, 4);
+        header += ", addr_size = ";
+        append_hex(header, u.cu.address_size, 2);
+        header += "\n\n";
+        out.insert(start_size, header);
+    }
+}
+
+void write_all(const std::string& s) {
+    const char* p = s.data();
+    size_t left = s.size();
+    while (left > 0) {
+        ssize_t n = write(STDOUT_FILENO, p, left);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("error writing output: "s + strerror(errno));
+        }
+        p += n;
+        left -= n;
+    }
+}
+
+void dump(const std::string& path, const filter& f, unsigned threads) {
+    elfy::mapped_file mf{path};
+    elfy::elf e{mf.data};
+    dwarfy::dwarf d{e};
+
+    std::vector<uint64_t> units;
+    for (uint64_t offset: dwarfy::unit_offsets(d.debug_info, d.initial_endianness)) {
+        if (offset >= f.cu_begin && offset <= f.cu_end) {
+            units.push_back(offset);
+        }
+    }
+
+    //the read paths are const and share one abbreviation cache, so the workers all read through d
+    threads = dwarfy::parallel_threads(threads);
+    std::string header = path + ":\tfile format ELF\n\n.debug_info contents:\n";
+    write_all(header);
+    size_t batch = 64 * threads;
+    std::vector<std::string> buffers(batch);
+    for (size_t first = 0; first < units.size(); first += batch) {
+        size_t count = std::min(batch, units.size() - first);
+        dwarfy::parallel_for(count, 1, threads, [&](unsigned worker, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                buffers[i].clear();
+                dump_unit(buffers[i], d, units[first + i], f);
+            }
+        });
+        //one write per batch, with the buffers kept around (and their capacity) for the next
+        std::string joined;
+        for (size_t i = 0; i < count; i++) {
+            joined += buffers[i];
+        }
+        write_all(joined);
+    }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    filter f;
+    unsigned threads = 0;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--tag") && i + 1 < argc) {
+            std::optional<dwarfy::dw_tag> tag = dwarfy::tag_from_string(argv[++i]);
+            if (!tag) {
+                fprintf(stderr, "unknown tag '%s'\n", argv[i]);
+                return 1;
+            }
+            f.tags.push_back(*tag);
+        } else if (!strcmp(argv[i], "--name") && i + 1 < argc) {
+            f.names.push_back(argv[++i]);
+        } else if (!strcmp(argv[i], "--cu") && i + 1 < argc) {
+            //a unit offset, or an inclusive BEGIN-END range of them
+            char* rest;
+            f.cu_begin = strtoull(argv[++i], &rest, 0);
+            f.cu_end = *rest == '-' ? strtoull(rest + 1, nullptr, 0) : f.cu_begin;
+        } else if (!strcmp(argv[i], "--depth") && i + 1 < argc) {
+            f.max_depth = strtoull(argv[++i], nullptr, 0);
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = strtoul(argv[++i], nullptr, 0);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        fprintf(stderr, "usage: %s [--tag TAG]... [--name NAME]... [--cu OFFSET[-OFFSET]] [--depth N] [--threads N] FILE...\n", argv[0]);
+        return 1;
+    }
+    for (const std::string& file: files) {
+        try {
+            dump(file, f, threads);
+        } catch (std::runtime_error &e) {
+            fprintf(stderr, "error dumping '%s': %s\n", file.c_str(), e.what());
+            return 1;
+        } catch (std::invalid_argument &e) {
+            fprintf(stderr, "error dumping '%s': %s\n", file.c_str(), e.what());
+            return 1;
+        }
+    }
+    return 0;
+}
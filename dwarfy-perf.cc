@@ -0,0 +1,134 @@
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "mapped-file.hh"
+#include "perf-stacks.hh"
+
+//folded stacks from perf.data files, for flamegraph.pl, in place of perf script | stackcollapse-perf.pl
+//with --bench, times folding each file from a cold module cache against perf script -i on the same
+//file (if --perf is given) and reports both as JSON, in the layout dwarfy-bench uses
+
+namespace {
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//wall time of perf script with its output discarded, the cost of the usual pipeline's first stage
+double time_perf_script(const std::string& perf, const std::string& path) {
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, 1);
+        dup2(null, 2);
+        execlp(perf.c_str(), perf.c_str(), "script", "-i", path.c_str(), nullptr);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error("'" + perf + " script -i " + path + "' failed");
+    }
+    return seconds_since(start);
+}
+
+struct options {
+    unsigned threads = 0;
+    std::vector<std::string> debug_directories;
+    bool bench = false;
+    std::string perf;
+    double min_time = 1;
+};
+
+dwarfy::folded_stacks fold(const std::string& path, const options& o) {
+    elfy::mapped_file mf{path};
+    dwarfy::perf_data perf{mf.data};
+    dwarfy::module_cache cache;
+    if (!o.debug_directories.empty()) {
+        cache.resolver.debug_directories = o.debug_directories;
+    }
+    return dwarfy::fold_perf_samples(perf, cache, o.threads);
+}
+
+void bench(const std::vector<std::string>& paths, const options& o) {
+    printf("{\n  \"benchmarks\": [\n");
+    bool first = true;
+    auto report = [&](const char* name, const std::string& path, size_t iterations, double seconds, uint64_t samples) {
+        fprintf(stderr, "%-24s %-40s %10.3f s %12.0f samples/s\n", name, path.c_str(), seconds / iterations, samples * iterations / seconds);
+        printf("%s    {\"name\": \"%s/%s\", \"iterations\": %zu, \"real_time\": %.1f, \"time_unit\": \"ns\", \"items_per_second\": %.1f}",
+            first ? "" : ",\n", name, path.c_str(), iterations, seconds * 1e9 / iterations, samples * iterations / seconds);
+        first = false;
+    };
+    for (const std::string& path: paths) {
+        uint64_t samples = 0;
+        size_t iterations = 0;
+        auto start = std::chrono::steady_clock::now();
+        do {
+            samples = fold(path, o).samples;
+            iterations++;
+        } while (seconds_since(start) < o.min_time);
+        double ours = seconds_since(start) / iterations;
+        report("fold_perf_samples", path, iterations, ours * iterations, samples);
+        if (!o.perf.empty()) {
+            iterations = 0;
+            start = std::chrono::steady_clock::now();
+            double theirs = 0;
+            do {
+                theirs += time_perf_script(o.perf, path);
+                iterations++;
+            } while (seconds_since(start) < o.min_time);
+            report("perf_script", path, iterations, theirs, samples);
+            fprintf(stderr, "%-24s %-40s %10.2fx\n", "speedup", path.c_str(), theirs / iterations / ours);
+        }
+    }
+    printf("\n  ]\n}\n");
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    options o;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            o.threads = std::stoul(argv[++i]);
+        } else if (!strcmp(argv[i], "--debug-dir") && i + 1 < argc) {
+            o.debug_directories.push_back(argv[++i]);
+        } else if (!strcmp(argv[i], "--bench")) {
+            o.bench = true;
+        } else if (!strcmp(argv[i], "--perf") && i + 1 < argc) {
+            o.perf = argv[++i];
+        } else if (!strcmp(argv[i], "--min-time") && i + 1 < argc) {
+            o.min_time = std::stod(argv[++i]);
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        fprintf(stderr, "usage: %s [--threads N] [--debug-dir DIR]... [--bench [--perf PERF] [--min-time S]] PERF_DATA...\n", argv[0]);
+        return 1;
+    }
+    try {
+        if (o.bench) {
+            bench(paths, o);
+            return 0;
+        }
+        for (const std::string& path: paths) {
+            dwarfy::folded_stacks folded = fold(path, o);
+            for (const dwarfy::folded_stack& s: folded.stacks) {
+                printf("%s %lu\n", s.stack.c_str(), s.count);
+            }
+        }
+    } catch (std::exception &e) {
+        fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
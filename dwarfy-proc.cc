@@ -0,0 +1,157 @@
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "process-maps.hh"
+
+//symbolizes where each thread of a running process is blocked, from /proc/<pid>/task/*/syscall,
+//through the process's maps; with --count the maps are refreshed each round and only the modules
+//mapped or unmapped since (dlopen, dlclose) are printed and opened
+//given a command instead of a pid, runs it and samples it until it exits or the rounds are done
+//with --expect, fails unless some thread was symbolized to a function whose name contains the text
+
+namespace {
+
+struct thread_pc {
+    pid_t tid;
+    uint64_t pc;
+};
+
+//"nr arg1 ... arg6 sp pc" for a thread in a syscall, "-1 sp pc" when blocked otherwise, "running"
+//when it's on a cpu, where it has no stable pc
+std::vector<thread_pc> blocked_threads(pid_t pid) {
+    std::vector<thread_pc> threads;
+    std::error_code ec;
+    for (const auto& entry: std::filesystem::directory_iterator{"/proc/" + std::to_string(pid) + "/task", ec}) {
+        std::ifstream f{entry.path() / "syscall"};
+        std::vector<std::string> fields;
+        std::string field;
+        while (f >> field) {
+            fields.push_back(field);
+        }
+        if (fields.size() < 3) {
+            continue;
+        }
+        threads.push_back({static_cast<pid_t>(std::stol(entry.path().filename())), std::stoull(fields.back(), nullptr, 16)});
+    }
+    return threads;
+}
+
+//true if any thread's function name contains expect
+bool print_round(dwarfy::process_modules& process, const dwarfy::process_modules::changes& c, const std::string& expect) {
+    for (uint64_t start: c.removed) {
+        printf("- 0x%016lx\n", start);
+    }
+    for (uint64_t start: c.added) {
+        auto i = process.find_module(start);
+        const dwarfy::process_modules::module& m = process.modules()[*i];
+        printf("+ 0x%016lx-0x%016lx bias 0x%016lx %s%s\n", m.start, m.end, m.load_bias, m.path.c_str(), m.files ? "" : " (not found)");
+    }
+    std::vector<thread_pc> threads = blocked_threads(process.pid());
+    std::vector<uint64_t> pcs;
+    for (const thread_pc& t: threads) {
+        pcs.push_back(t.pc);
+    }
+    std::vector<dwarfy::symbolized_frame> frames = process.symbolize(pcs);
+    bool found = false;
+    for (size_t i = 0; i < frames.size(); i++) {
+        const dwarfy::symbolized_frame& f = frames[i];
+        printf("  %d pc 0x%016lx", threads[i].tid, f.address);
+        if (f.module >= 0) {
+            printf(" %s", process.modules()[f.module].path.c_str());
+        }
+        if (!f.function.empty()) {
+            printf(" %s+0x%lx", f.function.c_str(), f.offset);
+            found = found || f.function.find(expect) != std::string::npos;
+        }
+        printf("\n");
+    }
+    fflush(stdout);
+    return found;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> debug_directories;
+    std::string expect;
+    size_t count = 1;
+    unsigned interval = 100;
+    pid_t pid = 0;
+    bool spawned = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--debug-dir") && i + 1 < argc) {
+            debug_directories.push_back(argv[++i]);
+        } else if (!strcmp(argv[i], "--count") && i + 1 < argc) {
+            count = std::stoul(argv[++i]);
+        } else if (!strcmp(argv[i], "--expect") && i + 1 < argc) {
+            expect = argv[++i];
+        } else if (!strcmp(argv[i], "--interval") && i + 1 < argc) {
+            interval = std::stoul(argv[++i]);
+        } else if (!strcmp(argv[i], "--") && i + 1 < argc) {
+            pid = fork();
+            if (pid == 0) {
+                execvp(argv[i + 1], argv + i + 1);
+                perror("execvp");
+                _exit(127);
+            }
+            spawned = true;
+            //let it get past the dynamic loader
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+            break;
+        } else if (!pid) {
+            pid = std::atoi(argv[i]);
+        } else {
+            fprintf(stderr, "unexpected argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (pid <= 0) {
+        fprintf(stderr, "usage: %s [--debug-dir DIR]... [--count N] [--interval MS] [--expect FUNCTION] (PID | -- COMMAND [ARG]...)\n", argv[0]);
+        return 1;
+    }
+    int status = 0;
+    bool found = false;
+    try {
+        dwarfy::module_cache cache;
+        if (!debug_directories.empty()) {
+            cache.resolver.debug_directories = debug_directories;
+        }
+        dwarfy::process_modules process{pid, cache};
+        dwarfy::process_modules::changes all;
+        for (const dwarfy::process_modules::module& m: process.modules()) {
+            all.added.push_back(m.start);
+        }
+        found = print_round(process, all, expect);
+        for (size_t round = 1; round < count; round++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+            if (spawned && waitpid(pid, &status, WNOHANG) == pid) {
+                spawned = false;
+                break;
+            }
+            printf("round %zu\n", round);
+            found = print_round(process, process.refresh(), expect) || found;
+        }
+    } catch (std::exception &e) {
+        fprintf(stderr, "error reading process %d: %s\n", pid, e.what());
+        status = 1;
+    }
+    if (spawned) {
+        kill(pid, SIGTERM);
+        waitpid(pid, nullptr, 0);
+    }
+    if (!expect.empty() && !found) {
+        fprintf(stderr, "no thread of process %d was in a function matching '%s'\n", pid, expect.c_str());
+        return 1;
+    }
+    return status == 0 ? 0 : 1;
+}
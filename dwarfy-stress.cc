@@ -0,0 +1,179 @@
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <latch>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "elfy.hh"
+#include "dwarfy.hh"
+#include "mapped-file.hh"
+#include "line-table.hh"
+
+//hammers one elf and one dwarf from many threads at once, starting on cold caches so the threads race
+//to decode abbreviation tables, sort symbols, build the unit and type unit indexes and fill the line
+//index's tables; every thread must come up with the same digest as every other
+//sections are decompressed (and aranges read) by the constructors, on the main thread, before the
+//threads start
+//built with -fsanitize=thread, so a data race in a read path fails the run even when the digests agree
+
+namespace {
+
+//order independent, each thread walks the units from a different starting point
+struct digest {
+    uint64_t dies = 0;
+    uint64_t strings = 0;
+    uint64_t references = 0;
+    uint64_t types = 0;
+    uint64_t rows = 0;
+    uint64_t symbols = 0;
+    uint64_t lines = 0;
+
+    bool operator==(const digest&) const = default;
+};
+
+void walk_unit(const dwarfy::dwarf& d, uint64_t offset, digest& out) {
+    span_reader r {d.debug_info.subspan(offset)};
+    r.file_endianness = d.initial_endianness;
+    dwarfy::compilation_unit_header cu;
+    r & cu;
+    const std::byte* end = d.debug_info.data() + offset + cu.unit_length + cu.unit_length.size();
+    bool root = true;
+    while (r.data.data() < end) {
+        dwarfy::debug_abbrev_entry dae;
+        std::vector<dwarfy::attribute> attributes = d.read_attributes(r, cu, dae);
+        if (root) {
+            cu.context.read_bases(attributes);
+            root = false;
+        }
+        out.dies++;
+        for (const dwarfy::attribute& a: attributes) {
+            switch (a.form) {
+                case dwarfy::dw_form::string:
+                case dwarfy::dw_form::strp:
+                case dwarfy::dw_form::line_strp:
+                case dwarfy::dw_form::strx:
+                case dwarfy::dw_form::strx1:
+                case dwarfy::dw_form::strx2:
+                case dwarfy::dw_form::strx3:
+                case dwarfy::dw_form::strx4:
+                case dwarfy::dw_form::GNU_str_index:
+                    out.strings += d.read_string(a, cu.context).size();
+                    break;
+                case dwarfy::dw_form::ref_sig8:
+                    if (const dwarfy::type_unit_entry* t = d.follow_signature(a)) {
+                        out.types += t->type_offset;
+                    }
+                    break;
+                case dwarfy::dw_form::ref_addr:
+                    //through the shared unit index
+                    if (std::optional<uint64_t> target = d.reference_target(a, offset)) {
+                        out.references += d.die_at(*target).attributes.size();
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    if (std::optional<dwarfy::line_table> lt = dwarfy::read_line_table(d, offset)) {
+        out.rows += lt->rows.size();
+    }
+}
+
+digest walk(const elfy::elf& e, const dwarfy::dwarf& d, dwarfy::line_index& lines, const std::vector<uint64_t>& units, size_t first) {
+    digest out;
+    for (size_t i = 0; i < units.size(); i++) {
+        walk_unit(d, units[(first + i) % units.size()], out);
+    }
+    for (const elfy::symbol& s: e.symbols(".symtab")) {
+        if (!s.is_function() || s.value == 0) {
+            continue;
+        }
+        if (std::optional<elfy::symbol> found = e.find_symbol(s.value)) {
+            out.symbols += found->size;
+        }
+        if (std::optional<dwarfy::line_location> l = lines.find(s.value)) {
+            out.lines += l->line;
+        }
+    }
+    return out;
+}
+
+bool stress(const std::string& path, unsigned threads, unsigned rounds) {
+    elfy::mapped_file mf{path};
+    bool ok = true;
+    for (unsigned round = 0; round < rounds; round++) {
+        //a fresh elf and dwarf every round, so every round starts with empty caches
+        elfy::elf e{mf.data};
+        dwarfy::dwarf d{e};
+        dwarfy::line_index lines{d};
+        std::vector<uint64_t> units = dwarfy::unit_offsets(d.debug_info, d.initial_endianness);
+
+        std::vector<digest> digests(threads);
+        std::atomic<bool> failed = false;
+        std::latch start{threads};
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < threads; t++) {
+            pool.emplace_back([&, t]() {
+                start.arrive_and_wait();
+                try {
+                    digests[t] = walk(e, d, lines, units, units.empty() ? 0 : t * units.size() / threads);
+                } catch (std::exception& ex) {
+                    fprintf(stderr, "error in thread %u on '%s': %s\n", t, path.c_str(), ex.what());
+                    failed = true;
+                }
+            });
+        }
+        for (auto& t: pool) {
+            t.join();
+        }
+        if (failed) {
+            return false;
+        }
+        for (unsigned t = 1; t < threads; t++) {
+            if (!(digests[t] == digests[0])) {
+                fprintf(stderr, "'%s' round %u: thread %u disagrees with thread 0\n", path.c_str(), round, t);
+                ok = false;
+            }
+        }
+        if (round == 0) {
+            const digest& g = digests[0];
+            printf("%s: %zu units, %lu DIEs, %lu string bytes, %lu line rows, %u threads x %u rounds\n",
+                path.c_str(), units.size(), g.dies, g.strings, g.rows, threads, rounds);
+        }
+    }
+    return ok;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    unsigned threads = 8;
+    unsigned rounds = 4;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = std::max(1ul, strtoul(argv[++i], nullptr, 0));
+        } else if (!strcmp(argv[i], "--rounds") && i + 1 < argc) {
+            rounds = strtoul(argv[++i], nullptr, 0);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        fprintf(stderr, "usage: %s [--threads N] [--rounds N] FILE...\n", argv[0]);
+        return 1;
+    }
+    bool ok = true;
+    for (const std::string& file: files) {
+        try {
+            ok = stress(file, threads, rounds) && ok;
+        } catch (std::exception &e) {
+            fprintf(stderr, "error stressing '%s': %s\n", file.c_str(), e.what());
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -1,15 +1,50 @@
-#include <sys/mman.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <errno.h>
-#include <fcntl.h>
-#include <string.h>
-#include <unistd.h> 
 #include <cstdio>
+#include <cstring>
 
 #include "elfy.hh"
 #include "dwarfy.hh"
+#include "mapped-file.hh"
+#include "line-table.hh"
+
+bool print_stats = false;
+
+//decodes every DIE, every string attribute and every unit's line table, so the counters cover all of it
+void walk_everything(dwarfy::dwarf& d) {
+    for (uint64_t offset: dwarfy::unit_offsets(d.debug_info, d.initial_endianness)) {
+        span_reader r {d.debug_info.subspan(offset)};
+        r.file_endianness = d.initial_endianness;
+        dwarfy::compilation_unit_header cu;
+        r & cu;
+        const std::byte* end = d.debug_info.data() + offset + cu.unit_length + cu.unit_length.size();
+        bool root = true;
+        while (r.data.data() < end) {
+            dwarfy::debug_abbrev_entry dae;
+            std::vector<dwarfy::attribute> attributes = d.read_attributes(r, cu, dae);
+            //the root DIE's bases first, clang puts its strx names before DW_AT_str_offsets_base
+            if (root) {
+                cu.context.read_bases(attributes);
+                root = false;
+            }
+            for (const dwarfy::attribute& a: attributes) {
+                switch (a.form) {
+                    case dwarfy::dw_form::string:
+                    case dwarfy::dw_form::strp:
+                    case dwarfy::dw_form::strx:
+                    case dwarfy::dw_form::strx1:
+                    case dwarfy::dw_form::strx2:
+                    case dwarfy::dw_form::strx3:
+                    case dwarfy::dw_form::strx4:
+                    case dwarfy::dw_form::GNU_str_index:
+                        d.read_string(a, cu.context);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+        dwarfy::read_line_table(d, offset);
+    }
+}
 
 void do_stuff(std::span<std::byte> data) {
     elfy::elf e{data};
@@ -25,50 +60,24 @@ void do_stuff(std::span<std::byte> data) {
     dwarfy::dwarf d{e};
     //d.read_debug_info();
     d.address_to_cu_arange();
+    if (print_stats) {
+        walk_everything(d);
+        std::cout << d.stats.counters().to_json();
+    }
     std::cout << "all good" << std::endl;
 }
 
-struct mmap_file {
-    std::span<std::byte> data;
-    std::string filename;
-    int fd;
-    mmap_file(std::string filename_):
-        filename(filename_)
-    {
-        fd = open(filename.c_str(), O_RDONLY);
-        if (fd < 0) {
-            throw std::runtime_error(filename + ": " + strerror(errno));
-        }
-        struct stat st;
-        int err = fstat(fd, &st);
-        if (err < 0) {
-            throw std::runtime_error(filename + ": " + strerror(errno));
-        }
-        size_t len = st.st_size;
-        void* addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
-        if (addr == MAP_FAILED) {
-            throw std::runtime_error(filename + ": " + strerror(errno));
-        }
-
-        data = {static_cast<std::byte*>(addr), len};
-    }
-
-    ~mmap_file() {
-        int err = munmap(data.data(), data.size());
-        if (err < 0) {
-            throw std::runtime_error(filename + ": " + strerror(errno));
-        }
-        err = close(fd);
-        if (fd < 0) {
-            throw std::runtime_error(filename + ": " + strerror(errno));
-        }
-    }
-};
-
 int main(int argc, char *argv[]) {
     for (argv++, argc--; argc > 0; argv++, argc--) {
         char* filename = *argv;
-        mmap_file mf{filename};
+        if (!strcmp(filename, "--stats")) {
+            print_stats = true;
+            if (!DWARFY_STATS) {
+                fprintf(stderr, "built without DWARFY_STATS, the counters will all be zero\n");
+            }
+            continue;
+        }
+        elfy::mapped_file mf{filename};
 
         try {
             printf("processing file '%s':\n", filename);
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spawn.h>
+#include <sys/wait.h>
+
+//writes synthetic C++ sources for the benchmark and scale fixtures, and optionally builds them
+//every function and type is distinct so the compiler can't fold them, which keeps the amount of
+//DWARF proportional to the requested size
+//each unit is its own translation unit, so --units sets the number of CUs in the built binary; the
+//shared header adds the same types, template instantiations and inline functions to every unit, like
+//a real project's common headers do
+
+extern char** environ;
+
+namespace {
+
+struct options {
+    size_t units = 1;
+    size_t functions = 1000;
+    size_t types = 200;
+    //nest<T, N> instantiates N levels of wrap<wrap<...<T>>>
+    size_t template_depth = 0;
+    //chain of always_inline functions, each inlined into the last
+    size_t inline_depth = 0;
+    uint64_t seed = 1;
+    size_t jobs = std::thread::hardware_concurrency();
+};
+
+void emit_common(std::ostream& out, const options& o) {
+    std::mt19937_64 rng{o.seed};
+    out << "#include <cstdint>\n#include <cstddef>\n\n";
+    for (size_t t = 0; t < o.types; t++) {
+        out << "struct type_" << t << " {\n";
+        size_t members = 1 + rng() % 6;
+        for (size_t m = 0; m < members; m++) {
+            switch (rng() % 4) {
+                case 0: out << "    int32_t m" << m << ";\n"; break;
+                case 1: out << "    double m" << m << ";\n"; break;
+                case 2: out << "    uint8_t m" << m << "[" << 1 + rng() % 16 << "];\n"; break;
+                //only point to earlier types, so every definition is complete where it's used
+                default: out << "    struct type_" << (t ? rng() % t : 0) << "* m" << m << ";\n"; break;
+            }
+        }
+        out << "};\n";
+    }
+    if (o.template_depth > 0) {
+        out << "\ntemplate<typename T> struct wrap {\n";
+        out << "    T value;\n";
+        out << "    int64_t tag;\n";
+        out << "};\n";
+        out << "template<typename T, int N> struct nest {\n";
+        out << "    nest<wrap<T>, N - 1> inner;\n";
+        out << "    __attribute__((noinline)) int64_t get(int64_t x) const { return inner.get(x) * 31 + N; }\n";
+        out << "};\n";
+        out << "template<typename T> struct nest<T, 0> {\n";
+        out << "    T value;\n";
+        out << "    __attribute__((noinline)) int64_t get(int64_t x) const { return x + static_cast<int64_t>(sizeof(T)); }\n";
+        out << "};\n";
+    }
+    if (o.inline_depth > 0) {
+        out << "\n";
+        for (size_t i = o.inline_depth; i-- > 0;) {
+            out << "__attribute__((always_inline)) inline int64_t inline_" << i << "(int64_t x) {\n";
+            if (i + 1 < o.inline_depth) {
+                out << "    return inline_" << i + 1 << "(x * " << 3 + i << " + " << i << ") ^ (x >> " << 1 + i % 7 << ");\n";
+            } else {
+                out << "    return x * x + " << i << ";\n";
+            }
+            out << "}\n";
+        }
+    }
+    out << "\n";
+}
+
+void emit_unit(std::ostream& out, const options& o, size_t unit) {
+    std::mt19937_64 rng{o.seed + 1 + unit};
+    std::string prefix = "u" + std::to_string(unit) + "_";
+    for (size_t f = 0; f < o.functions; f++) {
+        size_t type = o.types ? rng() % o.types : 0;
+        out << "__attribute__((noinline)) int64_t " << prefix << "function_" << f << "(int64_t x, type_" << type << "* p) {\n";
+        out << "    int64_t acc = x;\n";
+        size_t statements = 2 + rng() % 8;
+        for (size_t s = 0; s < statements; s++) {
+            switch (rng() % 5) {
+                case 0:
+                    out << "    for (int64_t i = 0; i < x % " << 3 + rng() % 7 << "; i++) {\n";
+                    out << "        acc = acc * " << rng() % 1000 << " + i;\n";
+                    out << "    }\n";
+                    break;
+                case 1:
+                    out << "    if (acc & " << (1u << rng() % 16) << ") {\n";
+                    out << "        acc ^= " << rng() % 100000 << ";\n";
+                    out << "    }\n";
+                    break;
+                case 2:
+                    if (o.inline_depth > 0) {
+                        out << "    acc += inline_0(acc);\n";
+                        break;
+                    }
+                    [[fallthrough]];
+                case 3:
+                    if (o.template_depth > 0 && o.types > 0) {
+                        out << "    acc += nest<type_" << rng() % o.types << ", " << 1 + rng() % o.template_depth << ">{}.get(acc);\n";
+                        break;
+                    }
+                    [[fallthrough]];
+                default:
+                    if (f > 0) {
+                        out << "    acc += " << prefix << "function_" << rng() % f << "(acc, nullptr);\n";
+                    } else {
+                        out << "    acc += " << rng() % 100 << ";\n";
+                    }
+                    break;
+            }
+        }
+        out << "    return acc + (p ? sizeof(*p) : 0);\n";
+        out << "}\n";
+    }
+    out << "\nint64_t " << prefix << "entry(int64_t acc) {\n";
+    for (size_t f = 0; f < o.functions; f += std::max<size_t>(o.functions / 64, 1)) {
+        out << "    acc += " << prefix << "function_" << f << "(acc, nullptr);\n";
+    }
+    out << "    return acc;\n";
+    out << "}\n";
+}
+
+void emit_main(std::ostream& out, const options& o) {
+    out << "#include <cstdint>\n\n";
+    for (size_t u = 0; u < o.units; u++) {
+        out << "int64_t u" << u << "_entry(int64_t acc);\n";
+    }
+    out << "\nint main(int argc, char**) {\n";
+    out << "    int64_t acc = argc;\n";
+    for (size_t u = 0; u < o.units; u++) {
+        out << "    acc += u" << u << "_entry(acc);\n";
+    }
+    out << "    return static_cast<int>(acc & 1);\n";
+    out << "}\n";
+}
+
+void write_file(const std::filesystem::path& path, auto&& emit) {
+    std::ofstream out{path};
+    emit(out);
+    if (!out) {
+        throw std::runtime_error("error writing '" + path.string() + "'");
+    }
+}
+
+//a single unit and main in one file, or a directory of units around a common header
+std::vector<std::filesystem::path> write_sources(const std::filesystem::path& output, const options& o, bool single_file) {
+    if (single_file) {
+        write_file(output, [&](std::ostream& out) {
+            emit_common(out, o);
+            emit_unit(out, o, 0);
+            out << "\n";
+            emit_main(out, o);
+        });
+        return {output};
+    }
+    std::filesystem::create_directories(output);
+    write_file(output / "common.hh", [&](std::ostream& out) {
+        out << "#pragma once\n\n";
+        emit_common(out, o);
+    });
+    std::vector<std::filesystem::path> sources;
+    for (size_t u = 0; u < o.units; u++) {
+        sources.push_back(output / ("unit_" + std::to_string(u) + ".cc"));
+        write_file(sources.back(), [&](std::ostream& out) {
+            out << "#include \"common.hh\"\n\n";
+            emit_unit(out, o, u);
+        });
+    }
+    sources.push_back(output / "main.cc");
+    write_file(sources.back(), [&](std::ostream& out) {
+        emit_main(out, o);
+    });
+    return sources;
+}
+
+int run(const std::vector<std::string>& command) {
+    std::vector<char*> argv;
+    for (const std::string& arg: command) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    pid_t pid;
+    if (int error = posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ)) {
+        throw std::runtime_error("error running '" + command[0] + "': " + strerror(error));
+    }
+    int status;
+    if (waitpid(pid, &status, 0) < 0) {
+        throw std::runtime_error("error waiting for '" + command[0] + "': " + strerror(errno));
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+//compiles every source to an object next to it (with any .dwo files), in parallel, then links them
+//all into output; the objects are passed to the link through a response file, 10k paths is a lot of
+//command line
+void build(const std::filesystem::path& output, const std::vector<std::filesystem::path>& sources, const std::vector<std::string>& compiler, size_t jobs) {
+    std::vector<std::filesystem::path> objects;
+    for (const std::filesystem::path& source: sources) {
+        objects.push_back(std::filesystem::path{source}.replace_extension(".o"));
+    }
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> failed = false;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < std::max<size_t>(jobs, 1); i++) {
+        threads.emplace_back([&]() {
+            for (size_t s = next++; s < sources.size() && !failed; s = next++) {
+                std::vector<std::string> command = compiler;
+                command.insert(command.end(), {"-c", sources[s].string(), "-o", objects[s].string()});
+                if (run(command) != 0) {
+                    fprintf(stderr, "error compiling '%s'\n", sources[s].c_str());
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (std::thread& t: threads) {
+        t.join();
+    }
+    if (failed) {
+        throw std::runtime_error("error compiling the fixture sources");
+    }
+    std::filesystem::path response = std::filesystem::path{output}.concat(".d") / "objects.rsp";
+    write_file(response, [&](std::ostream& out) {
+        for (const std::filesystem::path& object: objects) {
+            out << object.string() << "\n";
+        }
+    });
+    std::vector<std::string> command = compiler;
+    command.insert(command.end(), {"-o", output.string(), "@" + response.string()});
+    if (run(command) != 0) {
+        throw std::runtime_error("error linking '" + output.string() + "'");
+    }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    options o;
+    const char* output = nullptr;
+    std::vector<std::string> compiler;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--units") && i + 1 < argc) {
+            o.units = std::max<size_t>(strtoull(argv[++i], nullptr, 0), 1);
+        } else if (!strcmp(argv[i], "--functions") && i + 1 < argc) {
+            o.functions = strtoull(argv[++i], nullptr, 0);
+        } else if (!strcmp(argv[i], "--types") && i + 1 < argc) {
+            o.types = strtoull(argv[++i], nullptr, 0);
+        } else if (!strcmp(argv[i], "--template-depth") && i + 1 < argc) {
+            o.template_depth = strtoull(argv[++i], nullptr, 0);
+        } else if (!strcmp(argv[i], "--inline-depth") && i + 1 < argc) {
+            o.inline_depth = strtoull(argv[++i], nullptr, 0);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            o.seed = strtoull(argv[++i], nullptr, 0);
+        } else if (!strcmp(argv[i], "--jobs") && i + 1 < argc) {
+            o.jobs = strtoull(argv[++i], nullptr, 0);
+        } else if (!strcmp(argv[i], "--")) {
+            compiler.assign(argv + i + 1, argv + argc);
+            break;
+        } else if (!output) {
+            output = argv[i];
+        } else {
+            fprintf(stderr, "unexpected argument '%s'\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!output) {
+        fprintf(stderr, "usage: %s [--units N] [--functions N] [--types N] [--template-depth N] [--inline-depth N] [--seed N] [--jobs N] OUTPUT [-- COMPILER ARGS...]\n", argv[0]);
+        fprintf(stderr, "  writes the sources to OUTPUT (a file for one unit, a directory for more)\n");
+        fprintf(stderr, "  with a compiler, builds OUTPUT as an executable from sources in OUTPUT.d\n");
+        return 1;
+    }
+    try {
+        if (compiler.empty()) {
+            write_sources(output, o, o.units == 1);
+        } else {
+            std::filesystem::path sources_dir = std::filesystem::path{output}.concat(".d");
+            std::filesystem::remove_all(sources_dir);
+            build(output, write_sources(sources_dir, o, false), compiler, o.jobs);
+        }
+    } catch (std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "dwarfy.hh"
+
+namespace dwarfy {
+
+struct arange {
+    uint64_t begin;
+    uint64_t end;
+    //offset of the unit header in .debug_info
+    uint64_t cu_offset;
+};
+
+//.debug_aranges as one table sorted by address
+class cu_aranges {
+    std::vector<arange> ranges;
+public:
+    cu_aranges() = default;
+    cu_aranges(const dwarf& d);
+    //offset of the unit covering pc
+    std::optional<uint64_t> find(uint64_t pc) const;
+    size_t size() const {
+        return ranges.size();
+    }
+};
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "archive.hh"
+#include "function-index.hh"
+
+namespace dwarfy {
+
+struct archive_function {
+    std::string_view name;
+    //index into the archive's members()
+    size_t member;
+    //relative to the start of the member's section, object files aren't laid out yet
+    uint64_t begin;
+    uint64_t end;
+};
+
+//the function indexes of every ELF member of an archive, built a member per worker and merged into
+//one table sorted by name; members that aren't ELF (bitcode, text) are skipped
+//names point into the members' debug sections, so the archive has to outlive the index
+class archive_index {
+    //keeps relocated and decompressed sections alive, they're cached by the elfs
+    std::vector<std::unique_ptr<elfy::elf>> elfs;
+    std::vector<archive_function> functions;
+    size_t indexed_members = 0;
+public:
+    archive_index(const elfy::archive& a, unsigned threads = 0);
+    //every definition of name, one per member that defines it
+    std::span<const archive_function> find(std::string_view name) const;
+    const std::vector<archive_function>& entries() const {
+        return functions;
+    }
+    size_t members() const {
+        return indexed_members;
+    }
+};
+
+}
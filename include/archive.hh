@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped-file.hh"
+
+namespace elfy {
+
+struct archive_member {
+    //without the GNU trailing '/', long names resolved through the "//" table
+    std::string_view name;
+    //offset of the member's header in the archive
+    uint64_t header_offset;
+    //a view into the archive, or into the member's own mapping for thin archives
+    std::span<std::byte> data;
+};
+
+//a System V/GNU ar archive ("!<arch>\n"), with BSD "#1/" long names, or a GNU thin archive ("!<thin>\n")
+//whose members are paths relative to the archive, mapped on open and kept for the archive's lifetime
+//the symbol tables ("/" and "/SYM64/") and the long name table aren't members
+class archive {
+    std::span<std::byte> data;
+    bool thin_;
+    std::vector<archive_member> members_;
+    std::vector<std::unique_ptr<mapped_file>> thin_files;
+public:
+    //path is only used to find thin archive members
+    archive(std::span<std::byte> data_, const std::string& path = {});
+    static bool is_archive(std::span<const std::byte> data);
+    bool thin() const {
+        return thin_;
+    }
+    const std::vector<archive_member>& members() const {
+        return members_;
+    }
+};
+
+}
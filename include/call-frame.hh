@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <optional>
+
+#include "elfy.hh"
+#include "leb128.hh"
+#include "serialise.hh"
+#include "expression.hh"
+
+#include "enums.hh"
+
+namespace dwarfy {
+
+//a .eh_frame or .debug_frame section, along with what is needed to decode pointers in it
+struct call_frame_section {
+    std::span<std::byte> data;
+    uint64_t address;
+    bool is_eh_frame;
+    std::endian endianness;
+    size_t address_size;
+    uint64_t data_base = 0;
+    uint64_t text_base = 0;
+};
+
+struct common_information_entry {
+    uint64_t offset;
+    uint8_t version;
+    std::string_view augmentation;
+    uint8_t address_size;
+    uint8_t segment_size;
+    uint64_t code_alignment_factor;
+    int64_t data_alignment_factor;
+    uint64_t return_address_register;
+    uint8_t fde_pointer_encoding = static_cast<uint8_t>(dw_eh_pe::absptr);
+    uint8_t lsda_encoding = static_cast<uint8_t>(dw_eh_pe::omit);
+    bool signal_frame = false;
+    std::span<std::byte> initial_instructions;
+};
+
+struct frame_description_entry {
+    uint64_t offset;
+    uint64_t cie_offset;
+    uint64_t pc_begin;
+    uint64_t pc_range;
+    std::optional<uint64_t> lsda;
+    std::span<std::byte> instructions;
+};
+
+enum class register_rule_kind : uint8_t {
+    undefined,
+    same_value,
+    offset,
+    val_offset,
+    register_,
+    expression,
+    val_expression,
+};
+
+struct register_rule {
+    uint16_t reg;
+    register_rule_kind kind;
+    //offset for offset/val_offset, the source register for register_
+    int64_t value;
+    std::span<std::byte> expression;
+    //expression and val_expression, the index of the compiled expression in the owning table's expressions
+    uint32_t compiled = 0;
+};
+
+enum class cfa_rule_kind : uint8_t {
+    undefined,
+    register_offset,
+    expression,
+};
+
+struct cfa_rule {
+    cfa_rule_kind kind = cfa_rule_kind::undefined;
+    uint16_t reg = 0;
+    int64_t offset = 0;
+    std::span<std::byte> expression;
+    //the index of the compiled expression in the owning table's expressions
+    uint32_t compiled = 0;
+};
+
+//one row of the unwind table, valid from address until the next row (or the end of the fde)
+//the register rules are rules[rules_begin, rules_begin + rules_count) of the owning table,
+//registers without a rule are same_value
+struct unwind_row {
+    uint64_t address;
+    cfa_rule cfa;
+    uint32_t rules_begin;
+    uint32_t rules_count;
+};
+
+struct unwind_fde {
+    uint64_t pc_begin;
+    uint64_t pc_end;
+    uint32_t rows_begin;
+    uint32_t rows_count;
+    uint16_t return_address_register;
+    bool signal_frame;
+};
+
+struct unwind_location {
+    const unwind_fde* fde;
+    const unwind_row* row;
+    std::span<const register_rule> rules;
+};
+
+//the CFA programs of every fde run once, up front, leaving sorted tables that a lookup
+//binary searches twice (fde, then row) without touching the DW_CFA opcodes again
+struct unwind_table {
+    std::vector<unwind_fde> fdes;
+    std::vector<unwind_row> rows;
+    std::vector<register_rule> rules;
+    //the rows' DW_CFA_def_cfa_expression, DW_CFA_expression and DW_CFA_val_expression operands,
+    //compiled as the rows are built so unwinding doesn't decode them again for every frame
+    std::vector<compiled_expression> expressions;
+
+    unwind_table() = default;
+    unwind_table(elfy::elf& elf);
+
+    void add_section(const call_frame_section& section, std::span<std::byte> eh_frame_hdr = {}, uint64_t eh_frame_hdr_address = 0);
+    void add_fde(const call_frame_section& section, const common_information_entry& cie, const frame_description_entry& fde);
+    void sort();
+
+    const unwind_fde* find_fde(uint64_t pc) const;
+    std::optional<unwind_location> find(uint64_t pc) const;
+};
+
+//raw CIE/FDE access, for when the precompiled table isn't wanted
+common_information_entry read_cie(const call_frame_section& section, uint64_t offset);
+//returns nullopt if the entry at offset is a CIE (or a terminator) rather than an FDE
+std::optional<frame_description_entry> read_fde(const call_frame_section& section, uint64_t offset, common_information_entry* cie = nullptr);
+//offsets of every fde in a section, in section order
+std::vector<uint64_t> fde_offsets(const call_frame_section& section);
+
+uint64_t read_encoded_pointer(span_reader& r, uint8_t encoding, const call_frame_section& section, uint64_t pc_begin = 0);
+
+}
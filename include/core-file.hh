@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "elfy.hh"
+
+namespace elfy {
+
+//one file mapping of the crashed process, from NT_FILE
+struct core_mapping {
+    uint64_t start;
+    uint64_t end;
+    //into the mapped file, in bytes
+    uint64_t file_offset;
+    //points into the core's NT_FILE note
+    std::string_view path;
+    //hex, empty if the file's first page isn't in the core or it isn't an ELF file
+    std::string build_id;
+};
+
+//the mappings of one file together, with the bias from file addresses to where it was loaded
+struct core_module {
+    std::string_view path;
+    std::string build_id;
+    uint64_t start;
+    uint64_t end;
+    uint64_t load_bias;
+};
+
+struct core_thread {
+    uint32_t pid;
+    uint64_t pc;
+    uint64_t sp;
+};
+
+//the process state in an ET_CORE file: its mappings from NT_FILE, the build-ids of the ELF files among
+//them, read from their first pages in the dump, and the registers of each thread from NT_PRSTATUS
+//everything is read in place from the core's mapping, segment contents are never copied
+class core_file {
+    elf e;
+    //PT_LOAD segments by address
+    std::vector<program_header> loads;
+    std::vector<core_mapping> mappings_;
+    std::vector<core_module> modules_;
+    std::vector<core_thread> threads_;
+
+    void read_file_note(std::span<std::byte> desc);
+    void read_prstatus(std::span<std::byte> desc);
+    void read_modules();
+public:
+    core_file(const elf& e_);
+    //the dumped process memory from address to the end of the dumped part of its segment, empty if
+    //the core doesn't have it
+    std::span<std::byte> memory(uint64_t address) const;
+    //sorted by start address
+    const std::vector<core_mapping>& mappings() const {
+        return mappings_;
+    }
+    //sorted by start address
+    const std::vector<core_module>& modules() const {
+        return modules_;
+    }
+    const std::vector<core_thread>& threads() const {
+        return threads_;
+    }
+};
+
+}
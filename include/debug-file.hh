@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "elfy.hh"
+#include "dwarfy.hh"
+#include "mapped-file.hh"
+
+namespace elfy {
+
+//the CRC-32 (IEEE 802.3, reflected) used by .gnu_debuglink, computed eight bytes at a time
+uint32_t crc32(std::span<const std::byte> data, uint32_t crc = 0);
+
+//descriptor of the NT_GNU_BUILD_ID note, empty if the file has none
+std::span<std::byte> build_id(elf& e);
+std::string build_id_hex(std::span<const std::byte> id);
+
+struct debug_link {
+    std::string filename;
+    uint32_t crc;
+};
+std::optional<debug_link> read_debug_link(elf& e);
+
+}
+
+namespace dwarfy {
+
+//a binary paired with its separate debug file (if one was found)
+//the dwarf reads program and unwind sections from the binary and debug sections from whichever
+//of the two has them
+struct debug_file_pair {
+    std::shared_ptr<elfy::mapped_file> binary;
+    std::shared_ptr<elfy::mapped_file> debug;
+    //the debug file's elf, kept for its cache: d's compressed (or relocated) debug sections point into
+    //buffers the cache owns
+    std::optional<elfy::elf> debug_elf;
+    dwarf d;
+};
+
+//finds separate debug files through /usr/lib/debug/.build-id/xx/yyyy.debug and .gnu_debuglink
+//results (including misses) are memoized by build-id, so opening the same library many times only
+//searches the filesystem and checksums the candidate once
+class debug_file_resolver {
+    std::mutex m;
+    std::unordered_map<std::string, std::shared_ptr<elfy::mapped_file>> by_build_id;
+
+    std::shared_ptr<elfy::mapped_file> search(elfy::elf& e, const std::string& path, std::span<std::byte> id);
+public:
+    std::vector<std::string> debug_directories = {"/usr/lib/debug"};
+
+    //the debug file for the binary e (mapped from path), nullptr if there isn't one
+    std::shared_ptr<elfy::mapped_file> find(elfy::elf& e, const std::string& path);
+    debug_file_pair open(const std::string& path);
+    size_t memoized();
+};
+
+//a dwarf over binary, with every debug section it lacks taken from debug
+//debug (or a copy of it, copies share the decompressed sections) has to outlive the result
+dwarf combine_debug_sections(elfy::elf& binary, elfy::elf& debug);
+
+}
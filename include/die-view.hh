@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "dwarfy.hh"
+
+namespace dwarfy {
+
+//the attributes a visit decodes, fixed at compile time: projection<dw_at::name, dw_at::low_pc>
+template<dw_at... Names>
+struct projection_t {
+    static_assert(sizeof...(Names) < 255, "too many attributes in a projection");
+    static constexpr std::array<dw_at, sizeof...(Names)> names {Names...};
+};
+template<dw_at... Names>
+inline constexpr projection_t<Names...> projection {};
+
+//one step of decoding a DIE with a given abbreviation: skip a run of fixed size bytes, then read (and
+//maybe keep) one form
+struct decode_step {
+    static constexpr uint8_t no_slot = 0xff;
+    //fixed size forms nobody asked for fold into the next step's skip
+    uint32_t skip = 0;
+    //0 for a trailing skip with nothing to read after it
+    dw_form form = static_cast<dw_form>(0);
+    //the projected attribute this fills in, or no_slot to read past it
+    uint8_t slot = no_slot;
+    dw_at name = static_cast<dw_at>(0);
+    //DW_FORM_implicit_const's value, which lives in the abbreviation
+    std::span<std::byte> implicit;
+};
+
+//how to decode the DIEs of one abbreviation for one projection: the projected attributes if the tag
+//is the one visited, nothing (only the skips past them) otherwise
+struct abbrev_plan {
+    bool built = false;
+    bool wanted = false;
+    std::vector<decode_step> steps;
+};
+
+//the bytes of a fixed size form in a unit, 0 for forms with nothing in .debug_info, SIZE_MAX for
+//variable length ones
+size_t fixed_form_size(dw_form form, const unit_context& unit);
+
+//a unit's abbreviations turned into decode plans for one tag and projection, each built the first
+//time a DIE uses it
+class decode_plans {
+    const dwarf& d;
+    compilation_unit_header& cu;
+    dw_tag tag;
+    std::span<const dw_at> names;
+    std::vector<abbrev_plan> plans;
+
+    const abbrev_plan& build(uint64_t code);
+public:
+    decode_plans(const dwarf& d_, compilation_unit_header& cu_, dw_tag tag_, std::span<const dw_at> names_);
+    const abbrev_plan& find(uint64_t code) {
+        if (code < plans.size() && plans[code].built) {
+            return plans[code];
+        }
+        return build(code);
+    }
+    //reads a DIE's attributes after its abbreviation code, filling in the projected ones
+    static void run(const abbrev_plan& plan, span_reader& r, attribute* slots) {
+        for (const decode_step& s: plan.steps) {
+            r.data = r.data.subspan(s.skip);
+            dw_form form = s.form;
+            if (form == static_cast<dw_form>(0)) {
+                continue;
+            }
+            if (form == dw_form::indirect) {
+                uleb128 v;
+                r & v;
+                form = static_cast<dw_form>(static_cast<uint64_t>(v));
+            }
+            std::span<std::byte> data = form == dw_form::implicit_const ? s.implicit : read_form(r, form);
+            if (s.slot != decode_step::no_slot) {
+                slots[s.slot] = {s.name, form, data};
+            }
+        }
+    }
+};
+
+//a unit set up for visiting: its header, with the root DIE's bases, and the bytes of its DIEs
+struct visit_unit {
+    const dwarf* d;
+    compilation_unit_header cu;
+    std::span<std::byte> dies;
+};
+visit_unit prepare_visit(compilation_unit_header::iterator& cu_it);
+
+//the projected attributes of one visited DIE, get<dw_at::x>() is nullptr if the DIE doesn't have it
+template<dw_at... Names>
+struct die_view {
+    static constexpr std::array<dw_at, sizeof...(Names)> names {Names...};
+
+    uint64_t offset;
+    const unit_context* context;
+    std::array<attribute, sizeof...(Names)> attributes;
+
+    template<dw_at Name>
+    static constexpr size_t index() {
+        for (size_t i = 0; i < names.size(); i++) {
+            if (names[i] == Name) {
+                return i;
+            }
+        }
+        return names.size();
+    }
+    template<dw_at Name>
+    const attribute* get() const {
+        constexpr size_t i = index<Name>();
+        static_assert(i < sizeof...(Names), "attribute not in the projection");
+        return attributes[i].form != static_cast<dw_form>(0) ? &attributes[i] : nullptr;
+    }
+};
+
+//calls f(const die_view<Names...>&) for every DIE of the unit tagged Tag, in order, decoding only the
+//projected attributes: every abbreviation gets a plan that skips runs of fixed size forms in one step,
+//and DIEs of other tags are only skipped over
+template<dw_tag Tag, dw_at... Names, typename F>
+void visit(compilation_unit_header::iterator& cu_it, projection_t<Names...>, F&& f) {
+    visit_unit u = prepare_visit(cu_it);
+    if (u.dies.empty()) {
+        return;
+    }
+    decode_plans plans {*u.d, u.cu, Tag, projection_t<Names...>::names};
+    die_view<Names...> view;
+    view.context = &u.cu.context;
+    const std::byte* end = u.dies.data() + u.dies.size();
+    const std::byte* die_start = u.dies.data();
+    debugging_information_entry::iterator it {u.d, u.cu.context.reader(u.dies)};
+    while (true) {
+        if (!it.die.is_last()) {
+            const abbrev_plan& plan = plans.find(it.die.abbrev_code);
+            if (plan.wanted) {
+                view.offset = die_start - u.d->debug_info.data();
+                view.attributes = {};
+                decode_plans::run(plan, it.debug_info_reader, view.attributes.data());
+                f(std::as_const(view));
+            } else {
+                decode_plans::run(plan, it.debug_info_reader, nullptr);
+            }
+        }
+        if (it.debug_info_reader.data.data() >= end) {
+            break;
+        }
+        die_start = it.debug_info_reader.data.data();
+        ++it;
+    }
+}
+
+}
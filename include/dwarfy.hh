@@ -7,12 +7,20 @@
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <vector>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "elfy.hh"
 #include "leb128.hh"
 #include "serialise.hh"
 
 #include "enums.hh"
+#include "lists.hh"
+#include "type-units.hh"
+#include "stats.hh"
 
 namespace dwarfy {
 
@@ -35,14 +43,19 @@ enum class dw_children : uint8_t {
 struct initial_length {
     uint64_t length;
     size_t read_bytes;
-    operator uint64_t() {
+    operator uint64_t() const {
         return length;
     }
-    size_t size() {
+    size_t size() const {
         return read_bytes;
     }
+    //the 64-bit DWARF format is chosen per unit, by the 0xffffffff escape
+    size_t offset_size() const {
+        return read_bytes == 12 ? 8 : 4;
+    }
 };
 
+//doesn't touch the reader's offset size, units of both formats can sit side by side in one section
 void read(span_reader& r, initial_length& i);
 
 struct attribute {
@@ -52,11 +65,32 @@ struct attribute {
     bool is_last() {
         return static_cast<uint64_t>(name) == 0 && static_cast<uint64_t>(form) == 0;
     }
+    //decodes constant, address, reference, offset and index forms
+    uint64_t unsigned_value(std::endian endianness) const;
+    int64_t signed_value(std::endian endianness) const;
 };
 std::span<std::byte> read_form(span_reader &ir, dw_form form);
 void read(span_reader &ir, span_reader &ar, attribute& a);
 std::string to_string(attribute attr);
 
+//how to decode one unit, fixed by its header (and the bases by its root DIE), small enough to pass by
+//value so that any unit can be decoded on its own, in any order and on any thread
+struct unit_context {
+    uint16_t version = 4;
+    size_t offset_size = 4;
+    size_t address_size = 8;
+    std::endian endianness = std::endian::little;
+    //DW_AT_str_offsets_base and DW_AT_addr_base (or GNU_addr_base) of the root DIE, split units start
+    //with the str_offsets_base implied by their header
+    uint64_t str_offsets_base = 0;
+    uint64_t addr_base = 0;
+
+    //a reader over data set up for this unit's offsets, addresses and byte order
+    span_reader reader(std::span<std::byte> data) const;
+    //fills in the bases from the unit's root DIE attributes
+    void read_bases(std::span<const attribute> root_attributes);
+};
+
 struct dwarf;
 
 struct debugging_information_entry {
@@ -67,7 +101,7 @@ struct debugging_information_entry {
     class iterator;
 };
 class debugging_information_entry::iterator {
-    dwarf* d;
+    const dwarf* d;
 public:
     span_reader debug_info_reader;
     span_reader debug_abbrev_reader;
@@ -80,7 +114,7 @@ public:
     bool operator==(sentinel);
     sentinel end() const;
     iterator();
-    iterator(dwarf* d_, span_reader debug_info_reader_);
+    iterator(const dwarf* d_, span_reader debug_info_reader_);
     const debugging_information_entry operator*() const;
     iterator& operator++();
     iterator operator++(int);
@@ -96,6 +130,7 @@ struct type_unit_header {
     uint8_t address_size;
     uint64_t type_signature;
     file_offset_size type_offset;
+    unit_context context;
 };
 
 void read(span_reader &r, type_unit_header& tu);
@@ -103,16 +138,28 @@ void read(span_reader &r, type_unit_header& tu);
 struct compilation_unit_header {
     initial_length unit_length;
     uint16_t version;
+    //DWARF 5 only, earlier versions are always compile units
+    dw_ut unit_type = dw_ut::compile;
     file_offset_size debug_abbrev_offset;
     uint8_t address_size;
-    dwarf* d;
+    //DWARF 5 skeleton and split units
+    uint64_t dwo_id = 0;
+    //DWARF 5 type units
+    uint64_t type_signature = 0;
+    file_offset_size type_offset = {0};
+    //decoded with the header, the root DIE's bases stay 0 until read_bases
+    unit_context context;
+    const dwarf* d;
+    //the unit's decoded abbreviation table, filled in by the first dwarf::find_abbrev through this header
+    const std::byte* abbrev_table = nullptr;
+    const std::vector<size_t>* abbrevs = nullptr;
 
     class sentinel {};
     class iterator;
 };
 
 class compilation_unit_header::iterator {
-    dwarf* d;
+    const dwarf* d;
     span_reader debug_info_reader;
     std::span<std::byte> next_cu;
     compilation_unit_header cu;
@@ -125,11 +172,13 @@ public:
     bool operator==(sentinel);
     sentinel end() const;
     iterator();
-    iterator(dwarf* d_);
+    iterator(const dwarf* d_);
     const compilation_unit_header operator*() const;
     iterator& operator++();
     iterator operator++(int);
     span_reader die_reader();
+    //the unit's DIEs, from its root DIE to the end of the unit
+    std::span<std::byte> die_data() const;
     debugging_information_entry::iterator die_iter();
     iterator begin() const;
 };
@@ -146,9 +195,57 @@ struct debug_abbrev_entry {
 };
 void read(span_reader &r, debug_abbrev_entry& dae);
 
+//offsets of every unit header in a .debug_info-like section, from the unit_length chain
+std::vector<uint64_t> unit_offsets(std::span<std::byte> section, std::endian endianness);
+signature_map scan_type_units(const dwarf& d);
+
+//the unit start offsets of a .debug_info-like section, sorted since the unit_length chain only runs
+//forward, so the unit owning any offset (a DW_FORM_ref_addr target, say) is a binary search away
+class unit_index {
+    std::vector<uint64_t> starts;
+    uint64_t section_size = 0;
+public:
+    unit_index() = default;
+    unit_index(std::span<std::byte> section, std::endian endianness);
+    //the start of the last unit at or before offset, nullopt for offsets outside the section
+    std::optional<uint64_t> unit_containing(uint64_t offset) const;
+    const std::vector<uint64_t>& offsets() const {
+        return starts;
+    }
+};
+
+//a DIE decoded on its own by dwarf::die_at, with the header (and root DIE bases) of its unit
+struct unit_die {
+    uint64_t offset;
+    uint64_t unit_offset;
+    compilation_unit_header cu;
+    //zeroed for a null entry
+    debug_abbrev_entry abbrev;
+    std::vector<attribute> attributes;
+};
+
+//lazily built lookup state, shared by copies of a dwarf, each part behind its own lock or once flag
+struct dwarf_cache {
+    std::mutex abbrev_m;
+    //.debug_abbrev offsets of each abbreviation table's entries, indexed by code and keyed by the
+    //table's address so it stays valid when the sections are repointed (select_dwo_sections, .dwp)
+    //node based, so tables handed out never move
+    std::unordered_map<const std::byte*, std::vector<size_t>> abbrev_tables;
+
+    std::once_flag type_units_once;
+    std::optional<signature_map> type_unit_map;
+
+    std::once_flag units_once;
+    std::optional<unit_index> units;
+};
+
+//the read paths (find_abbrev, read_attributes, read_string, lists and type unit lookups) are const and
+//safe to call on one dwarf from many threads; repointing the sections is not
 struct dwarf {
 
     elfy::elf elf;
+    //before the sections, so their lookups are counted
+    [[no_unique_address]] mutable dwarf_stats stats;
 
     std::span<std::byte> debug_abbrev;
     std::span<std::byte> debug_addr;
@@ -178,55 +275,91 @@ struct dwarf {
     std::span<std::byte> debug_rnglists_dwo;
     std::span<std::byte> debug_str_dwo;
     std::span<std::byte> debug_str_offsets_dwo;
+    std::span<std::byte> debug_types_dwo;
     std::span<std::byte> debug_framesection;
     std::span<std::byte> debug_cu_index;
     std::span<std::byte> debug_tu_index;
 
     std::endian initial_endianness;
 
+    std::shared_ptr<dwarf_cache> cache = std::make_shared<dwarf_cache>();
+
+    std::span<std::byte> section_data(std::string_view name) const;
+    const std::vector<size_t>& abbrev_table(const std::byte* start) const;
     dwarf(elfy::elf& elf_):
         elf(elf_),
 
-        debug_abbrev(elf.get_section_data_by_name(".debug_abbrev")),
-        debug_addr(elf.get_section_data_by_name(".debug_addr")),
-        debug_aranges(elf.get_section_data_by_name(".debug_aranges")),
-        debug_frame(elf.get_section_data_by_name(".debug_frame")),
-        debug_info(elf.get_section_data_by_name(".debug_info")),
-        debug_line(elf.get_section_data_by_name(".debug_line")),
-        debug_line_str(elf.get_section_data_by_name(".debug_line_str")),
-        debug_loc(elf.get_section_data_by_name(".debug_loc")),
-        debug_loclists(elf.get_section_data_by_name(".debug_loclists")),
-        debug_macinfo(elf.get_section_data_by_name(".debug_macinfo")),
-        debug_macro(elf.get_section_data_by_name(".debug_macro")),
-        debug_names(elf.get_section_data_by_name(".debug_names")),
-        debug_pubnames(elf.get_section_data_by_name(".debug_pubnames")),
-        debug_pubtypes(elf.get_section_data_by_name(".debug_pubtypes")),
-        debug_ranges(elf.get_section_data_by_name(".debug_ranges")),
-        debug_rnglists(elf.get_section_data_by_name(".debug_rnglists")),
-        debug_str(elf.get_section_data_by_name(".debug_str")),
-        debug_str_offsets(elf.get_section_data_by_name(".debug_str_offsets")),
-        debug_sup(elf.get_section_data_by_name(".debug_sup")),
-        debug_types(elf.get_section_data_by_name(".debug_types")),
-        debug_abbrev_dwo(elf.get_section_data_by_name(".debug_abbrev.dwo")),
-        debug_info_dwo(elf.get_section_data_by_name(".debug_info.dwo")),
-        debug_line_dwo(elf.get_section_data_by_name(".debug_line.dwo")),
-        debug_loclists_dwo(elf.get_section_data_by_name(".debug_loclists.dwo")),
-        debug_macro_dwo(elf.get_section_data_by_name(".debug_macro.dwo")),
-        debug_rnglists_dwo(elf.get_section_data_by_name(".debug_rnglists.dwo")),
-        debug_str_dwo(elf.get_section_data_by_name(".debug_str.dwo")),
-        debug_str_offsets_dwo(elf.get_section_data_by_name(".debug_str_offsets.dwo")),
-        debug_framesection(elf.get_section_data_by_name(".debug_framesection")),
-        debug_cu_index(elf.get_section_data_by_name(".debug_cu_index")),
-        debug_tu_index(elf.get_section_data_by_name(".debug_tu_index")),
+        debug_abbrev(section_data(".debug_abbrev")),
+        debug_addr(section_data(".debug_addr")),
+        debug_aranges(section_data(".debug_aranges")),
+        debug_frame(section_data(".debug_frame")),
+        debug_info(section_data(".debug_info")),
+        debug_line(section_data(".debug_line")),
+        debug_line_str(section_data(".debug_line_str")),
+        debug_loc(section_data(".debug_loc")),
+        debug_loclists(section_data(".debug_loclists")),
+        debug_macinfo(section_data(".debug_macinfo")),
+        debug_macro(section_data(".debug_macro")),
+        debug_names(section_data(".debug_names")),
+        debug_pubnames(section_data(".debug_pubnames")),
+        debug_pubtypes(section_data(".debug_pubtypes")),
+        debug_ranges(section_data(".debug_ranges")),
+        debug_rnglists(section_data(".debug_rnglists")),
+        debug_str(section_data(".debug_str")),
+        debug_str_offsets(section_data(".debug_str_offsets")),
+        debug_sup(section_data(".debug_sup")),
+        debug_types(section_data(".debug_types")),
+        debug_abbrev_dwo(section_data(".debug_abbrev.dwo")),
+        debug_info_dwo(section_data(".debug_info.dwo")),
+        debug_line_dwo(section_data(".debug_line.dwo")),
+        debug_loclists_dwo(section_data(".debug_loclists.dwo")),
+        debug_macro_dwo(section_data(".debug_macro.dwo")),
+        debug_rnglists_dwo(section_data(".debug_rnglists.dwo")),
+        debug_str_dwo(section_data(".debug_str.dwo")),
+        debug_str_offsets_dwo(section_data(".debug_str_offsets.dwo")),
+        debug_types_dwo(section_data(".debug_types.dwo")),
+        debug_framesection(section_data(".debug_framesection")),
+        debug_cu_index(section_data(".debug_cu_index")),
+        debug_tu_index(section_data(".debug_tu_index")),
 
         initial_endianness(elf.ident.endianness())
     {}
 
     void read_debug_info();
-    size_t find_abbrev(uleb128 abbrev_code);
-    size_t find_abbrev(uleb128 abbrev_code, compilation_unit_header& cu);
-
-    compilation_unit_header::iterator cu_iter();
+    //the first lookup through a unit header finds (or decodes) the unit's table and keeps it in the header
+    size_t find_abbrev(uleb128 abbrev_code, compilation_unit_header& cu) const;
+
+    compilation_unit_header::iterator cu_iter() const;
+
+    //reads the DIE at the reader's position, leaving the reader after its attributes
+    //the forms are decoded with cu.context, whatever the reader was set up for
+    std::vector<attribute> read_attributes(span_reader& debug_info_reader, compilation_unit_header& cu, debug_abbrev_entry& dae) const;
+
+    list_context unit_list_context(compilation_unit_header::iterator& cu_it) const;
+    //DW_AT_ranges, DW_AT_location and friends, of form sec_offset, rnglistx or loclistx
+    range_list ranges(const attribute& a, const list_context& ctx) const;
+    location_list locations(const attribute& a, const list_context& ctx) const;
+    location_index_cache location_cache(const list_context& ctx) const;
+
+    //DW_FORM_string, strp, line_strp and the strx family, which index .debug_str_offsets from the unit's str_offsets_base
+    std::string_view read_string(const attribute& a, const unit_context& unit = {}) const;
+    //point the main sections at their .dwo counterparts, for dwarfs over split DWARF files
+    void select_dwo_sections();
+    //drop the lazily built state, after repointing sections by hand
+    void reset_cache();
+
+    //DW_FORM_ref_sig8 targets, from .debug_types and DWARF 5 type units in .debug_info
+    const type_unit_entry* type_by_signature(uint64_t signature) const;
+    const type_unit_entry* follow_signature(const attribute& a) const;
+
+    //the .debug_info units, indexed by start offset the first time they're needed
+    const unit_index& units() const;
+    //the .debug_info offset a reference attribute points at, the unit relative forms counting from the
+    //unit at unit_offset and ref_addr from the start of the section
+    //nullopt for ref_sig8 (see follow_signature) and references into a supplementary file
+    std::optional<uint64_t> reference_target(const attribute& a, uint64_t unit_offset) const;
+    //decodes the single DIE at a .debug_info offset, reading only its unit's header and root DIE
+    unit_die die_at(uint64_t offset) const;
 
     void address_to_cu_arange();
 };
@@ -5,6 +5,8 @@
 #include <cstdlib>
 #include <optional>
 #include <iostream>
+#include <memory>
+#include <vector>
 #include <span>
 #include <string_view>
 #include <array>
@@ -28,7 +30,8 @@ class elf_ident {
 
     template<typename R>
     friend void read(R& r, elf_ident& i);
-    std::size_t bitwidth() {
+public:
+    std::size_t bitwidth() const {
         if (bitwidth_ == 1) {
             return sizeof(uint32_t);
         } else if (bitwidth_ == 2) {
@@ -37,8 +40,7 @@ class elf_ident {
             throw std::runtime_error("bad ELF bitwidth field, expected 1 or 2 (indicating 32 bit or 64 bit), got: " + std::to_string(bitwidth_));
         }
     }
-public:
-    std::endian endianness() {
+    std::endian endianness() const {
         if (endianness_ == 1) {
             return std::endian::little;
         } else if (endianness_ == 2) {
@@ -111,10 +113,38 @@ class program_header {
     file_offset_size memsz;
     file_offset_size align;
 
+public:
+    uint32_t segment_type() const {
+        return type;
+    }
+    uint64_t file_offset() const {
+        return offset;
+    }
+    uint64_t address() const {
+        return vaddr;
+    }
+    uint64_t file_size() const {
+        return filesz;
+    }
+    uint64_t memory_size() const {
+        return memsz;
+    }
+    uint64_t alignment() const {
+        return align;
+    }
     template<typename R>
     friend void read(R& r, program_header& h);
 };
 
+//one entry of a PT_NOTE segment or SHT_NOTE section
+struct note {
+    std::string_view owner;
+    uint32_t type;
+    std::span<std::byte> desc;
+};
+//notes are padded to 4 bytes, or to 8 in segments aligned to 8 (GNU property notes)
+std::vector<note> read_notes(std::span<std::byte> contents, std::endian endianness, size_t alignment = 4);
+
 template<typename R>
 void read(R& r, program_header& h) {
     r & h.type;
@@ -143,8 +173,39 @@ class section_header {
     file_offset_size entsize;
 
 public:
-    std::string_view name(elf& e) const;
-    std::span<std::byte> data(elf& e) const;
+    std::string_view name(const elf& e) const;
+    //SHF_COMPRESSED sections are decompressed on first access and cached by the elf, as are the
+    //relocated copies of an ET_REL object's non-allocated sections
+    std::span<std::byte> data(const elf& e) const;
+    uint64_t address() const {
+        return addr;
+    }
+    uint32_t section_type() const {
+        return type;
+    }
+    //SHF_ALLOC, loaded at run time; relocations are only applied to sections without it
+    bool allocated() const {
+        return flags & 0x2;
+    }
+    //SHT_REL or SHT_RELA
+    bool is_relocation() const {
+        return type == 9 || type == 4;
+    }
+    //for SHT_REL/SHT_RELA, the section header index of the section the relocations apply to
+    uint32_t info_section() const {
+        return info;
+    }
+    uint64_t file_offset() const {
+        return offset;
+    }
+    //SHF_COMPRESSED
+    bool compressed() const {
+        return flags & 0x800;
+    }
+    //section header index of the associated section, e.g. the string table of a symbol table
+    uint32_t linked_section() const {
+        return link;
+    }
     template<typename R>
     friend void read(R& r, section_header& h);
 };
@@ -164,45 +225,124 @@ int bytes_to_type_range(
     return 0;
 }
 
+struct symbol {
+    std::string_view name;
+    uint64_t value;
+    uint64_t size;
+    uint8_t info;
+    uint8_t other;
+    uint16_t shndx;
+
+    //STT_FUNC or STT_GNU_IFUNC
+    bool is_function() const {
+        return (info & 0xf) == 2 || (info & 0xf) == 10;
+    }
+};
+
+//the raw Elf32_Sym/Elf64_Sym, the name is resolved against the linked string table afterwards
+struct symbol_entry {
+    uint32_t name;
+    symbol sym;
+};
+
+template<typename R>
+void read(R& r, symbol_entry& s) {
+    r & s.name;
+    if (r.file_offset_size == sizeof(uint64_t)) {
+        file_offset_size value;
+        file_offset_size size;
+        r & s.sym.info & s.sym.other & s.sym.shndx & value & size;
+        s.sym.value = value;
+        s.sym.size = size;
+    } else {
+        file_offset_size value;
+        file_offset_size size;
+        r & value & size & s.sym.info & s.sym.other & s.sym.shndx;
+        s.sym.value = value;
+        s.sym.size = size;
+    }
+}
+
+//an Elf32_Rel/Elf32_Rela/Elf64_Rel/Elf64_Rela, addend is only set for RELA
+struct relocation {
+    uint64_t offset;
+    uint32_t type;
+    uint32_t symbol;
+    int64_t addend;
+};
+
+struct elf_cache;
+
+//every read path is const and keeps its reader on the stack, so one elf can be queried from many
+//threads at once; the lazily built state in elf_cache is guarded by its own once flags and mutex
 class elf {
     std::span<std::byte> data;
-    span_reader reader;
     elf_header header;
+    //lazily built, shared between copies of this elf
+    std::shared_ptr<elf_cache> cache;
+
+    span_reader reader_at(uint64_t offset) const {
+        span_reader r {data.subspan(offset)};
+        r.file_offset_size = ident.bitwidth();
+        r.file_endianness = ident.endianness();
+        return r;
+    }
+    std::span<std::byte> decompress(uint64_t offset, std::span<std::byte> compressed) const;
+    //contents with the relocations that target sh applied, in a copy, or contents itself if there are none
+    std::span<std::byte> relocate(const section_header& sh, std::span<std::byte> contents) const;
 public:
     elf_ident ident;
-    elf(std::span<std::byte> data_):
-        data(data_),
-        reader(data)
-    {
-        reader & ident & header;
+    elf(std::span<std::byte> data_);
+    uint16_t machine() const {
+        return header.machine;
+    }
+    //ET_REL, an object file whose debug sections still need their relocations applied
+    bool relocatable() const {
+        return header.type == 1;
+    }
+    //ET_CORE
+    bool core() const {
+        return header.type == 4;
     }
-    auto programs() {
+    size_t program_count() const {
+        return header.phnum;
+    }
+    //one past the last byte of the program header table, to check it's there in partial images
+    uint64_t program_headers_end() const {
+        return header.phoff + static_cast<uint64_t>(header.phentsize) * header.phnum;
+    }
+    //the part of a segment that's in the file, cut short if the file is (truncated core dumps)
+    std::span<std::byte> segment_data(const program_header& ph) const;
+    size_t section_count() const {
+        return header.shnum;
+    }
+    auto programs() const {
         return bytes_to_type_range(
             header.phnum,
             header.phoff,
             header.phentsize,
-            [&](){ reader & header; }
+            [](span_reader& r, program_header& ph){ r & ph; }
         );
     }
-    std::optional<program_header> get_program_by_id(size_t id) {
+    std::optional<program_header> get_program_by_id(size_t id) const {
         if (id >= header.phnum) {
             return std::nullopt;
         }
         program_header ph;
-        reader.reset(data.subspan(header.phoff + header.phentsize * id));
-        reader & ph;
+        span_reader r = reader_at(header.phoff + header.phentsize * id);
+        r & ph;
         return ph;
     }
-    std::optional<section_header> get_section_by_id(size_t id) {
+    std::optional<section_header> get_section_by_id(size_t id) const {
         if (id >= header.shnum) {
             return std::nullopt;
         }
         section_header sh;
-        reader.reset(data.subspan(header.shoff + header.shentsize * id));
-        reader & sh;
+        span_reader r = reader_at(header.shoff + header.shentsize * id);
+        r & sh;
         return sh;
     }
-    std::optional<section_header> get_section_by_name(const std::string_view& key) {
+    std::optional<section_header> get_section_by_name(const std::string_view& key) const {
         for (size_t i = 0; i < header.shnum; i++) {
             section_header sh = get_section_by_id(i).value();
             if (sh.name(*this) == key) {
@@ -211,7 +351,7 @@ public:
         }
         return std::nullopt;
     }
-    std::span<std::byte> get_section_data_by_name(const std::string_view& key) {
+    std::span<std::byte> get_section_data_by_name(const std::string_view& key) const {
         auto o = get_section_by_name(key);
         if (o) {
             return o.value().data(*this);
@@ -219,7 +359,7 @@ public:
             return {};
         }
     }
-    section_header get_section_by_name_ex(const std::string_view& key) {
+    section_header get_section_by_name_ex(const std::string_view& key) const {
         auto o = get_section_by_name(key);
         if (o) {
             return o.value();
@@ -228,6 +368,22 @@ public:
         }
     }
 
+    //all symbols in the named symbol table (.symtab or .dynsym), empty if there is no such section
+    std::vector<symbol> symbols(const std::string_view& section) const;
+    //the mini ELF embedded xz compressed in .gnu_debugdata (MiniDebugInfo), nullptr if there is none
+    //decompressed once on first use and kept for the lifetime of this elf and its copies
+    const elf* mini_debug_info() const;
+    //the function symbol containing address, from .symtab, or .dynsym and the MiniDebugInfo .symtab
+    //when the binary is stripped
+    std::optional<symbol> find_symbol(uint64_t address) const;
+
+    //the entries of a SHT_REL or SHT_RELA section
+    std::vector<relocation> relocations(const section_header& sh) const;
+    //applies the relocations of every non-allocated section of an ET_REL object up front, a section
+    //per worker, rather than one at a time as they're first read; a no-op for other files
+    //opt in, section_header::data relocates lazily without it
+    void relocate_sections(unsigned threads = 0) const;
+
     friend class section_header;
 };
 
@@ -1,6 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
 #include <string>
+#include <string_view>
 
 namespace dwarfy {
 
@@ -65,7 +72,17 @@ enum class dw_tag {
     type_unit = 0x41,
     rvalue_reference_type = 0x42,
     template_alias = 0x43,
+    coarray_type = 0x44,
+    generic_subrange = 0x45,
+    dynamic_type = 0x46,
+    atomic_type = 0x47,
+    call_site = 0x48,
+    call_site_parameter = 0x49,
+    skeleton_unit = 0x4a,
+    immutable_type = 0x4b,
     lo_user = 0x4080,
+    GNU_call_site = 0x4109,
+    GNU_call_site_parameter = 0x410a,
     hi_user = 0xffff,
 };
 enum class dw_at {
@@ -161,7 +178,53 @@ enum class dw_at {
     const_expr = 0x6c,
     enum_class = 0x6d,
     linkage_name = 0x6e,
+    string_length_bit_size = 0x6f,
+    string_length_byte_size = 0x70,
+    rank = 0x71,
+    str_offsets_base = 0x72,
+    addr_base = 0x73,
+    rnglists_base = 0x74,
+    dwo_name = 0x76,
+    reference = 0x77,
+    rvalue_reference = 0x78,
+    macros = 0x79,
+    call_all_calls = 0x7a,
+    call_all_source_calls = 0x7b,
+    call_all_tail_calls = 0x7c,
+    call_return_pc = 0x7d,
+    call_value = 0x7e,
+    call_origin = 0x7f,
+    call_parameter = 0x80,
+    call_pc = 0x81,
+    call_tail_call = 0x82,
+    call_target = 0x83,
+    call_target_clobbered = 0x84,
+    call_data_location = 0x85,
+    call_data_value = 0x86,
+    noreturn = 0x87,
+    alignment = 0x88,
+    export_symbols = 0x89,
+    deleted = 0x8a,
+    defaulted = 0x8b,
+    loclists_base = 0x8c,
     lo_user = 0x2000,
+    MIPS_linkage_name = 0x2007,
+    GNU_call_site_value = 0x2111,
+    GNU_call_site_data_value = 0x2112,
+    GNU_call_site_target = 0x2113,
+    GNU_call_site_target_clobbered = 0x2114,
+    GNU_tail_call = 0x2115,
+    GNU_all_tail_call_sites = 0x2116,
+    GNU_all_call_sites = 0x2117,
+    GNU_all_source_call_sites = 0x2118,
+    GNU_dwo_name = 0x2130,
+    GNU_dwo_id = 0x2131,
+    GNU_ranges_base = 0x2132,
+    GNU_addr_base = 0x2133,
+    GNU_pubnames = 0x2134,
+    GNU_pubtypes = 0x2135,
+    GNU_locviews = 0x2137,
+    GNU_entry_view = 0x2138,
     hi_user = 0x3fff,
 };
 enum class dw_form {
@@ -190,8 +253,591 @@ enum class dw_form {
     exprloc = 0x18,
     flag_present = 0x19,
     ref_sig8 = 0x20,
+    strx = 0x1a,
+    addrx = 0x1b,
+    ref_sup4 = 0x1c,
+    strp_sup = 0x1d,
+    data16 = 0x1e,
+    line_strp = 0x1f,
+    implicit_const = 0x21,
+    loclistx = 0x22,
+    rnglistx = 0x23,
+    ref_sup8 = 0x24,
+    strx1 = 0x25,
+    strx2 = 0x26,
+    strx3 = 0x27,
+    strx4 = 0x28,
+    addrx1 = 0x29,
+    addrx2 = 0x2a,
+    addrx3 = 0x2b,
+    addrx4 = 0x2c,
+    GNU_addr_index = 0x1f01,
+    GNU_str_index = 0x1f02,
+    GNU_ref_alt = 0x1f20,
+    GNU_strp_alt = 0x1f21,
 };
+enum class dw_ut : uint8_t {
+    compile = 0x01,
+    type = 0x02,
+    partial = 0x03,
+    skeleton = 0x04,
+    split_compile = 0x05,
+    split_type = 0x06,
+    lo_user = 0x80,
+    hi_user = 0xff,
+};
+//column ids of the .debug_cu_index/.debug_tu_index section tables, DWARF 5 numbering
+enum class dw_sect : uint8_t {
+    info = 1,
+    types = 2,
+    abbrev = 3,
+    line = 4,
+    loclists = 5,
+    str_offsets = 6,
+    macro = 7,
+    rnglists = 8,
+    //GNU version 2 packages number some columns differently, these are what they're mapped to
+    loc = 9,
+    macinfo = 10,
+};
+enum class dw_lle : uint8_t {
+    end_of_list = 0x00,
+    base_addressx = 0x01,
+    startx_endx = 0x02,
+    startx_length = 0x03,
+    offset_pair = 0x04,
+    default_location = 0x05,
+    base_address = 0x06,
+    start_end = 0x07,
+    start_length = 0x08,
+    GNU_view_pair = 0x09,
+};
+enum class dw_rle : uint8_t {
+    end_of_list = 0x00,
+    base_addressx = 0x01,
+    startx_endx = 0x02,
+    startx_length = 0x03,
+    offset_pair = 0x04,
+    base_address = 0x05,
+    start_end = 0x06,
+    start_length = 0x07,
+};
+
+enum class dw_lns : uint8_t {
+    copy = 0x01,
+    advance_pc = 0x02,
+    advance_line = 0x03,
+    set_file = 0x04,
+    set_column = 0x05,
+    negate_stmt = 0x06,
+    set_basic_block = 0x07,
+    const_add_pc = 0x08,
+    fixed_advance_pc = 0x09,
+    set_prologue_end = 0x0a,
+    set_epilogue_begin = 0x0b,
+    set_isa = 0x0c,
+};
+
+enum class dw_lne : uint8_t {
+    end_sequence = 0x01,
+    set_address = 0x02,
+    define_file = 0x03,
+    set_discriminator = 0x04,
+};
+
+enum class dw_lnct : uint16_t {
+    path = 0x1,
+    directory_index = 0x2,
+    timestamp = 0x3,
+    size = 0x4,
+    MD5 = 0x5,
+};
+
+enum class dw_op : uint8_t {
+    addr = 0x03,
+    deref = 0x06,
+    const1u = 0x08,
+    const1s = 0x09,
+    const2u = 0x0a,
+    const2s = 0x0b,
+    const4u = 0x0c,
+    const4s = 0x0d,
+    const8u = 0x0e,
+    const8s = 0x0f,
+    constu = 0x10,
+    consts = 0x11,
+    dup = 0x12,
+    drop = 0x13,
+    over = 0x14,
+    pick = 0x15,
+    swap = 0x16,
+    rot = 0x17,
+    xderef = 0x18,
+    abs = 0x19,
+    and_ = 0x1a,
+    div = 0x1b,
+    minus = 0x1c,
+    mod = 0x1d,
+    mul = 0x1e,
+    neg = 0x1f,
+    not_ = 0x20,
+    or_ = 0x21,
+    plus = 0x22,
+    plus_uconst = 0x23,
+    shl = 0x24,
+    shr = 0x25,
+    shra = 0x26,
+    xor_ = 0x27,
+    bra = 0x28,
+    eq = 0x29,
+    ge = 0x2a,
+    gt = 0x2b,
+    le = 0x2c,
+    lt = 0x2d,
+    ne = 0x2e,
+    skip = 0x2f,
+    lit0 = 0x30,
+    lit31 = 0x4f,
+    reg0 = 0x50,
+    reg31 = 0x6f,
+    breg0 = 0x70,
+    breg31 = 0x8f,
+    regx = 0x90,
+    fbreg = 0x91,
+    bregx = 0x92,
+    piece = 0x93,
+    deref_size = 0x94,
+    xderef_size = 0x95,
+    nop = 0x96,
+    push_object_address = 0x97,
+    call2 = 0x98,
+    call4 = 0x99,
+    call_ref = 0x9a,
+    form_tls_address = 0x9b,
+    call_frame_cfa = 0x9c,
+    bit_piece = 0x9d,
+    implicit_value = 0x9e,
+    stack_value = 0x9f,
+    implicit_pointer = 0xa0,
+    addrx = 0xa1,
+    constx = 0xa2,
+    entry_value = 0xa3,
+    const_type = 0xa4,
+    regval_type = 0xa5,
+    deref_type = 0xa6,
+    xderef_type = 0xa7,
+    convert = 0xa8,
+    reinterpret = 0xa9,
+    lo_user = 0xe0,
+    GNU_push_tls_address = 0xe0,
+    GNU_uninit = 0xf0,
+    GNU_entry_value = 0xf3,
+    GNU_parameter_ref = 0xfa,
+    GNU_addr_index = 0xfb,
+    GNU_const_index = 0xfc,
+    hi_user = 0xff,
+};
+enum class dw_cfa : uint8_t {
+    advance_loc = 0x40,
+    offset = 0x80,
+    restore = 0xc0,
+    nop = 0x00,
+    set_loc = 0x01,
+    advance_loc1 = 0x02,
+    advance_loc2 = 0x03,
+    advance_loc4 = 0x04,
+    offset_extended = 0x05,
+    restore_extended = 0x06,
+    undefined = 0x07,
+    same_value = 0x08,
+    register_ = 0x09,
+    remember_state = 0x0a,
+    restore_state = 0x0b,
+    def_cfa = 0x0c,
+    def_cfa_register = 0x0d,
+    def_cfa_offset = 0x0e,
+    def_cfa_expression = 0x0f,
+    expression = 0x10,
+    offset_extended_sf = 0x11,
+    def_cfa_sf = 0x12,
+    def_cfa_offset_sf = 0x13,
+    val_offset = 0x14,
+    val_offset_sf = 0x15,
+    val_expression = 0x16,
+    lo_user = 0x1c,
+    GNU_window_save = 0x2d,
+    GNU_args_size = 0x2e,
+    GNU_negative_offset_extended = 0x2f,
+    hi_user = 0x3f,
+};
+enum class dw_eh_pe : uint8_t {
+    absptr = 0x00,
+    uleb128 = 0x01,
+    udata2 = 0x02,
+    udata4 = 0x03,
+    udata8 = 0x04,
+    sleb128 = 0x09,
+    sdata2 = 0x0a,
+    sdata4 = 0x0b,
+    sdata8 = 0x0c,
+    pcrel = 0x10,
+    textrel = 0x20,
+    datarel = 0x30,
+    funcrel = 0x40,
+    aligned = 0x50,
+    indirect = 0x80,
+    omit = 0xff,
+};
+
+template<typename E>
+struct enum_name {
+    E value;
+    std::string_view name;
+};
+
+//names without the DW_TAG_/DW_AT_/DW_FORM_ prefix, sorted by value
+inline constexpr enum_name<dw_tag> dw_tag_names[] = {
+    {dw_tag::array_type, "array_type"},
+    {dw_tag::class_type, "class_type"},
+    {dw_tag::entry_point, "entry_point"},
+    {dw_tag::enumeration_type, "enumeration_type"},
+    {dw_tag::formal_parameter, "formal_parameter"},
+    {dw_tag::imported_declaration, "imported_declaration"},
+    {dw_tag::label, "label"},
+    {dw_tag::lexical_block, "lexical_block"},
+    {dw_tag::member, "member"},
+    {dw_tag::pointer_type, "pointer_type"},
+    {dw_tag::reference_type, "reference_type"},
+    {dw_tag::compile_unit, "compile_unit"},
+    {dw_tag::string_type, "string_type"},
+    {dw_tag::structure_type, "structure_type"},
+    {dw_tag::subroutine_type, "subroutine_type"},
+    {dw_tag::typedef_, "typedef"},
+    {dw_tag::union_type, "union_type"},
+    {dw_tag::unspecified_parameters, "unspecified_parameters"},
+    {dw_tag::variant, "variant"},
+    {dw_tag::common_block, "common_block"},
+    {dw_tag::common_inclusion, "common_inclusion"},
+    {dw_tag::inheritance, "inheritance"},
+    {dw_tag::inlined_subroutine, "inlined_subroutine"},
+    {dw_tag::module, "module"},
+    {dw_tag::ptr_to_member_type, "ptr_to_member_type"},
+    {dw_tag::set_type, "set_type"},
+    {dw_tag::subrange_type, "subrange_type"},
+    {dw_tag::with_stmt, "with_stmt"},
+    {dw_tag::access_declaration, "access_declaration"},
+    {dw_tag::base_type, "base_type"},
+    {dw_tag::catch_block, "catch_block"},
+    {dw_tag::const_type, "const_type"},
+    {dw_tag::constant, "constant"},
+    {dw_tag::enumerator, "enumerator"},
+    {dw_tag::file_type, "file_type"},
+    {dw_tag::friend_, "friend"},
+    {dw_tag::namelist, "namelist"},
+    {dw_tag::namelist_item, "namelist_item"},
+    {dw_tag::packed_type, "packed_type"},
+    {dw_tag::subprogram, "subprogram"},
+    {dw_tag::template_type_parameter, "template_type_parameter"},
+    {dw_tag::template_value_parameter, "template_value_parameter"},
+    {dw_tag::thrown_type, "thrown_type"},
+    {dw_tag::try_block, "try_block"},
+    {dw_tag::variant_part, "variant_part"},
+    {dw_tag::variable, "variable"},
+    {dw_tag::volatile_type, "volatile_type"},
+    {dw_tag::dwarf_procedure, "dwarf_procedure"},
+    {dw_tag::restrict_type, "restrict_type"},
+    {dw_tag::interface_type, "interface_type"},
+    {dw_tag::namespace_, "namespace"},
+    {dw_tag::imported_module, "imported_module"},
+    {dw_tag::unspecified_type, "unspecified_type"},
+    {dw_tag::partial_unit, "partial_unit"},
+    {dw_tag::imported_unit, "imported_unit"},
+    {dw_tag::condition, "condition"},
+    {dw_tag::shared_type, "shared_type"},
+    {dw_tag::type_unit, "type_unit"},
+    {dw_tag::rvalue_reference_type, "rvalue_reference_type"},
+    {dw_tag::template_alias, "template_alias"},
+    {dw_tag::coarray_type, "coarray_type"},
+    {dw_tag::generic_subrange, "generic_subrange"},
+    {dw_tag::dynamic_type, "dynamic_type"},
+    {dw_tag::atomic_type, "atomic_type"},
+    {dw_tag::call_site, "call_site"},
+    {dw_tag::call_site_parameter, "call_site_parameter"},
+    {dw_tag::skeleton_unit, "skeleton_unit"},
+    {dw_tag::immutable_type, "immutable_type"},
+    {dw_tag::GNU_call_site, "GNU_call_site"},
+    {dw_tag::GNU_call_site_parameter, "GNU_call_site_parameter"},
+};
+inline constexpr enum_name<dw_at> dw_at_names[] = {
+    {dw_at::sibling, "sibling"},
+    {dw_at::location, "location"},
+    {dw_at::name, "name"},
+    {dw_at::ordering, "ordering"},
+    {dw_at::byte_size, "byte_size"},
+    {dw_at::bit_offset, "bit_offset"},
+    {dw_at::bit_size, "bit_size"},
+    {dw_at::stmt_list, "stmt_list"},
+    {dw_at::low_pc, "low_pc"},
+    {dw_at::high_pc, "high_pc"},
+    {dw_at::language, "language"},
+    {dw_at::discr, "discr"},
+    {dw_at::discr_value, "discr_value"},
+    {dw_at::visibility, "visibility"},
+    {dw_at::import, "import"},
+    {dw_at::string_length, "string_length"},
+    {dw_at::common_reference, "common_reference"},
+    {dw_at::comp_dir, "comp_dir"},
+    {dw_at::const_value, "const_value"},
+    {dw_at::containing_type, "containing_type"},
+    {dw_at::default_value, "default_value"},
+    {dw_at::inline_, "inline"},
+    {dw_at::is_optional, "is_optional"},
+    {dw_at::lower_bound, "lower_bound"},
+    {dw_at::producer, "producer"},
+    {dw_at::prototyped, "prototyped"},
+    {dw_at::return_addr, "return_addr"},
+    {dw_at::start_scope, "start_scope"},
+    {dw_at::bit_stride, "bit_stride"},
+    {dw_at::upper_bound, "upper_bound"},
+    {dw_at::abstract_origin, "abstract_origin"},
+    {dw_at::accessibility, "accessibility"},
+    {dw_at::address_class, "address_class"},
+    {dw_at::artificial, "artificial"},
+    {dw_at::base_types, "base_types"},
+    {dw_at::calling_convention, "calling_convention"},
+    {dw_at::count, "count"},
+    {dw_at::data_member_location, "data_member_location"},
+    {dw_at::decl_column, "decl_column"},
+    {dw_at::decl_file, "decl_file"},
+    {dw_at::decl_line, "decl_line"},
+    {dw_at::declaration, "declaration"},
+    {dw_at::discr_list, "discr_list"},
+    {dw_at::encoding, "encoding"},
+    {dw_at::external, "external"},
+    {dw_at::frame_base, "frame_base"},
+    {dw_at::friend_, "friend"},
+    {dw_at::identifier_case, "identifier_case"},
+    {dw_at::macro_info, "macro_info"},
+    {dw_at::namelist_item, "namelist_item"},
+    {dw_at::priority, "priority"},
+    {dw_at::segment, "segment"},
+    {dw_at::specification, "specification"},
+    {dw_at::static_link, "static_link"},
+    {dw_at::type, "type"},
+    {dw_at::use_location, "use_location"},
+    {dw_at::variable_parameter, "variable_parameter"},
+    {dw_at::virtuality, "virtuality"},
+    {dw_at::vtable_elem_location, "vtable_elem_location"},
+    {dw_at::allocated, "allocated"},
+    {dw_at::associated, "associated"},
+    {dw_at::data_location, "data_location"},
+    {dw_at::byte_stride, "byte_stride"},
+    {dw_at::entry_pc, "entry_pc"},
+    {dw_at::use_UTF8, "use_UTF8"},
+    {dw_at::extension, "extension"},
+    {dw_at::ranges, "ranges"},
+    {dw_at::trampoline, "trampoline"},
+    {dw_at::call_column, "call_column"},
+    {dw_at::call_file, "call_file"},
+    {dw_at::call_line, "call_line"},
+    {dw_at::description, "description"},
+    {dw_at::binary_scale, "binary_scale"},
+    {dw_at::decimal_scale, "decimal_scale"},
+    {dw_at::small, "small"},
+    {dw_at::decimal_sign, "decimal_sign"},
+    {dw_at::digit_count, "digit_count"},
+    {dw_at::picture_string, "picture_string"},
+    {dw_at::mutable_, "mutable"},
+    {dw_at::threads_scaled, "threads_scaled"},
+    {dw_at::explicit_, "explicit"},
+    {dw_at::object_pointer, "object_pointer"},
+    {dw_at::endianity, "endianity"},
+    {dw_at::elemental, "elemental"},
+    {dw_at::pure, "pure"},
+    {dw_at::recursive, "recursive"},
+    {dw_at::signature, "signature"},
+    {dw_at::main_subprogram, "main_subprogram"},
+    {dw_at::data_bit_offset, "data_bit_offset"},
+    {dw_at::const_expr, "const_expr"},
+    {dw_at::enum_class, "enum_class"},
+    {dw_at::linkage_name, "linkage_name"},
+    {dw_at::string_length_bit_size, "string_length_bit_size"},
+    {dw_at::string_length_byte_size, "string_length_byte_size"},
+    {dw_at::rank, "rank"},
+    {dw_at::str_offsets_base, "str_offsets_base"},
+    {dw_at::addr_base, "addr_base"},
+    {dw_at::rnglists_base, "rnglists_base"},
+    {dw_at::dwo_name, "dwo_name"},
+    {dw_at::reference, "reference"},
+    {dw_at::rvalue_reference, "rvalue_reference"},
+    {dw_at::macros, "macros"},
+    {dw_at::call_all_calls, "call_all_calls"},
+    {dw_at::call_all_source_calls, "call_all_source_calls"},
+    {dw_at::call_all_tail_calls, "call_all_tail_calls"},
+    {dw_at::call_return_pc, "call_return_pc"},
+    {dw_at::call_value, "call_value"},
+    {dw_at::call_origin, "call_origin"},
+    {dw_at::call_parameter, "call_parameter"},
+    {dw_at::call_pc, "call_pc"},
+    {dw_at::call_tail_call, "call_tail_call"},
+    {dw_at::call_target, "call_target"},
+    {dw_at::call_target_clobbered, "call_target_clobbered"},
+    {dw_at::call_data_location, "call_data_location"},
+    {dw_at::call_data_value, "call_data_value"},
+    {dw_at::noreturn, "noreturn"},
+    {dw_at::alignment, "alignment"},
+    {dw_at::export_symbols, "export_symbols"},
+    {dw_at::deleted, "deleted"},
+    {dw_at::defaulted, "defaulted"},
+    {dw_at::loclists_base, "loclists_base"},
+    {dw_at::MIPS_linkage_name, "MIPS_linkage_name"},
+    {dw_at::GNU_call_site_value, "GNU_call_site_value"},
+    {dw_at::GNU_call_site_data_value, "GNU_call_site_data_value"},
+    {dw_at::GNU_call_site_target, "GNU_call_site_target"},
+    {dw_at::GNU_call_site_target_clobbered, "GNU_call_site_target_clobbered"},
+    {dw_at::GNU_tail_call, "GNU_tail_call"},
+    {dw_at::GNU_all_tail_call_sites, "GNU_all_tail_call_sites"},
+    {dw_at::GNU_all_call_sites, "GNU_all_call_sites"},
+    {dw_at::GNU_all_source_call_sites, "GNU_all_source_call_sites"},
+    {dw_at::GNU_dwo_name, "GNU_dwo_name"},
+    {dw_at::GNU_dwo_id, "GNU_dwo_id"},
+    {dw_at::GNU_ranges_base, "GNU_ranges_base"},
+    {dw_at::GNU_addr_base, "GNU_addr_base"},
+    {dw_at::GNU_pubnames, "GNU_pubnames"},
+    {dw_at::GNU_pubtypes, "GNU_pubtypes"},
+    {dw_at::GNU_locviews, "GNU_locviews"},
+    {dw_at::GNU_entry_view, "GNU_entry_view"},
+};
+inline constexpr enum_name<dw_form> dw_form_names[] = {
+    {dw_form::addr, "addr"},
+    {dw_form::block2, "block2"},
+    {dw_form::block4, "block4"},
+    {dw_form::data2, "data2"},
+    {dw_form::data4, "data4"},
+    {dw_form::data8, "data8"},
+    {dw_form::string, "string"},
+    {dw_form::block, "block"},
+    {dw_form::block1, "block1"},
+    {dw_form::data1, "data1"},
+    {dw_form::flag, "flag"},
+    {dw_form::sdata, "sdata"},
+    {dw_form::strp, "strp"},
+    {dw_form::udata, "udata"},
+    {dw_form::ref_addr, "ref_addr"},
+    {dw_form::ref1, "ref1"},
+    {dw_form::ref2, "ref2"},
+    {dw_form::ref4, "ref4"},
+    {dw_form::ref8, "ref8"},
+    {dw_form::ref_udata, "ref_udata"},
+    {dw_form::indirect, "indirect"},
+    {dw_form::sec_offset, "sec_offset"},
+    {dw_form::exprloc, "exprloc"},
+    {dw_form::flag_present, "flag_present"},
+    {dw_form::strx, "strx"},
+    {dw_form::addrx, "addrx"},
+    {dw_form::ref_sup4, "ref_sup4"},
+    {dw_form::strp_sup, "strp_sup"},
+    {dw_form::data16, "data16"},
+    {dw_form::line_strp, "line_strp"},
+    {dw_form::ref_sig8, "ref_sig8"},
+    {dw_form::implicit_const, "implicit_const"},
+    {dw_form::loclistx, "loclistx"},
+    {dw_form::rnglistx, "rnglistx"},
+    {dw_form::ref_sup8, "ref_sup8"},
+    {dw_form::strx1, "strx1"},
+    {dw_form::strx2, "strx2"},
+    {dw_form::strx3, "strx3"},
+    {dw_form::strx4, "strx4"},
+    {dw_form::addrx1, "addrx1"},
+    {dw_form::addrx2, "addrx2"},
+    {dw_form::addrx3, "addrx3"},
+    {dw_form::addrx4, "addrx4"},
+    {dw_form::GNU_addr_index, "GNU_addr_index"},
+    {dw_form::GNU_str_index, "GNU_str_index"},
+    {dw_form::GNU_ref_alt, "GNU_ref_alt"},
+    {dw_form::GNU_strp_alt, "GNU_strp_alt"},
+};
+
+template<typename E, size_t N>
+constexpr bool sorted_by_value(const enum_name<E> (&names)[N]) {
+    for (size_t i = 1; i < N; i++) {
+        if (names[i - 1].value >= names[i].value) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(sorted_by_value(dw_tag_names));
+static_assert(sorted_by_value(dw_at_names));
+static_assert(sorted_by_value(dw_form_names));
+
+template<typename E, size_t N>
+constexpr std::array<enum_name<E>, N> sorted_by_name(const enum_name<E> (&names)[N]) {
+    std::array<enum_name<E>, N> sorted;
+    std::copy(std::begin(names), std::end(names), sorted.begin());
+    std::sort(sorted.begin(), sorted.end(), [](const enum_name<E>& a, const enum_name<E>& b) {
+        return a.name < b.name;
+    });
+    return sorted;
+}
+inline constexpr auto dw_tag_names_by_name = sorted_by_name(dw_tag_names);
+inline constexpr auto dw_at_names_by_name = sorted_by_name(dw_at_names);
+inline constexpr auto dw_form_names_by_name = sorted_by_name(dw_form_names);
+
+//the value's name, empty for values not in the table (vendor extensions and unknown values)
+template<typename E, size_t N>
+constexpr std::string_view enum_to_string_view(const enum_name<E> (&names)[N], E value) {
+    auto it = std::lower_bound(std::begin(names), std::end(names), value, [](const enum_name<E>& n, E v) {
+        return n.value < v;
+    });
+    if (it == std::end(names) || it->value != value) {
+        return {};
+    }
+    return it->name;
+}
+template<typename E, size_t N>
+constexpr std::optional<E> enum_from_string(const std::array<enum_name<E>, N>& by_name, std::string_view name) {
+    auto it = std::lower_bound(by_name.begin(), by_name.end(), name, [](const enum_name<E>& n, std::string_view s) {
+        return n.name < s;
+    });
+    if (it == by_name.end() || it->name != name) {
+        return std::nullopt;
+    }
+    return it->value;
+}
+
+constexpr std::string_view to_string_view(dw_tag tag) {
+    return enum_to_string_view(dw_tag_names, tag);
+}
+constexpr std::string_view to_string_view(dw_at attr) {
+    return enum_to_string_view(dw_at_names, attr);
+}
+constexpr std::string_view to_string_view(dw_form form) {
+    return enum_to_string_view(dw_form_names, form);
+}
+//accepts names with or without the DW_TAG_/DW_AT_/DW_FORM_ prefix
+constexpr std::optional<dw_tag> tag_from_string(std::string_view name) {
+    if (name.starts_with("DW_TAG_")) {
+        name.remove_prefix(7);
+    }
+    return enum_from_string(dw_tag_names_by_name, name);
+}
+constexpr std::optional<dw_at> attribute_from_string(std::string_view name) {
+    if (name.starts_with("DW_AT_")) {
+        name.remove_prefix(6);
+    }
+    return enum_from_string(dw_at_names_by_name, name);
+}
+constexpr std::optional<dw_form> form_from_string(std::string_view name) {
+    if (name.starts_with("DW_FORM_")) {
+        name.remove_prefix(8);
+    }
+    return enum_from_string(dw_form_names_by_name, name);
+}
+static_assert(to_string_view(dw_tag::typedef_) == "typedef");
+static_assert(tag_from_string("DW_TAG_subprogram") == dw_tag::subprogram);
 
+//as to_string_view, with vendor and unknown values spelled out, for error messages
 std::string to_string(enum dw_tag tag);
 std::string to_string(enum dw_at attr);
 std::string to_string(enum dw_form form);
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <array>
+#include <vector>
+#include <optional>
+#include <functional>
+
+#include "serialise.hh"
+#include "leb128.hh"
+
+#include "enums.hh"
+
+namespace dwarfy {
+
+//everything outside the expression itself that a DW_OP program can ask about
+struct expression_context {
+    size_t address_size = 8;
+    //of the unit the expression belongs to, for DW_OP_implicit_pointer's DIE reference
+    size_t offset_size = 4;
+    std::endian endianness = std::endian::little;
+    //the address DW_AT_frame_base of the enclosing subprogram evaluates to
+    uint64_t frame_base = 0;
+    uint64_t cfa = 0;
+    uint64_t object_address = 0;
+    //pushed before the first operation, DW_CFA_expression and DW_CFA_val_expression start with the CFA
+    std::optional<uint64_t> initial_value;
+    std::function<std::optional<uint64_t>(uint16_t reg)> read_register;
+    std::function<std::optional<uint64_t>(uint64_t address, size_t size)> read_memory;
+    //DW_OP_addrx/constx, an index into .debug_addr from the unit's DW_AT_addr_base
+    std::function<std::optional<uint64_t>(uint64_t index)> read_address_index;
+    std::function<std::optional<uint64_t>(uint64_t offset)> tls_address;
+};
+
+enum class location_kind : uint8_t {
+    empty,
+    memory,
+    register_,
+    value,
+    implicit_value,
+    implicit_pointer,
+};
+
+struct location_piece {
+    location_kind kind = location_kind::empty;
+    uint16_t reg = 0;
+    //the address for memory, the value for value, the DIE offset for implicit_pointer
+    uint64_t value = 0;
+    //the byte offset into the pointed to object for implicit_pointer
+    int64_t offset = 0;
+    std::span<std::byte> bytes;
+    //0 for a location that isn't split into pieces
+    uint64_t size_bits = 0;
+    uint64_t bit_offset = 0;
+};
+
+struct location {
+    static constexpr size_t inline_pieces = 4;
+    std::array<location_piece, inline_pieces> inline_;
+    std::vector<location_piece> overflow;
+    size_t count = 0;
+
+    void push(const location_piece& p) {
+        if (count < inline_pieces) {
+            inline_[count] = p;
+        } else {
+            overflow.push_back(p);
+        }
+        count++;
+    }
+    size_t size() const {
+        return count;
+    }
+    const location_piece& operator[](size_t i) const {
+        return i < inline_pieces ? inline_[i] : overflow[i - inline_pieces];
+    }
+};
+
+location evaluate_expression(std::span<std::byte> expression, const expression_context& context);
+
+//the shapes that cover nearly every DW_AT_location compilers emit, evaluated without
+//decoding the expression again; anything else keeps its bytecode for the interpreter
+struct compiled_expression {
+    enum class kind : uint8_t {
+        empty,
+        addr,
+        fbreg,
+        breg,
+        reg,
+        cfa,
+        pieces,
+        interpreted,
+    };
+    struct piece {
+        kind k = kind::empty;
+        bool stack_value = false;
+        uint16_t reg = 0;
+        //the address for addr, the offset for fbreg/breg/cfa
+        int64_t offset = 0;
+        uint64_t size_bytes = 0;
+    };
+    static constexpr size_t max_pieces = 4;
+
+    kind k = kind::empty;
+    uint8_t piece_count = 0;
+    std::array<piece, max_pieces> pieces;
+    std::span<std::byte> bytecode;
+};
+
+compiled_expression compile_expression(std::span<std::byte> expression, size_t address_size, std::endian endianness = std::endian::little);
+location evaluate_expression(const compiled_expression& expression, const expression_context& context);
+
+}
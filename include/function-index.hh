@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "dwarfy.hh"
+
+namespace dwarfy {
+
+struct function_range {
+    uint64_t begin;
+    uint64_t end;
+    //points into the dwarf's string sections, valid as long as its mapping is
+    std::string_view name;
+};
+
+//address to enclosing function, from the DW_TAG_subprogram DIEs of every compile unit
+//inlined subroutines are not included, a pc resolves to the outermost function containing it
+class function_index {
+    std::vector<function_range> functions;
+public:
+    function_index() = default;
+    function_index(const dwarf& d);
+    const function_range* find(uint64_t pc) const;
+    size_t size() const {
+        return functions.size();
+    }
+    //sorted by begin address
+    const std::vector<function_range>& ranges() const {
+        return functions;
+    }
+};
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "dwarfy.hh"
+#include "aranges.hh"
+
+namespace dwarfy {
+
+struct line_row {
+    uint64_t address;
+    uint32_t file;
+    uint32_t line;
+    uint32_t column;
+    bool is_stmt;
+    bool end_sequence;
+};
+
+struct line_file {
+    std::string_view name;
+    uint64_t directory;
+};
+
+//the decoded line number program of one unit (DWARF 2 to 5)
+//files and directories are indexed the DWARF 5 way for every version: for earlier versions directory
+//0 is the unit's comp_dir and file 0 is a placeholder, so DW_AT_decl_file and friends index files directly
+class line_table {
+public:
+    uint16_t version = 0;
+    std::vector<std::string_view> directories;
+    std::vector<line_file> files;
+    //sequences sorted by address, each ending in an end_sequence row
+    std::vector<line_row> rows;
+
+    line_table() = default;
+    line_table(const dwarf& d, uint64_t offset, uint8_t address_size, std::string_view comp_dir = {});
+    //the row whose address range contains pc
+    const line_row* find(uint64_t pc) const;
+    std::string file_name(uint32_t file) const;
+};
+
+//the line table of the unit whose header is at cu_offset in .debug_info, from its DW_AT_stmt_list
+std::optional<line_table> read_line_table(const dwarf& d, uint64_t cu_offset);
+
+struct line_location {
+    std::string file;
+    uint32_t line;
+};
+
+//pc to file and line through .debug_aranges, each unit's line table is decoded the first time a pc in
+//it is looked up and kept; one index can be shared between threads
+class line_index {
+    const dwarf& d;
+    cu_aranges aranges;
+    std::mutex m;
+    //nullptr for units without a line table
+    std::unordered_map<uint64_t, std::shared_ptr<const line_table>> tables;
+public:
+    line_index(const dwarf& d_);
+    std::optional<line_location> find(uint64_t pc);
+};
+
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+
+#include "leb128.hh"
+#include "serialise.hh"
+
+#include "enums.hh"
+
+namespace dwarfy {
+
+//what a range or location list needs from the unit that refers to it
+struct list_context {
+    uint16_t version = 4;
+    size_t address_size = 8;
+    size_t offset_size = 4;
+    std::endian endianness = std::endian::little;
+    //DW_AT_low_pc of the unit, the initial base address
+    uint64_t base_address = 0;
+    std::span<std::byte> debug_addr;
+    uint64_t addr_base = 0;
+    //DW_AT_rnglists_base/DW_AT_loclists_base, for rnglistx and loclistx
+    uint64_t rnglists_base = 0;
+    uint64_t loclists_base = 0;
+};
+
+struct address_range {
+    uint64_t begin;
+    uint64_t end;
+};
+
+struct location_list_entry {
+    uint64_t begin;
+    uint64_t end;
+    std::span<std::byte> expression;
+    //DW_LLE_default_location, which applies wherever no other entry does
+    bool is_default;
+};
+
+//.debug_ranges (DWARF 2-4) or .debug_rnglists (DWARF 5), decided by ctx.version
+class range_list {
+    std::span<std::byte> section;
+    uint64_t offset;
+    list_context ctx;
+public:
+    class sentinel {};
+    class iterator;
+    range_list(std::span<std::byte> section_, uint64_t offset_, const list_context& ctx_);
+    iterator begin() const;
+    sentinel end() const;
+};
+
+class range_list::iterator {
+    span_reader r;
+    list_context ctx;
+    address_range current;
+    bool done;
+    void next();
+public:
+    using iterator_concept  = std::input_iterator_tag;
+    using difference_type   = std::ptrdiff_t;
+    using value_type        = address_range;
+    using pointer           = value_type*;
+    using reference         = value_type&;
+    iterator();
+    iterator(span_reader r_, const list_context& ctx_);
+    bool operator==(sentinel) const;
+    const address_range& operator*() const;
+    iterator& operator++();
+    iterator operator++(int);
+};
+static_assert(std::input_iterator<range_list::iterator>);
+
+//.debug_loc (DWARF 2-4) or .debug_loclists (DWARF 5), decided by ctx.version
+class location_list {
+    std::span<std::byte> section;
+    uint64_t offset;
+    list_context ctx;
+public:
+    class sentinel {};
+    class iterator;
+    location_list(std::span<std::byte> section_, uint64_t offset_, const list_context& ctx_);
+    iterator begin() const;
+    sentinel end() const;
+};
+
+class location_list::iterator {
+    span_reader r;
+    list_context ctx;
+    location_list_entry current;
+    bool done;
+    void next();
+public:
+    using iterator_concept  = std::input_iterator_tag;
+    using difference_type   = std::ptrdiff_t;
+    using value_type        = location_list_entry;
+    using pointer           = value_type*;
+    using reference         = value_type&;
+    iterator();
+    iterator(span_reader r_, const list_context& ctx_);
+    bool operator==(sentinel) const;
+    const location_list_entry& operator*() const;
+    iterator& operator++();
+    iterator operator++(int);
+};
+static_assert(std::input_iterator<location_list::iterator>);
+
+//DW_FORM_addrx and the indexed list entries: the address at index in .debug_addr from ctx.addr_base,
+//bounds checked against the section
+uint64_t indexed_address(const list_context& ctx, uint64_t index);
+//DW_FORM_rnglistx/loclistx: the offset array after the list table header, relative to base
+uint64_t list_offset_from_index(std::span<std::byte> section, uint64_t base, uint64_t index, const list_context& ctx);
+
+//a location list flattened and sorted once, so each pc lookup is a single binary search
+//entries are the list's split into disjoint intervals, overlaps resolved in favour of the earlier entry
+struct location_index {
+    std::vector<location_list_entry> entries;
+    std::optional<location_list_entry> default_location;
+
+    location_index() = default;
+    location_index(const location_list& list);
+    std::optional<std::span<std::byte>> find(uint64_t pc) const;
+};
+
+//location indexes by list offset, for consumers that query the same variables at many pcs
+//unlike the dwarf it comes from, get fills in the map without a lock: keep one per thread
+struct location_index_cache {
+    std::span<std::byte> section;
+    list_context ctx;
+    std::unordered_map<uint64_t, location_index> indexes;
+
+    location_index_cache(std::span<std::byte> section_, const list_context& ctx_):
+        section(section_),
+        ctx(ctx_)
+    {}
+    const location_index& get(uint64_t offset);
+    std::optional<std::span<std::byte>> find(uint64_t offset, uint64_t pc) {
+        return get(offset).find(pc);
+    }
+};
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace elfy {
+
+//a read only mmap of a whole file, the fd stays open for the lifetime of the mapping
+struct mapped_file {
+    std::span<std::byte> data;
+    std::string filename;
+    int fd;
+
+    mapped_file(std::string filename_);
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    ~mapped_file();
+};
+
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "core-file.hh"
+#include "debug-file.hh"
+#include "function-index.hh"
+#include "line-table.hh"
+
+namespace dwarfy {
+
+//one binary mapped into a process
+//load_address is the load bias (dl_iterate_phdr's dlpi_addr), so a runtime address maps to
+//address - load_address in the file; size may be 0 if unknown, the module then extends to the next one
+struct module_mapping {
+    std::string path;
+    //hex, used to find the file under the debug directories' .build-id trees when path is empty
+    std::string build_id;
+    uint64_t load_address;
+    uint64_t size = 0;
+};
+
+uint64_t next_module_id();
+
+struct loaded_module {
+    debug_file_pair files;
+    //never reused, unlike the module's address, so caches can key on it
+    uint64_t id;
+    //set once the background build finishes, lookups use the symbol table until then
+    std::atomic<const function_index*> functions{nullptr};
+    std::unique_ptr<function_index> functions_storage;
+    //built on first use, by module_lines
+    std::once_flag lines_once;
+    std::unique_ptr<line_index> lines;
+
+    loaded_module(debug_file_pair files_):
+        files(std::move(files_)),
+        id(next_module_id())
+    {}
+};
+
+struct symbolized_frame {
+    uint64_t address;
+    //index into the module_set's mappings, -1 if the address isn't in any module
+    ptrdiff_t module = -1;
+    std::string function;
+    //offset of address from the start of function
+    uint64_t offset = 0;
+};
+
+//maps path and builds its loaded_module, the function index is left for build_function_index
+std::shared_ptr<loaded_module> open_module(debug_file_resolver& resolver, const std::string& path);
+void build_function_index(loaded_module& m);
+line_index& module_lines(loaded_module& m);
+//fills in f's function and offset for the module relative pc, false if nothing in m contains it
+bool symbolize(loaded_module& m, uint64_t pc, symbolized_frame& f);
+
+//the mapped files of a crashed process, for a module_set to symbolize its threads' addresses
+std::vector<module_mapping> core_modules(const elfy::core_file& core);
+
+//opened modules and their function indexes, keyed by whatever names a file to the caller (a path, or
+//a path with its device and inode) and shared by every lookup through the cache
+//each key is opened once, concurrent lookups of it wait for that open; a file that isn't there is
+//cached as nullptr so it isn't searched for again, but errors opening one (which may be transient,
+//like running out of fds) are thrown and the next lookup tries again
+//files with the same build-id share one module, so a library reached through different paths
+//(containers, symlinked installs) is only opened and indexed once
+//about capacity keys are kept in an LRU split into lock shards by key, so lookups of different files
+//don't contend; with builder_threads the function indexes are built by a background thread pool so a
+//lookup never waits on one, without them the opening lookup builds it before the module is handed out
+class module_cache {
+    struct entry {
+        std::once_flag once;
+        std::shared_ptr<loaded_module> module;
+    };
+    struct shard {
+        std::mutex m;
+        std::list<std::pair<std::string, std::shared_ptr<entry>>> lru;
+        std::unordered_map<std::string, decltype(lru)::iterator> entries;
+    };
+
+    size_t capacity_per_shard;
+    std::vector<shard> shards;
+
+    std::mutex build_ids_m;
+    //weak so evicted modules can go, a file opened again after that gets a new module
+    std::unordered_map<std::string, std::weak_ptr<loaded_module>> by_build_id;
+
+    std::mutex queue_m;
+    std::condition_variable queue_cv;
+    //weak so the queue doesn't keep evicted modules (and their fds) alive
+    std::deque<std::weak_ptr<loaded_module>> queue;
+    //queued or being built
+    size_t pending = 0;
+    bool stopping = false;
+    std::vector<std::thread> builders;
+
+    std::shared_ptr<loaded_module> open(const std::string& path);
+    void build_indexes();
+public:
+    //set its debug_directories before the first lookup
+    debug_file_resolver resolver;
+
+    module_cache(size_t capacity = 1024, size_t shard_count = 16, unsigned builder_threads = 0);
+    module_cache(const module_cache&) = delete;
+    module_cache& operator=(const module_cache&) = delete;
+    ~module_cache();
+
+    //the module for key; on a miss locate gives the path to open, empty (or a path that can't be read)
+    //if the file isn't there, in which case the module is nullptr
+    std::shared_ptr<loaded_module> get(const std::string& key, const std::function<std::string()>& locate);
+    std::shared_ptr<loaded_module> get(const std::string& path);
+    //blocks until every module opened so far has its function index
+    void wait_for_indexes();
+    size_t size();
+};
+
+//routes addresses to the modules of a process through a table sorted by load address, opening and
+//indexing modules on first use through a module_cache with background index builders
+class module_set {
+    std::vector<module_mapping> mappings;
+    //indexes into mappings, sorted by load address
+    std::vector<size_t> by_address;
+    std::vector<uint64_t> load_addresses;
+    module_cache cache;
+
+    //the file to open for mappings[i], empty if it can't be found
+    std::string locate(size_t i);
+public:
+    //set its debug_directories before the first lookup
+    debug_file_resolver& resolver;
+
+    module_set(std::vector<module_mapping> mappings_, size_t max_open_modules = 256, size_t shard_count = 16, unsigned builder_threads = 2);
+    module_set(const module_set&) = delete;
+    module_set& operator=(const module_set&) = delete;
+
+    //index into mappings() of the module containing address, if any
+    std::optional<size_t> find_module(uint64_t address) const;
+    const std::vector<module_mapping>& modules() const {
+        return mappings;
+    }
+    //the opened module, from the LRU if it's there; nullptr if the file can't be found
+    std::shared_ptr<loaded_module> module(size_t i);
+
+    symbolized_frame symbolize(uint64_t address);
+    std::vector<symbolized_frame> symbolize(std::span<const uint64_t> addresses);
+    //blocks until every module opened so far has its function index
+    void wait_for_indexes();
+};
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <exception>
+
+namespace dwarfy {
+
+inline unsigned parallel_threads(unsigned requested = 0) {
+    if (requested != 0) {
+        return requested;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+//calls f(worker, begin, end) over [0, n) in chunks of grain, workers are numbered [0, threads)
+//the first exception thrown by any worker is rethrown on the calling thread
+template<typename F>
+void parallel_for(size_t n, size_t grain, unsigned threads, F f) {
+    threads = parallel_threads(threads);
+    grain = std::max<size_t>(grain, 1);
+    threads = std::min<size_t>(threads, (n + grain - 1) / grain);
+    if (threads <= 1) {
+        if (n > 0) {
+            f(0u, size_t{0}, n);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next = 0;
+    std::exception_ptr error;
+    std::atomic_flag error_set;
+    auto work = [&](unsigned worker) {
+        try {
+            while (true) {
+                size_t begin = next.fetch_add(grain, std::memory_order_relaxed);
+                if (begin >= n) {
+                    break;
+                }
+                f(worker, begin, std::min(begin + grain, n));
+            }
+        } catch (...) {
+            if (!error_set.test_and_set()) {
+                error = std::current_exception();
+            }
+            next = n;
+        }
+    };
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned i = 1; i < threads; i++) {
+        pool.emplace_back(work, i);
+    }
+    work(0);
+    for (auto& t: pool) {
+        t.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+}
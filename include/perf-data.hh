@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "serialise.hh"
+
+namespace dwarfy {
+
+//the parts of a perf_event_attr the record decoders need
+struct perf_event_attributes {
+    uint32_t type;
+    uint64_t config;
+    //PERF_SAMPLE_* bits, the fields present in each PERF_RECORD_SAMPLE, in bit order
+    uint64_t sample_type;
+    //PERF_FORMAT_* bits, the layout of PERF_SAMPLE_READ
+    uint64_t read_format;
+    //non-sample records end with the sample's id fields
+    bool sample_id_all;
+    //the sample ids of the events opened with these attributes, for PERF_SAMPLE_IDENTIFIER
+    std::vector<uint64_t> ids;
+};
+
+//a record's header and its body, a view into the file
+struct perf_record {
+    //PERF_RECORD_*
+    uint32_t type;
+    uint16_t misc;
+    std::span<std::byte> body;
+};
+
+enum perf_record_type : uint32_t {
+    perf_record_mmap = 1,
+    perf_record_comm = 3,
+    perf_record_exit = 4,
+    perf_record_fork = 7,
+    perf_record_sample = 9,
+    perf_record_mmap2 = 10,
+};
+
+//PERF_RECORD_MMAP and PERF_RECORD_MMAP2
+struct perf_mmap {
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t start;
+    uint64_t length;
+    //offset into the file of start, in bytes
+    uint64_t page_offset;
+    //makedev(major, minor), 0 for PERF_RECORD_MMAP and for MMAP2 records carrying a build-id instead
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    bool executable;
+    std::string_view path;
+};
+
+struct perf_comm {
+    uint32_t pid;
+    uint32_t tid;
+    //PERF_RECORD_MISC_COMM_EXEC, the process image was replaced
+    bool exec;
+    std::string_view comm;
+};
+
+//PERF_RECORD_FORK and PERF_RECORD_EXIT
+struct perf_task {
+    uint32_t pid;
+    uint32_t ppid;
+    uint32_t tid;
+    uint32_t ptid;
+};
+
+//the PERF_SAMPLE_CALLCHAIN ips, innermost first, read in place
+//entries from PERF_CONTEXT_KERNEL on are kernel addresses, up to a PERF_CONTEXT_USER marker
+struct perf_callchain {
+    std::span<std::byte> data;
+    std::endian endianness = std::endian::little;
+
+    size_t size() const {
+        return data.size() / sizeof(uint64_t);
+    }
+    uint64_t operator[](size_t i) const {
+        span_reader r {data.subspan(i * sizeof(uint64_t))};
+        r.file_endianness = endianness;
+        uint64_t ip;
+        r & ip;
+        return ip;
+    }
+};
+
+//the markers perf puts in callchains, "ips" of at least this are contexts
+constexpr uint64_t perf_context_max = static_cast<uint64_t>(-4095);
+constexpr uint64_t perf_context_kernel = static_cast<uint64_t>(-128);
+constexpr uint64_t perf_context_user = static_cast<uint64_t>(-512);
+
+//the fields of a PERF_RECORD_SAMPLE up to its callchain, the ones after it (registers, stack
+//copies, raw data) aren't decoded
+struct perf_sample {
+    uint64_t ip = 0;
+    uint32_t pid = 0;
+    uint32_t tid = 0;
+    uint64_t time = 0;
+    uint64_t period = 1;
+    //PERF_RECORD_MISC_KERNEL/USER and the like
+    uint16_t cpu_mode = 0;
+    perf_callchain callchain;
+};
+
+//a perf.data file, as written by perf record: the file header, the event attributes and the data
+//section's records, which are decoded in place, one at a time, from the mapped file
+//pipe mode files (perf record -o -) and the feature sections after the data aren't read
+class perf_data {
+    std::span<std::byte> data;
+    std::endian endianness_;
+    std::vector<perf_event_attributes> attributes_;
+    std::span<std::byte> records;
+
+    const perf_event_attributes& sample_attributes(std::span<std::byte> body) const;
+public:
+    perf_data(std::span<std::byte> data_);
+    std::endian endianness() const {
+        return endianness_;
+    }
+    const std::vector<perf_event_attributes>& attributes() const {
+        return attributes_;
+    }
+
+    //reads records in file order; position starts at 0 and is advanced past each one
+    bool next(uint64_t& position, perf_record& record) const;
+
+    perf_mmap decode_mmap(const perf_record& record) const;
+    perf_comm decode_comm(const perf_record& record) const;
+    perf_task decode_task(const perf_record& record) const;
+    perf_sample decode_sample(const perf_record& record) const;
+};
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "perf-data.hh"
+#include "process-maps.hh"
+
+namespace dwarfy {
+
+struct folded_stack {
+    //"comm;outermost;...;innermost", the input flamegraph.pl takes
+    std::string stack;
+    uint64_t count;
+};
+
+struct folded_stacks {
+    //sorted by stack
+    std::vector<folded_stack> stacks;
+    uint64_t samples = 0;
+};
+
+//folds every sample of a perf.data into counted stacks
+//the calling thread reads the records, tracks each process's executable mappings through
+//MMAP/MMAP2, COMM and FORK, and turns each sample's ips into (file, file offset) frames; batches of
+//those go to threads workers, which open and index the files through cache and symbolize and count
+//the stacks, so decoding, symbolizing and counting overlap; the workers' counts are merged at the end
+//frames in files that can't be found are "[file name]", unmapped ones "[unknown]" and each run of
+//kernel frames is one "[kernel]"
+folded_stacks fold_perf_samples(const perf_data& perf, module_cache& cache, unsigned threads = 0, size_t batch_samples = 4096);
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <sys/types.h>
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "module-set.hh"
+
+namespace dwarfy {
+
+//one line of /proc/<pid>/maps
+struct process_mapping {
+    uint64_t start;
+    uint64_t end;
+    uint64_t file_offset;
+    bool executable;
+    //makedev(major, minor) of the "major:minor" field
+    uint64_t device;
+    uint64_t inode;
+    //empty for anonymous mappings, "[stack]" and the like for special ones
+    std::string path;
+};
+
+std::vector<process_mapping> parse_process_maps(std::string_view maps);
+std::string read_process_maps(pid_t pid);
+
+//the module for a mapping of pid's, through cache, by path, device and inode; nullptr if its file isn't
+//there or can't be opened; pid 0 for processes that aren't running any more (recordings), whose paths
+//are opened as they are
+std::shared_ptr<loaded_module> open_mapping(module_cache& cache, const process_mapping& mapping, pid_t pid = 0);
+
+//the file mappings of one live process, kept current by refresh, and the runtime addresses in them
+//resolved through the shared module_cache
+//not thread safe, it's meant to be owned by whatever samples the process
+class process_modules {
+public:
+    struct module {
+        uint64_t start;
+        uint64_t end;
+        //runtime address - load_bias is the address in the file
+        uint64_t load_bias;
+        uint64_t device;
+        uint64_t inode;
+        std::string path;
+        //nullptr if the file couldn't be opened
+        std::shared_ptr<loaded_module> files;
+    };
+    //what a refresh changed, by start address
+    struct changes {
+        std::vector<uint64_t> added;
+        std::vector<uint64_t> removed;
+    };
+private:
+    pid_t pid_;
+    module_cache& cache;
+    //the maps contents of the last refresh, to skip parsing when nothing was mapped or unmapped
+    std::string maps;
+    //sorted by start address
+    std::vector<module> modules_;
+public:
+    process_modules(pid_t pid, module_cache& cache_);
+    pid_t pid() const {
+        return pid_;
+    }
+    //rereads /proc/<pid>/maps, modules whose mappings are unchanged keep their entries and only new
+    //ones (dlopen) are looked up in the cache
+    changes refresh();
+    const std::vector<module>& modules() const {
+        return modules_;
+    }
+    //index into modules() of the module containing address, if any
+    std::optional<size_t> find_module(uint64_t address) const;
+    //module in the frames is an index into modules()
+    std::vector<symbolized_frame> symbolize(std::span<const uint64_t> addresses) const;
+};
+
+}
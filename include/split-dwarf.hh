@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <array>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "dwarfy.hh"
+#include "mapped-file.hh"
+
+namespace dwarfy {
+
+//a CU in the main binary whose DIEs live in a .dwo file or .dwp package
+struct skeleton_unit {
+    //offset of the skeleton's unit header in .debug_info
+    uint64_t offset;
+    uint64_t dwo_id;
+    std::string dwo_name;
+    std::string comp_dir;
+    uint64_t addr_base;
+};
+
+struct section_contribution {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+//a unit's slice of each section of a .dwp package
+struct package_contribution {
+    std::array<section_contribution, 11> sections;
+    section_contribution& operator[](dw_sect s) {
+        return sections[static_cast<size_t>(s)];
+    }
+    const section_contribution& operator[](dw_sect s) const {
+        return sections[static_cast<size_t>(s)];
+    }
+};
+
+//.debug_cu_index or .debug_tu_index of a .dwp package (GNU version 2 or DWARF 5)
+struct package_index {
+    uint32_t version = 0;
+    uint32_t column_count = 0;
+    uint32_t unit_count = 0;
+    uint32_t slot_count = 0;
+    std::span<std::byte> hashes;
+    std::span<std::byte> indexes;
+    std::vector<dw_sect> columns;
+    std::span<std::byte> offsets;
+    std::span<std::byte> sizes;
+    std::endian endianness = std::endian::little;
+
+    package_index() = default;
+    package_index(std::span<std::byte> section, std::endian endianness_);
+    //one probe sequence through the index's own hash table
+    std::optional<package_contribution> find(uint64_t signature) const;
+};
+
+//finds and opens the split halves of a skeleton dwarf on demand
+//at most max_open_files .dwo mappings (or units sliced out of the package) are cached, least recently
+//used first out; a dwarf handed out keeps its mapping alive until the last reference to it goes away
+class split_dwarf {
+    //the .dwo's path, or empty for a package unit, which is keyed by its dwo_id or type signature
+    struct cache_key {
+        std::string path;
+        uint64_t signature = 0;
+        bool type_unit = false;
+
+        bool operator==(const cache_key&) const = default;
+    };
+    struct cached_dwo {
+        cache_key key;
+        std::shared_ptr<dwarf> d;
+    };
+
+    dwarf& skeleton;
+    std::vector<skeleton_unit> units;
+    size_t max_open_files;
+
+    std::shared_ptr<elfy::mapped_file> package_file;
+    std::optional<dwarf> package;
+    package_index cu_index;
+    package_index tu_index;
+
+    std::mutex m;
+    std::list<cached_dwo> lru;
+
+    std::shared_ptr<dwarf> cached(const cache_key& key);
+    //d unless another thread cached the same unit first
+    std::shared_ptr<dwarf> insert(cache_key key, std::shared_ptr<dwarf> d);
+    std::shared_ptr<dwarf> open_dwo(const std::string& path, uint64_t addr_base);
+    std::shared_ptr<dwarf> package_unit(const package_contribution& c, std::span<std::byte> debug_addr);
+public:
+    std::vector<std::string> search_paths;
+
+    split_dwarf(dwarf& skeleton_, size_t max_open_files_ = 64, const std::string& package_path = "");
+
+    const std::vector<skeleton_unit>& skeleton_units() const {
+        return units;
+    }
+    //index into skeleton_units() of the skeleton unit with its header at offset, if any
+    std::optional<size_t> find_unit(uint64_t offset) const;
+    //the split half of skeleton_units()[i], nullptr if it can't be found
+    //its .debug_addr is the skeleton's from the skeleton unit's DW_AT_addr_base on
+    std::shared_ptr<dwarf> unit(size_t i);
+    //the package's type unit with signature, through its .debug_tu_index, nullptr without a package
+    //or if it isn't there; a .dwo file holds its own type units, follow_signature on its unit finds them
+    std::shared_ptr<dwarf> type_unit(uint64_t signature);
+    size_t open_files();
+};
+
+std::vector<skeleton_unit> find_skeleton_units(const dwarf& d);
+
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "enums.hh"
+
+//per-dwarf instrumentation, compiled in with -DDWARFY_STATS=1 (meson configure -Dstats=true)
+//without it every recording call below is an empty inline function and dwarf_stats has no members
+#ifndef DWARFY_STATS
+#define DWARFY_STATS 0
+#endif
+
+namespace dwarfy {
+
+//phases can nest (abbrev_decode happens inside die_walk), each phase's time includes its children
+enum class phase : uint8_t {
+    section_lookup,
+    decompression,
+    abbrev_decode,
+    die_walk,
+    line_program,
+    count,
+};
+std::string to_string(phase p);
+
+enum class stats_section : uint8_t {
+    info,
+    abbrev,
+    str,
+    str_offsets,
+    line,
+    count,
+};
+std::string to_string(stats_section s);
+
+//standard forms by value, GNU forms (0x1f00 + n) after them at 0x40 + n, anything else at 0
+constexpr size_t form_slots = 0x80;
+constexpr size_t form_slot(dw_form form) {
+    size_t v = static_cast<size_t>(form);
+    if (v < 0x40) {
+        return v;
+    }
+    if (v >= 0x1f00 && v < 0x1f40) {
+        return 0x40 + (v - 0x1f00);
+    }
+    return 0;
+}
+
+struct phase_time {
+    uint64_t calls = 0;
+    uint64_t nanoseconds = 0;
+};
+
+//a snapshot of one dwarf's counters, all zero when built without DWARFY_STATS
+struct dwarf_counters {
+    bool enabled = DWARFY_STATS;
+    uint64_t dies_decoded = 0;
+    uint64_t abbrev_hits = 0;
+    uint64_t abbrev_misses = 0;
+    uint64_t leb128_bytes = 0;
+    std::array<uint64_t, static_cast<size_t>(stats_section::count)> section_bytes {};
+    //attribute forms decoded, indexed by form_slot
+    std::array<uint64_t, form_slots> forms {};
+    std::array<phase_time, static_cast<size_t>(phase::count)> phases {};
+
+    std::string to_json() const;
+};
+
+//rdtsc where there is one, it's a few cycles against ~20ns for clock_gettime
+inline uint64_t stats_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+//measured against steady_clock once, on first use
+double nanoseconds_per_tick();
+
+#if DWARFY_STATS
+
+//counters are bumped with relaxed atomic adds, dwarf read paths can run on many threads at once
+class dwarf_stats {
+    dwarf_counters c;
+    std::array<uint64_t, static_cast<size_t>(phase::count)> ticks {};
+
+    static void add(uint64_t& counter, uint64_t n) {
+        std::atomic_ref{counter}.fetch_add(n, std::memory_order_relaxed);
+    }
+public:
+    void die(size_t bytes) {
+        add(c.dies_decoded, 1);
+        add(c.section_bytes[static_cast<size_t>(stats_section::info)], bytes);
+    }
+    void form(dw_form form) {
+        add(c.forms[form_slot(form)], 1);
+    }
+    void leb128(size_t bytes) {
+        add(c.leb128_bytes, bytes);
+    }
+    void abbrev_hit() {
+        add(c.abbrev_hits, 1);
+    }
+    void abbrev_miss() {
+        add(c.abbrev_misses, 1);
+    }
+    void section_read(stats_section s, size_t bytes) {
+        add(c.section_bytes[static_cast<size_t>(s)], bytes);
+    }
+    void phase_done(phase p, uint64_t elapsed_ticks) {
+        add(c.phases[static_cast<size_t>(p)].calls, 1);
+        add(ticks[static_cast<size_t>(p)], elapsed_ticks);
+    }
+    dwarf_counters counters() const;
+};
+
+class scoped_phase {
+    dwarf_stats& stats;
+    phase p;
+    uint64_t start;
+public:
+    scoped_phase(dwarf_stats& stats_, phase p_): stats(stats_), p(p_), start(stats_ticks()) {}
+    ~scoped_phase() {
+        stats.phase_done(p, stats_ticks() - start);
+    }
+    scoped_phase(const scoped_phase&) = delete;
+    scoped_phase& operator=(const scoped_phase&) = delete;
+};
+
+#else
+
+class dwarf_stats {
+public:
+    void die(size_t bytes) {}
+    void form(dw_form form) {}
+    void leb128(size_t bytes) {}
+    void abbrev_hit() {}
+    void abbrev_miss() {}
+    void section_read(stats_section s, size_t bytes) {}
+    void phase_done(phase p, uint64_t elapsed_ticks) {}
+    dwarf_counters counters() const {
+        return {};
+    }
+};
+
+class scoped_phase {
+public:
+    scoped_phase(dwarf_stats& stats_, phase p_) {}
+    scoped_phase(const scoped_phase&) = delete;
+    scoped_phase& operator=(const scoped_phase&) = delete;
+};
+
+#endif
+
+}
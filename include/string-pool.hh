@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace dwarfy {
+
+//interned strings, referred to by 32-bit index, index 0 is the empty string
+//the characters are copied into blocks that never move and the index to view table grows a page at a
+//time without moving either, so get() takes no lock and its views live as long as the pool;
+//interning takes a lock
+class string_pool {
+    static constexpr size_t block_size = 64 << 10;
+    static constexpr size_t page_size = 4096;
+    static constexpr size_t max_pages = 4096;
+
+    std::mutex m;
+    std::unordered_map<std::string_view, uint32_t> indexes;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<std::unique_ptr<char[]>> large;
+    size_t block_used = block_size;
+    //pages are allocated before any index in them is handed out, so readers, who only have indexes
+    //they got from intern (through some synchronization), never see a page being created
+    std::array<std::unique_ptr<std::string_view[]>, max_pages> pages;
+    uint32_t count = 0;
+
+    std::string_view store(std::string_view s);
+public:
+    string_pool();
+    string_pool(const string_pool&) = delete;
+    string_pool& operator=(const string_pool&) = delete;
+
+    uint32_t intern(std::string_view s);
+    std::string_view get(uint32_t index) const {
+        return pages[index / page_size][index % page_size];
+    }
+    size_t size();
+};
+
+}
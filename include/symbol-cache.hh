@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "module-set.hh"
+#include "string-pool.hh"
+
+namespace dwarfy {
+
+//an address resolved to function and line, the strings are indexes into a string_pool, 0 if unknown
+struct cached_frame {
+    uint32_t function = 0;
+    uint32_t file = 0;
+    uint32_t line = 0;
+    //offset of the address from the start of function
+    uint64_t offset = 0;
+};
+
+//resolves a module relative pc through m's function index (or symbol table) and line tables,
+//interning the names in strings
+cached_frame resolve_frame(loaded_module& m, uint64_t pc, string_pool& strings);
+
+struct symbol_cache_stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+
+    double hit_rate() const {
+        return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0;
+    }
+};
+
+//resolve_frame results by (module, pc), for the hot addresses that make up most of a profile
+//a fixed number of entries split into lock shards by hash, each an open addressing table with linear
+//probing that evicts by CLOCK once it's three quarters full: entries are marked on every hit and the
+//hand evicts the first unmarked one it finds, unmarking the ones it passes
+//entries are plain integers, a hit copies one out and allocates nothing
+class symbol_cache {
+    struct slot {
+        //loaded_module::id, 0 for an empty slot
+        uint64_t module = 0;
+        uint64_t pc;
+        cached_frame frame;
+        bool referenced;
+    };
+    struct alignas(64) shard {
+        std::mutex m;
+        std::vector<slot> slots;
+        size_t used = 0;
+        size_t hand = 0;
+        symbol_cache_stats stats;
+    };
+
+    std::vector<shard> shards;
+    size_t slots_per_shard;
+
+    static uint64_t hash(uint64_t module, uint64_t pc);
+    bool find(shard& s, uint64_t h, uint64_t module, uint64_t pc, cached_frame& frame);
+    void insert(shard& s, uint64_t h, uint64_t module, uint64_t pc, const cached_frame& frame);
+    void evict(shard& s);
+public:
+    //shared by every module and thread resolving through this cache
+    string_pool strings;
+
+    symbol_cache(size_t capacity = 1 << 16, size_t shard_count = 16);
+    //the cached frame for pc, resolving and caching it on a miss
+    //misses in a module whose function index isn't built yet are resolved through its symbol table
+    //and not cached, so they don't outlive the index being built
+    cached_frame resolve(loaded_module& m, uint64_t pc);
+    //totals over all shards
+    symbol_cache_stats stats();
+};
+
+}
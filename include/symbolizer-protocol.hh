@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "serialise.hh"
+
+//framing shared by the symbolizer daemon and its clients
+//every message is a little endian u32 payload length followed by the payload
+//request:  u32 id, u16 module path length, module path, u64 load bias, u32 count, count * u64 address
+//response: u32 id, u32 count, count * (u8 resolved, u64 offset, u16 name length, name)
+namespace dwarfy::protocol {
+
+constexpr size_t max_message_size = 16 << 20;
+
+struct request {
+    uint32_t id;
+    std::string module;
+    uint64_t load_bias;
+    std::vector<uint64_t> addresses;
+};
+
+struct frame {
+    bool resolved;
+    uint64_t offset;
+    std::string function;
+};
+
+struct response {
+    uint32_t id;
+    std::vector<frame> frames;
+};
+
+template<typename T>
+void put(std::vector<std::byte>& out, T v) {
+    for (size_t i = 0; i < sizeof(T); i++) {
+        out.push_back(static_cast<std::byte>(static_cast<uint64_t>(v) >> (8 * i)));
+    }
+}
+inline void put(std::vector<std::byte>& out, std::string_view s) {
+    //some template instantiations' names don't fit, they're truncated
+    s = s.substr(0, UINT16_MAX);
+    put<uint16_t>(out, s.size());
+    const std::byte* p = reinterpret_cast<const std::byte*>(s.data());
+    out.insert(out.end(), p, p + s.size());
+}
+
+//appends one framed message, fill writes the payload
+template<typename F>
+void put_message(std::vector<std::byte>& out, F fill) {
+    size_t start = out.size();
+    put<uint32_t>(out, 0);
+    fill();
+    uint32_t length = out.size() - start - sizeof(uint32_t);
+    for (size_t i = 0; i < sizeof(uint32_t); i++) {
+        out[start + i] = static_cast<std::byte>(length >> (8 * i));
+    }
+}
+
+inline void encode(const request& r, std::vector<std::byte>& out) {
+    put_message(out, [&]() {
+        put<uint32_t>(out, r.id);
+        put(out, std::string_view{r.module});
+        put<uint64_t>(out, r.load_bias);
+        put<uint32_t>(out, r.addresses.size());
+        for (uint64_t a: r.addresses) {
+            put<uint64_t>(out, a);
+        }
+    });
+}
+
+inline void encode(const response& r, std::vector<std::byte>& out) {
+    put_message(out, [&]() {
+        put<uint32_t>(out, r.id);
+        put<uint32_t>(out, r.frames.size());
+        for (const frame& f: r.frames) {
+            put<uint8_t>(out, f.resolved);
+            put<uint64_t>(out, f.offset);
+            put(out, std::string_view{f.function});
+        }
+    });
+}
+
+//the payload of the first complete message in buffer, empty if there isn't one yet
+//throws if the length prefix is over max_message_size
+inline std::span<std::byte> next_message(std::span<std::byte> buffer) {
+    if (buffer.size() < sizeof(uint32_t)) {
+        return {};
+    }
+    span_reader r {buffer};
+    r.file_endianness = std::endian::little;
+    uint32_t length;
+    r & length;
+    if (length > max_message_size) {
+        throw std::runtime_error("symbolizer message too large: " + std::to_string(length));
+    }
+    if (r.data.size() < length) {
+        return {};
+    }
+    return r.data.first(length);
+}
+
+//span_reader doesn't bounds check, and messages come from other processes
+inline void need(span_reader& r, size_t n) {
+    if (r.data.size() < n) {
+        throw std::runtime_error("symbolizer message truncated");
+    }
+}
+
+inline std::string get_string(span_reader& r) {
+    uint16_t length;
+    need(r, sizeof(length));
+    r & length;
+    need(r, length);
+    std::span<std::byte> s = r.read_bytes(length);
+    return std::string{reinterpret_cast<const char*>(s.data()), s.size()};
+}
+
+inline void decode(std::span<std::byte> payload, request& req) {
+    span_reader r {payload};
+    r.file_endianness = std::endian::little;
+    uint32_t count;
+    need(r, sizeof(req.id));
+    r & req.id;
+    req.module = get_string(r);
+    need(r, sizeof(req.load_bias) + sizeof(count));
+    r & req.load_bias & count;
+    if (r.data.size() != count * sizeof(uint64_t)) {
+        throw std::runtime_error("symbolizer request address count doesn't match its length: " + std::to_string(count));
+    }
+    req.addresses.resize(count);
+    for (uint64_t& a: req.addresses) {
+        r & a;
+    }
+}
+
+inline void decode(std::span<std::byte> payload, response& res) {
+    span_reader r {payload};
+    r.file_endianness = std::endian::little;
+    uint32_t count;
+    need(r, sizeof(res.id) + sizeof(count));
+    r & res.id & count;
+    need(r, count * (sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint16_t)));
+    res.frames.resize(count);
+    for (frame& f: res.frames) {
+        uint8_t resolved;
+        need(r, sizeof(resolved) + sizeof(f.offset));
+        r & resolved & f.offset;
+        f.resolved = resolved;
+        f.function = get_string(r);
+    }
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace dwarfy {
+
+enum class unit_section : uint8_t {
+    debug_info,
+    debug_types,
+};
+
+struct type_unit_entry {
+    uint64_t signature;
+    unit_section section;
+    //offsets of the unit header and of the type's DIE, both from the start of the section
+    uint64_t unit_offset;
+    uint64_t type_offset;
+};
+
+//open addressing (linear probing) map from type signature to type unit
+//signatures are already hashes, so the slot is just a multiplicative mix of them
+class signature_map {
+    std::vector<type_unit_entry> slots;
+    std::vector<uint8_t> occupied;
+    size_t mask;
+    size_t count;
+    size_t slot(uint64_t signature) const {
+        return (signature * 0x9e3779b97f4a7c15ULL) >> 32 & mask;
+    }
+public:
+    signature_map();
+    signature_map(std::span<const type_unit_entry> entries);
+    void insert(const type_unit_entry& entry);
+    const type_unit_entry* find(uint64_t signature) const;
+    size_t size() const {
+        return count;
+    }
+};
+
+}
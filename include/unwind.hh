@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <array>
+#include <vector>
+
+#include "elfy.hh"
+#include "call-frame.hh"
+#include "expression.hh"
+
+namespace dwarfy {
+
+//enough DWARF register numbers for x86-64 (0-16) and AArch64 (0-31)
+constexpr size_t max_unwind_registers = 33;
+
+struct register_set {
+    uint64_t pc = 0;
+    std::array<uint64_t, max_unwind_registers> regs = {};
+    //bit n set if regs[n] holds a known value
+    uint64_t valid = 0;
+
+    void set(uint16_t reg, uint64_t value) {
+        regs[reg] = value;
+        valid |= 1ULL << reg;
+    }
+    bool has(uint16_t reg) const {
+        return reg < max_unwind_registers && (valid & (1ULL << reg));
+    }
+};
+
+//a recorded register set plus a copy of the stack starting at stack_address (normally the sampled sp)
+struct stack_sample {
+    register_set regs;
+    uint64_t stack_address;
+    std::span<const std::byte> stack;
+};
+
+//pcs of sample i are pcs[i * max_frames, i * max_frames + depths[i])
+struct unwound_stacks {
+    size_t max_frames;
+    std::vector<uint64_t> pcs;
+    std::vector<uint32_t> depths;
+
+    size_t size() const {
+        return depths.size();
+    }
+    std::span<const uint64_t> operator[](size_t i) const {
+        return std::span<const uint64_t>{pcs}.subspan(i * max_frames, depths[i]);
+    }
+};
+
+//direct mapped cache of lookup pc -> row, one per worker so hot return addresses skip the binary searches
+struct unwind_cache {
+    struct entry {
+        uint64_t pc = ~0ULL;
+        unwind_location location;
+    };
+    static constexpr size_t size = 4096;
+    std::vector<entry> entries;
+    size_t hits = 0;
+    size_t misses = 0;
+
+    unwind_cache():
+        entries(size)
+    {}
+};
+
+struct unwinder {
+    const unwind_table& table;
+    uint16_t sp_register;
+    //runtime address minus link time address, for position independent binaries
+    uint64_t load_bias = 0;
+    //for DW_OP_addr and DW_OP_deref in CFA and register rule expressions
+    size_t address_size = 8;
+    std::endian endianness = std::endian::little;
+    size_t max_frames = 128;
+    unsigned threads = 0;
+
+    unwinder(const unwind_table& table_, uint16_t sp_register_):
+        table(table_),
+        sp_register(sp_register_)
+    {}
+    unwinder(const unwind_table& table_, const elfy::elf& elf);
+
+    const unwind_location* find(uint64_t pc, unwind_cache& cache) const;
+    //unwinds one sample into out, returning the number of pcs written
+    size_t unwind(const stack_sample& sample, std::span<uint64_t> out, unwind_cache& cache) const;
+    unwound_stacks unwind(std::span<const stack_sample> samples) const;
+};
+
+uint16_t stack_pointer_register(uint16_t elf_machine);
+
+}
@@ -0,0 +1,68 @@
+#include "aranges.hh"
+
+#include <algorithm>
+
+namespace dwarfy {
+
+using std::to_string;
+
+cu_aranges::cu_aranges(const dwarf& d) {
+    uint64_t offset = 0;
+    while (offset < d.debug_aranges.size()) {
+        span_reader r {d.debug_aranges.subspan(offset)};
+        r.file_endianness = d.initial_endianness;
+        initial_length length;
+        r & length;
+        if (length > d.debug_aranges.size() - offset - length.size()) {
+            throw std::runtime_error(".debug_aranges unit runs past the end of the section: " + to_string(offset));
+        }
+        std::span<std::byte> unit = d.debug_aranges.subspan(offset, length + length.size());
+        r.data = unit.subspan(length.size());
+        r.file_offset_size = length.offset_size();
+        offset += unit.size();
+
+        uint16_t version;
+        file_offset_size cu_offset;
+        uint8_t address_size;
+        uint8_t segment_size;
+        r & version & cu_offset & address_size & segment_size;
+        if (version != 2) {
+            throw std::runtime_error("unsupported .debug_aranges version, expected 2, got: " + to_string(version));
+        }
+        if (address_size != 4 && address_size != 8) {
+            throw std::runtime_error("unsupported .debug_aranges address size: " + to_string(address_size));
+        }
+        r.machine_address_size = address_size;
+        //tuples are aligned to their own size from the start of the unit
+        size_t tuple_size = segment_size + 2 * address_size;
+        size_t used = unit.size() - r.data.size();
+        r.read_bytes((tuple_size - used % tuple_size) % tuple_size);
+        while (r.data.size() >= tuple_size) {
+            r.read_bytes(segment_size);
+            machine_address_size begin;
+            machine_address_size size;
+            r & begin & size;
+            if (begin == 0 && size == 0) {
+                break;
+            }
+            if (size != 0) {
+                ranges.push_back({begin, begin + size, cu_offset});
+            }
+        }
+    }
+    std::sort(ranges.begin(), ranges.end(), [](const arange& a, const arange& b) {
+        return a.begin < b.begin;
+    });
+}
+
+std::optional<uint64_t> cu_aranges::find(uint64_t pc) const {
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), pc, [](uint64_t pc, const arange& a) {
+        return pc < a.begin;
+    });
+    if (it == ranges.begin() || pc >= std::prev(it)->end) {
+        return std::nullopt;
+    }
+    return std::prev(it)->cu_offset;
+}
+
+}
@@ -0,0 +1,59 @@
+#include "archive-index.hh"
+#include "parallel.hh"
+
+#include <algorithm>
+#include <cstring>
+
+namespace dwarfy {
+
+archive_index::archive_index(const elfy::archive& a, unsigned threads) {
+    const std::vector<elfy::archive_member>& members = a.members();
+    elfs.resize(members.size());
+    std::vector<std::vector<archive_function>> per_member(members.size());
+    parallel_for(members.size(), 1, threads, [&](unsigned worker, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            std::span<std::byte> data = members[i].data;
+            if (data.size() < 4 || std::memcmp(data.data(), "\x7f" "ELF", 4) != 0) {
+                continue;
+            }
+            try {
+                elfs[i] = std::make_unique<elfy::elf>(data);
+                dwarf d {*elfs[i]};
+                function_index functions {d};
+                for (const function_range& f: functions.ranges()) {
+                    per_member[i].push_back({f.name, i, f.begin, f.end});
+                }
+            } catch (std::exception& e) {
+                throw std::runtime_error(std::string{members[i].name} + ": " + e.what());
+            }
+        }
+    });
+
+    size_t total = 0;
+    for (size_t i = 0; i < members.size(); i++) {
+        total += per_member[i].size();
+        indexed_members += elfs[i] != nullptr;
+    }
+    functions.reserve(total);
+    for (std::vector<archive_function>& fs: per_member) {
+        functions.insert(functions.end(), fs.begin(), fs.end());
+    }
+    std::sort(functions.begin(), functions.end(), [](const archive_function& x, const archive_function& y) {
+        return x.name < y.name || (x.name == y.name && x.member < y.member);
+    });
+}
+
+std::span<const archive_function> archive_index::find(std::string_view name) const {
+    struct by_name {
+        bool operator()(const archive_function& f, std::string_view n) const {
+            return f.name < n;
+        }
+        bool operator()(std::string_view n, const archive_function& f) const {
+            return n < f.name;
+        }
+    };
+    auto [first, last] = std::equal_range(functions.begin(), functions.end(), name, by_name{});
+    return {first, last};
+}
+
+}
@@ -0,0 +1,123 @@
+#include "archive.hh"
+
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace elfy {
+
+using std::to_string;
+
+namespace {
+
+constexpr std::string_view archive_magic = "!<arch>\n";
+constexpr std::string_view thin_magic = "!<thin>\n";
+constexpr size_t header_size = 60;
+
+std::string_view as_string(std::span<const std::byte> bytes) {
+    return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+}
+
+//header fields are space padded ASCII decimal
+uint64_t decimal_field(std::string_view field, std::string_view what) {
+    while (!field.empty() && field.back() == ' ') {
+        field.remove_suffix(1);
+    }
+    uint64_t v = 0;
+    auto [end, ec] = std::from_chars(field.data(), field.data() + field.size(), v);
+    if (ec != std::errc{} || end != field.data() + field.size()) {
+        throw std::runtime_error("bad archive member " + std::string{what} + ": '" + std::string{field} + "'");
+    }
+    return v;
+}
+
+}
+
+bool archive::is_archive(std::span<const std::byte> data) {
+    if (data.size() < archive_magic.size()) {
+        return false;
+    }
+    std::string_view magic = as_string(data.first(archive_magic.size()));
+    return magic == archive_magic || magic == thin_magic;
+}
+
+archive::archive(std::span<std::byte> data_, const std::string& path):
+    data(data_)
+{
+    if (!is_archive(data)) {
+        throw std::invalid_argument("bad archive magic number, this is likely not an ar archive!");
+    }
+    thin_ = as_string(data.first(thin_magic.size())) == thin_magic;
+    std::filesystem::path directory = std::filesystem::path{path}.parent_path();
+
+    std::string_view long_names;
+    uint64_t offset = archive_magic.size();
+    while (offset + header_size <= data.size()) {
+        std::string_view header = as_string(data.subspan(offset, header_size));
+        if (header.substr(58, 2) != "`\n") {
+            throw std::runtime_error("bad archive member header at offset " + to_string(offset));
+        }
+        std::string_view name = header.substr(0, 16);
+        uint64_t size = decimal_field(header.substr(48, 10), "size");
+        uint64_t contents = offset + header_size;
+        //thin archives only store the symbol and long name tables inline
+        bool inline_data = !thin_ || name.starts_with("/ ") || name.starts_with("// ") || name.starts_with("/SYM64/");
+        if (inline_data && contents + size > data.size()) {
+            throw std::runtime_error("archive member at offset " + to_string(offset) + " runs off the end of the archive");
+        }
+        std::span<std::byte> member_data = inline_data ? data.subspan(contents, size) : std::span<std::byte>{};
+        uint64_t next = contents + (inline_data ? size + size % 2 : 0);
+
+        if (name.starts_with("// ")) {
+            long_names = as_string(member_data);
+        } else if (name.starts_with("/ ") || name.starts_with("/SYM64/")) {
+            //the symbol index, the linker's, not ours
+        } else {
+            archive_member m {{}, offset, member_data};
+            if (name.starts_with("#1/")) {
+                //BSD, the name is the first n bytes of the data
+                uint64_t length = decimal_field(name.substr(3), "name length");
+                if (length > m.data.size()) {
+                    throw std::runtime_error("bad BSD archive member name length: " + to_string(length));
+                }
+                m.name = as_string(m.data.first(length));
+                m.name = m.name.substr(0, m.name.find('\0'));
+                m.data = m.data.subspan(length);
+                //the BSD symbol index
+                if (m.name.starts_with("__.SYMDEF")) {
+                    offset = next;
+                    continue;
+                }
+            } else if (name.starts_with("/")) {
+                //GNU, an offset into the long name table, names there end with "/\n"
+                uint64_t name_offset = decimal_field(name.substr(1), "name offset");
+                if (name_offset >= long_names.size()) {
+                    throw std::runtime_error("archive long name offset out of range: " + to_string(name_offset));
+                }
+                m.name = long_names.substr(name_offset);
+                m.name = m.name.substr(0, m.name.find('\n'));
+                if (m.name.ends_with('/')) {
+                    m.name.remove_suffix(1);
+                }
+            } else {
+                m.name = name.substr(0, name.find('/'));
+                while (!m.name.empty() && m.name.back() == ' ') {
+                    m.name.remove_suffix(1);
+                }
+            }
+            if (thin_) {
+                std::filesystem::path member_path {std::string{m.name}};
+                if (member_path.is_relative()) {
+                    member_path = directory / member_path;
+                }
+                thin_files.push_back(std::make_unique<mapped_file>(member_path.string()));
+                m.data = thin_files.back()->data;
+            }
+            members_.push_back(m);
+        }
+        offset = next;
+    }
+}
+
+}
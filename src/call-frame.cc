@@ -0,0 +1,793 @@
+#include "call-frame.hh"
+#include "dwarfy.hh"
+
+#include <unordered_map>
+
+namespace dwarfy {
+
+using std::to_string;
+
+namespace {
+
+struct entry_header {
+    uint64_t offset;
+    std::span<std::byte> contents;
+    uint64_t id;
+    uint64_t id_field_offset;
+    bool is_cie;
+};
+
+span_reader section_reader(const call_frame_section& section, uint64_t offset) {
+    if (offset >= section.data.size()) {
+        throw std::runtime_error("call frame entry offset out of range: " + to_string(offset));
+    }
+    span_reader r {section.data.subspan(offset)};
+    r.file_endianness = section.endianness;
+    r.machine_address_size = section.address_size;
+    r.machine_segment_size = 0;
+    return r;
+}
+
+uint64_t offset_in(const call_frame_section& section, const span_reader& r) {
+    return r.data.data() - section.data.data();
+}
+
+//returns nullopt for the zero terminator at the end of .eh_frame
+std::optional<entry_header> read_entry_header(const call_frame_section& section, uint64_t offset) {
+    span_reader r = section_reader(section, offset);
+    initial_length length;
+    r & length;
+    if (length == 0) {
+        return std::nullopt;
+    }
+    if (length > r.data.size()) {
+        throw std::runtime_error("call frame entry at offset " + to_string(offset) + " runs off the end of the section");
+    }
+    entry_header h;
+    h.offset = offset;
+    h.id_field_offset = offset_in(section, r);
+    h.contents = r.data.first(length);
+    span_reader id_reader {h.contents};
+    id_reader.file_endianness = section.endianness;
+    id_reader.file_offset_size = length.offset_size();
+    file_offset_size id;
+    id_reader & id;
+    h.id = id;
+    if (section.is_eh_frame) {
+        h.is_cie = h.id == 0;
+    } else {
+        h.is_cie = h.id == (length.offset_size() == 4 ? 0xffffffffULL : 0xffffffffffffffffULL);
+    }
+    return h;
+}
+
+uint64_t next_entry(const entry_header& h, const call_frame_section& section) {
+    return (h.contents.data() + h.contents.size()) - section.data.data();
+}
+
+}
+
+namespace {
+
+//bytes taken by a fixed size pointer encoding, 0 for the LEB128 ones
+size_t encoded_size(uint8_t encoding, size_t address_size) {
+    switch (static_cast<dw_eh_pe>(encoding & 0x0f)) {
+        case dw_eh_pe::absptr:
+            return address_size;
+        case dw_eh_pe::udata2:
+        case dw_eh_pe::sdata2:
+            return 2;
+        case dw_eh_pe::udata4:
+        case dw_eh_pe::sdata4:
+            return 4;
+        case dw_eh_pe::udata8:
+        case dw_eh_pe::sdata8:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+}
+
+uint64_t read_encoded_pointer(span_reader& r, uint8_t encoding, const call_frame_section& section, uint64_t pc_begin) {
+    if (encoding == static_cast<uint8_t>(dw_eh_pe::omit)) {
+        return 0;
+    }
+    uint64_t field_address = section.address + offset_in(section, r);
+    uint64_t value;
+    switch (static_cast<dw_eh_pe>(encoding & 0x0f)) {
+        case dw_eh_pe::absptr:
+            {
+                machine_address_size v;
+                r & v;
+                value = v;
+                break;
+            }
+        case dw_eh_pe::uleb128:
+            {
+                uleb128 v;
+                r & v;
+                value = v;
+                break;
+            }
+        case dw_eh_pe::udata2:
+            {
+                uint16_t v;
+                r & v;
+                value = v;
+                break;
+            }
+        case dw_eh_pe::udata4:
+            {
+                uint32_t v;
+                r & v;
+                value = v;
+                break;
+            }
+        case dw_eh_pe::udata8:
+            {
+                uint64_t v;
+                r & v;
+                value = v;
+                break;
+            }
+        case dw_eh_pe::sleb128:
+            {
+                sleb128 v;
+                r & v;
+                value = v;
+                break;
+            }
+        case dw_eh_pe::sdata2:
+            {
+                int16_t v;
+                r & v;
+                value = static_cast<int64_t>(v);
+                break;
+            }
+        case dw_eh_pe::sdata4:
+            {
+                int32_t v;
+                r & v;
+                value = static_cast<int64_t>(v);
+                break;
+            }
+        case dw_eh_pe::sdata8:
+            {
+                int64_t v;
+                r & v;
+                value = v;
+                break;
+            }
+        default:
+            throw std::runtime_error("unsupported pointer encoding format: " + to_string(encoding));
+    }
+    switch (static_cast<dw_eh_pe>(encoding & 0x70)) {
+        case dw_eh_pe::absptr:
+            break;
+        case dw_eh_pe::pcrel:
+            value += field_address;
+            break;
+        case dw_eh_pe::textrel:
+            value += section.text_base;
+            break;
+        case dw_eh_pe::datarel:
+            value += section.data_base;
+            break;
+        case dw_eh_pe::funcrel:
+            value += pc_begin;
+            break;
+        default:
+            throw std::runtime_error("unsupported pointer encoding application: " + to_string(encoding));
+    }
+    //XXX DW_EH_PE_indirect needs target memory, we hand back the address of the pointer instead
+    if (section.address_size == 4) {
+        value &= 0xffffffffULL;
+    }
+    return value;
+}
+
+common_information_entry read_cie(const call_frame_section& section, uint64_t offset) {
+    auto h = read_entry_header(section, offset);
+    if (!h || !h->is_cie) {
+        throw std::runtime_error("expected a CIE at offset " + to_string(offset));
+    }
+    span_reader r = section_reader(section, h->id_field_offset);
+    r.data = h->contents;
+    r.file_offset_size = h->id_field_offset - offset == 4 ? 4 : 8;
+    file_offset_size id;
+    r & id;
+
+    common_information_entry cie;
+    cie.offset = offset;
+    r & cie.version;
+    if (cie.version != 1 && cie.version != 3 && cie.version != 4) {
+        throw std::runtime_error("unsupported CIE version, expected 1, 3 or 4, got: " + to_string(cie.version));
+    }
+    auto nul = std::find(r.data.begin(), r.data.end(), std::byte{0});
+    if (nul == r.data.end()) {
+        throw std::runtime_error("bad CIE at offset " + to_string(offset) + ", its augmentation string has no terminating NUL");
+    }
+    auto augmentation = r.read_bytes(nul - r.data.begin() + 1);
+    cie.augmentation = std::string_view{reinterpret_cast<char*>(augmentation.data()), augmentation.size() - 1};
+    if (cie.augmentation.starts_with("eh")) {
+        machine_address_size eh_data;
+        r & eh_data;
+    }
+    cie.address_size = section.address_size;
+    cie.segment_size = 0;
+    if (cie.version >= 4) {
+        r & cie.address_size & cie.segment_size;
+        r.machine_address_size = cie.address_size;
+    }
+    uleb128 caf;
+    sleb128 daf;
+    r & caf & daf;
+    cie.code_alignment_factor = caf;
+    cie.data_alignment_factor = static_cast<int64_t>(daf.data);
+    if (cie.version == 1) {
+        uint8_t ra;
+        r & ra;
+        cie.return_address_register = ra;
+    } else {
+        uleb128 ra;
+        r & ra;
+        cie.return_address_register = ra;
+    }
+    if (cie.augmentation.starts_with("z")) {
+        uleb128 length;
+        r & length;
+        span_reader ar = r;
+        ar.data = r.read_bytes(length);
+        for (char c: cie.augmentation.substr(1)) {
+            if (c == 'L') {
+                ar & cie.lsda_encoding;
+            } else if (c == 'P') {
+                uint8_t personality_encoding;
+                ar & personality_encoding;
+                read_encoded_pointer(ar, personality_encoding, section);
+            } else if (c == 'R') {
+                ar & cie.fde_pointer_encoding;
+            } else if (c == 'S') {
+                cie.signal_frame = true;
+            } else {
+                //unknown augmentation, the length tells us where the instructions start anyway
+                break;
+            }
+        }
+    } else if (!cie.augmentation.empty() && cie.augmentation != "eh") {
+        throw std::runtime_error("unsupported CIE augmentation: "s + std::string(cie.augmentation));
+    }
+    cie.initial_instructions = r.data;
+    return cie;
+}
+
+namespace {
+
+uint64_t fde_cie_offset(const call_frame_section& section, const entry_header& h) {
+    //.eh_frame counts back from the id field, .debug_frame from the start of the section
+    return section.is_eh_frame ? h.id_field_offset - h.id : h.id;
+}
+
+//the FDE whose header h was read from offset, with its CIE already decoded
+frame_description_entry decode_fde(const call_frame_section& section, uint64_t offset, const entry_header& h, const common_information_entry& cie) {
+    frame_description_entry fde;
+    fde.offset = offset;
+    fde.cie_offset = fde_cie_offset(section, h);
+
+    span_reader r = section_reader(section, h.id_field_offset);
+    r.data = h.contents.subspan(h.id_field_offset - offset == 4 ? 4 : 8);
+    r.machine_address_size = cie.address_size;
+    fde.pc_begin = read_encoded_pointer(r, cie.fde_pointer_encoding, section);
+    fde.pc_range = read_encoded_pointer(r, cie.fde_pointer_encoding & 0x0f, section);
+    if (cie.augmentation.starts_with("z")) {
+        uleb128 length;
+        r & length;
+        span_reader ar = r;
+        ar.data = r.read_bytes(length);
+        if (cie.lsda_encoding != static_cast<uint8_t>(dw_eh_pe::omit)) {
+            fde.lsda = read_encoded_pointer(ar, cie.lsda_encoding, section, fde.pc_begin);
+        }
+    }
+    fde.instructions = r.data;
+    return fde;
+}
+
+}
+
+std::optional<frame_description_entry> read_fde(const call_frame_section& section, uint64_t offset, common_information_entry* cie_out) {
+    auto h = read_entry_header(section, offset);
+    if (!h || h->is_cie) {
+        return std::nullopt;
+    }
+    common_information_entry cie = read_cie(section, fde_cie_offset(section, *h));
+    frame_description_entry fde = decode_fde(section, offset, *h, cie);
+    if (cie_out) {
+        *cie_out = cie;
+    }
+    return fde;
+}
+
+std::vector<uint64_t> fde_offsets(const call_frame_section& section) {
+    std::vector<uint64_t> offsets;
+    uint64_t offset = 0;
+    while (offset < section.data.size()) {
+        auto h = read_entry_header(section, offset);
+        if (!h) {
+            break;
+        }
+        if (!h->is_cie) {
+            offsets.push_back(offset);
+        }
+        offset = next_entry(*h, section);
+    }
+    return offsets;
+}
+
+namespace {
+
+struct cfa_state {
+    cfa_rule cfa;
+    std::vector<register_rule> rules;
+
+    void set(register_rule rule) {
+        auto it = std::lower_bound(rules.begin(), rules.end(), rule.reg, [](const register_rule& a, uint16_t reg) {
+            return a.reg < reg;
+        });
+        if (it != rules.end() && it->reg == rule.reg) {
+            *it = rule;
+        } else {
+            rules.insert(it, rule);
+        }
+    }
+    void restore(uint16_t reg, const cfa_state& initial) {
+        auto it = std::find_if(initial.rules.begin(), initial.rules.end(), [&](const register_rule& a) {
+            return a.reg == reg;
+        });
+        if (it != initial.rules.end()) {
+            set(*it);
+        } else {
+            std::erase_if(rules, [&](const register_rule& a) {
+                return a.reg == reg;
+            });
+        }
+    }
+};
+
+uint16_t read_register(span_reader& r) {
+    uleb128 reg;
+    r & reg;
+    return static_cast<uint16_t>(reg.data);
+}
+
+std::span<std::byte> read_block(span_reader& r) {
+    uleb128 length;
+    r & length;
+    return r.read_bytes(length);
+}
+
+//runs a CFA program, calling row(address) with the state in effect before each location change
+template<typename F>
+void execute(
+    std::span<std::byte> program,
+    const call_frame_section& section,
+    const common_information_entry& cie,
+    const cfa_state* initial,
+    cfa_state& s,
+    uint64_t& loc,
+    F row
+) {
+    span_reader r {program};
+    r.file_endianness = section.endianness;
+    r.machine_address_size = cie.address_size;
+    std::vector<cfa_state> stack;
+    int64_t daf = cie.data_alignment_factor;
+    uint64_t caf = cie.code_alignment_factor;
+
+    auto advance = [&](uint64_t delta) {
+        row(loc);
+        loc += delta * caf;
+    };
+
+    while (!r.data.empty()) {
+        uint8_t op;
+        r & op;
+        uint8_t high = op & 0xc0;
+        uint8_t low = op & 0x3f;
+        if (high == static_cast<uint8_t>(dw_cfa::advance_loc)) {
+            advance(low);
+            continue;
+        } else if (high == static_cast<uint8_t>(dw_cfa::offset)) {
+            uleb128 offset;
+            r & offset;
+            s.set({low, register_rule_kind::offset, static_cast<int64_t>(offset.data) * daf, {}});
+            continue;
+        } else if (high == static_cast<uint8_t>(dw_cfa::restore)) {
+            if (initial) {
+                s.restore(low, *initial);
+            }
+            continue;
+        }
+        switch (static_cast<dw_cfa>(op)) {
+            case dw_cfa::nop:
+                break;
+            case dw_cfa::set_loc:
+                {
+                    row(loc);
+                    loc = read_encoded_pointer(r, cie.fde_pointer_encoding, section);
+                    break;
+                }
+            case dw_cfa::advance_loc1:
+                {
+                    uint8_t delta;
+                    r & delta;
+                    advance(delta);
+                    break;
+                }
+            case dw_cfa::advance_loc2:
+                {
+                    uint16_t delta;
+                    r & delta;
+                    advance(delta);
+                    break;
+                }
+            case dw_cfa::advance_loc4:
+                {
+                    uint32_t delta;
+                    r & delta;
+                    advance(delta);
+                    break;
+                }
+            case dw_cfa::offset_extended:
+                {
+                    uint16_t reg = read_register(r);
+                    uleb128 offset;
+                    r & offset;
+                    s.set({reg, register_rule_kind::offset, static_cast<int64_t>(offset.data) * daf, {}});
+                    break;
+                }
+            case dw_cfa::restore_extended:
+                {
+                    uint16_t reg = read_register(r);
+                    if (initial) {
+                        s.restore(reg, *initial);
+                    }
+                    break;
+                }
+            case dw_cfa::undefined:
+                {
+                    uint16_t reg = read_register(r);
+                    s.set({reg, register_rule_kind::undefined, 0, {}});
+                    break;
+                }
+            case dw_cfa::same_value:
+                {
+                    uint16_t reg = read_register(r);
+                    s.set({reg, register_rule_kind::same_value, 0, {}});
+                    break;
+                }
+            case dw_cfa::register_:
+                {
+                    uint16_t reg = read_register(r);
+                    uint16_t other = read_register(r);
+                    s.set({reg, register_rule_kind::register_, other, {}});
+                    break;
+                }
+            case dw_cfa::remember_state:
+                {
+                    stack.push_back(s);
+                    break;
+                }
+            case dw_cfa::restore_state:
+                {
+                    if (stack.empty()) {
+                        throw std::runtime_error("DW_CFA_restore_state with no remembered state");
+                    }
+                    //the CFA rule is not part of the remembered state
+                    cfa_rule cfa = s.cfa;
+                    s = stack.back();
+                    s.cfa = cfa;
+                    stack.pop_back();
+                    break;
+                }
+            case dw_cfa::def_cfa:
+                {
+                    uint16_t reg = read_register(r);
+                    uleb128 offset;
+                    r & offset;
+                    s.cfa = {cfa_rule_kind::register_offset, reg, static_cast<int64_t>(offset.data), {}};
+                    break;
+                }
+            case dw_cfa::def_cfa_sf:
+                {
+                    uint16_t reg = read_register(r);
+                    sleb128 offset;
+                    r & offset;
+                    s.cfa = {cfa_rule_kind::register_offset, reg, static_cast<int64_t>(offset.data) * daf, {}};
+                    break;
+                }
+            case dw_cfa::def_cfa_register:
+                {
+                    s.cfa.reg = read_register(r);
+                    s.cfa.kind = cfa_rule_kind::register_offset;
+                    break;
+                }
+            case dw_cfa::def_cfa_offset:
+                {
+                    uleb128 offset;
+                    r & offset;
+                    s.cfa.offset = offset;
+                    break;
+                }
+            case dw_cfa::def_cfa_offset_sf:
+                {
+                    sleb128 offset;
+                    r & offset;
+                    s.cfa.offset = static_cast<int64_t>(offset.data) * daf;
+                    break;
+                }
+            case dw_cfa::def_cfa_expression:
+                {
+                    s.cfa = {cfa_rule_kind::expression, 0, 0, read_block(r)};
+                    break;
+                }
+            case dw_cfa::expression:
+                {
+                    uint16_t reg = read_register(r);
+                    s.set({reg, register_rule_kind::expression, 0, read_block(r)});
+                    break;
+                }
+            case dw_cfa::val_expression:
+                {
+                    uint16_t reg = read_register(r);
+                    s.set({reg, register_rule_kind::val_expression, 0, read_block(r)});
+                    break;
+                }
+            case dw_cfa::offset_extended_sf:
+                {
+                    uint16_t reg = read_register(r);
+                    sleb128 offset;
+                    r & offset;
+                    s.set({reg, register_rule_kind::offset, static_cast<int64_t>(offset.data) * daf, {}});
+                    break;
+                }
+            case dw_cfa::val_offset:
+                {
+                    uint16_t reg = read_register(r);
+                    uleb128 offset;
+                    r & offset;
+                    s.set({reg, register_rule_kind::val_offset, static_cast<int64_t>(offset.data) * daf, {}});
+                    break;
+                }
+            case dw_cfa::val_offset_sf:
+                {
+                    uint16_t reg = read_register(r);
+                    sleb128 offset;
+                    r & offset;
+                    s.set({reg, register_rule_kind::val_offset, static_cast<int64_t>(offset.data) * daf, {}});
+                    break;
+                }
+            case dw_cfa::GNU_window_save:
+                //sparc register windows, or AArch64 negate_ra_state, neither changes the rules we track
+                break;
+            case dw_cfa::GNU_args_size:
+                {
+                    uleb128 size;
+                    r & size;
+                    break;
+                }
+            case dw_cfa::GNU_negative_offset_extended:
+                {
+                    uint16_t reg = read_register(r);
+                    uleb128 offset;
+                    r & offset;
+                    s.set({reg, register_rule_kind::offset, -static_cast<int64_t>(offset.data) * daf, {}});
+                    break;
+                }
+            default:
+                throw std::runtime_error("unsupported DW_CFA opcode: " + to_string(op));
+        }
+    }
+}
+
+}
+
+void unwind_table::add_fde(const call_frame_section& section, const common_information_entry& cie, const frame_description_entry& fde) {
+    if (fde.pc_range == 0) {
+        return;
+    }
+    cfa_state initial;
+    uint64_t loc = fde.pc_begin;
+    execute(cie.initial_instructions, section, cie, nullptr, initial, loc, [](uint64_t) {});
+
+    unwind_fde f;
+    f.pc_begin = fde.pc_begin;
+    f.pc_end = fde.pc_begin + fde.pc_range;
+    f.rows_begin = rows.size();
+    f.rows_count = 0;
+    f.return_address_register = cie.return_address_register;
+    f.signal_frame = cie.signal_frame;
+
+    //rows of one fde mostly repeat the same few expressions, compile each once
+    std::unordered_map<const std::byte*, uint32_t> compiled;
+    auto compile = [&](std::span<std::byte> expression) -> uint32_t {
+        auto it = compiled.find(expression.data());
+        if (it == compiled.end()) {
+            it = compiled.emplace(expression.data(), expressions.size()).first;
+            expressions.push_back(compile_expression(expression, section.address_size, section.endianness));
+        }
+        return it->second;
+    };
+
+    cfa_state s = initial;
+    auto row = [&](uint64_t address) {
+        if (address >= f.pc_end) {
+            return;
+        }
+        if (f.rows_count > 0 && rows.back().address >= address) {
+            //zero length row, the later state replaces it
+            rules.resize(rows.back().rules_begin);
+            rows.pop_back();
+            f.rows_count--;
+        }
+        unwind_row r;
+        r.address = address;
+        r.cfa = s.cfa;
+        r.rules_begin = rules.size();
+        r.rules_count = s.rules.size();
+        rules.insert(rules.end(), s.rules.begin(), s.rules.end());
+        if (r.cfa.kind == cfa_rule_kind::expression) {
+            r.cfa.compiled = compile(r.cfa.expression);
+        }
+        for (size_t i = r.rules_begin; i < rules.size(); i++) {
+            if (rules[i].kind == register_rule_kind::expression || rules[i].kind == register_rule_kind::val_expression) {
+                rules[i].compiled = compile(rules[i].expression);
+            }
+        }
+        rows.push_back(r);
+        f.rows_count++;
+    };
+    loc = fde.pc_begin;
+    execute(fde.instructions, section, cie, &initial, s, loc, row);
+    row(loc);
+
+    if (f.rows_count > 0) {
+        fdes.push_back(f);
+    }
+}
+
+void unwind_table::add_section(const call_frame_section& section, std::span<std::byte> eh_frame_hdr, uint64_t eh_frame_hdr_address) {
+    std::vector<uint64_t> offsets;
+    if (!eh_frame_hdr.empty()) {
+        call_frame_section hdr = section;
+        hdr.data = eh_frame_hdr;
+        hdr.address = eh_frame_hdr_address;
+        hdr.data_base = eh_frame_hdr_address;
+        span_reader r {eh_frame_hdr};
+        r.file_endianness = section.endianness;
+        r.machine_address_size = section.address_size;
+        if (eh_frame_hdr.size() < 4) {
+            throw std::runtime_error("bad .eh_frame_hdr, too short for its header: " + to_string(eh_frame_hdr.size()));
+        }
+        uint8_t version;
+        uint8_t eh_frame_ptr_encoding;
+        uint8_t fde_count_encoding;
+        uint8_t table_encoding;
+        r & version & eh_frame_ptr_encoding & fde_count_encoding & table_encoding;
+        if (version != 1) {
+            throw std::runtime_error("bad .eh_frame_hdr version, expected 1, got: " + to_string(version));
+        }
+        constexpr uint8_t omit = static_cast<uint8_t>(dw_eh_pe::omit);
+        size_t ptr_size = encoded_size(eh_frame_ptr_encoding, section.address_size);
+        size_t count_size = encoded_size(fde_count_encoding, section.address_size);
+        size_t entry_size = encoded_size(table_encoding, section.address_size);
+        //the table is only usable with fixed size fields, otherwise the FDEs are found by scanning
+        if (eh_frame_ptr_encoding != omit && fde_count_encoding != omit && table_encoding != omit &&
+            ptr_size != 0 && count_size != 0 && entry_size != 0 && r.data.size() >= ptr_size + count_size) {
+            read_encoded_pointer(r, eh_frame_ptr_encoding, hdr);
+            uint64_t count = read_encoded_pointer(r, fde_count_encoding, hdr);
+            if (count > r.data.size() / (2 * entry_size)) {
+                throw std::runtime_error("bad .eh_frame_hdr, " + to_string(count) + " table entries don't fit in " + to_string(r.data.size()) + " bytes");
+            }
+            offsets.reserve(count);
+            for (uint64_t i = 0; i < count; i++) {
+                //the table's initial locations are for a lookup straight from the header, we only need the
+                //FDEs, the precompiled table is sorted by address itself
+                read_encoded_pointer(r, table_encoding, hdr);
+                uint64_t fde_address = read_encoded_pointer(r, table_encoding, hdr);
+                offsets.push_back(fde_address - section.address);
+            }
+        }
+    }
+    if (offsets.empty()) {
+        offsets = fde_offsets(section);
+    }
+
+    //most FDEs share one of a handful of CIEs, each is decoded once
+    std::unordered_map<uint64_t, common_information_entry> cies;
+    for (uint64_t offset: offsets) {
+        auto h = read_entry_header(section, offset);
+        if (!h || h->is_cie) {
+            continue;
+        }
+        uint64_t cie_offset = fde_cie_offset(section, *h);
+        auto it = cies.find(cie_offset);
+        if (it == cies.end()) {
+            it = cies.emplace(cie_offset, read_cie(section, cie_offset)).first;
+        }
+        add_fde(section, it->second, decode_fde(section, offset, *h, it->second));
+    }
+    sort();
+}
+
+void unwind_table::sort() {
+    std::stable_sort(fdes.begin(), fdes.end(), [](const unwind_fde& a, const unwind_fde& b) {
+        return a.pc_begin < b.pc_begin;
+    });
+    //.eh_frame and .debug_frame often describe the same functions, keep whichever was added first
+    auto last = std::unique(fdes.begin(), fdes.end(), [](const unwind_fde& a, const unwind_fde& b) {
+        return a.pc_begin == b.pc_begin;
+    });
+    fdes.erase(last, fdes.end());
+}
+
+unwind_table::unwind_table(elfy::elf& elf) {
+    auto text = elf.get_section_by_name(".text");
+    call_frame_section section;
+    section.endianness = elf.ident.endianness();
+    section.address_size = elf.ident.bitwidth();
+    section.text_base = text ? text.value().address() : 0;
+
+    if (auto eh_frame = elf.get_section_by_name(".eh_frame")) {
+        section.data = eh_frame.value().data(elf);
+        section.address = eh_frame.value().address();
+        section.is_eh_frame = true;
+        std::span<std::byte> hdr;
+        uint64_t hdr_address = 0;
+        if (auto eh_frame_hdr = elf.get_section_by_name(".eh_frame_hdr")) {
+            hdr = eh_frame_hdr.value().data(elf);
+            hdr_address = eh_frame_hdr.value().address();
+        }
+        add_section(section, hdr, hdr_address);
+    }
+    if (auto debug_frame = elf.get_section_by_name(".debug_frame")) {
+        section.data = debug_frame.value().data(elf);
+        section.address = debug_frame.value().address();
+        section.is_eh_frame = false;
+        add_section(section);
+    }
+}
+
+const unwind_fde* unwind_table::find_fde(uint64_t pc) const {
+    auto it = std::upper_bound(fdes.begin(), fdes.end(), pc, [](uint64_t pc, const unwind_fde& f) {
+        return pc < f.pc_begin;
+    });
+    if (it == fdes.begin()) {
+        return nullptr;
+    }
+    --it;
+    if (pc >= it->pc_end) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+std::optional<unwind_location> unwind_table::find(uint64_t pc) const {
+    const unwind_fde* f = find_fde(pc);
+    if (!f) {
+        return std::nullopt;
+    }
+    auto first = rows.begin() + f->rows_begin;
+    auto last = first + f->rows_count;
+    auto it = std::upper_bound(first, last, pc, [](uint64_t pc, const unwind_row& r) {
+        return pc < r.address;
+    });
+    if (it == first) {
+        return std::nullopt;
+    }
+    --it;
+    return unwind_location{f, &*it, std::span<const register_rule>{rules}.subspan(it->rules_begin, it->rules_count)};
+}
+
+}
@@ -12,13 +12,17 @@ compilation_unit_header::iterator::iterator():
     d(nullptr),
     debug_info_reader({})
 {}
-compilation_unit_header::iterator::iterator(dwarf* d_):
+compilation_unit_header::iterator::iterator(const dwarf* d_):
     d(d_),
     debug_info_reader(d->debug_info)
 {
     debug_info_reader.file_endianness = d->initial_endianness;
-    debug_info_reader & cu;
-    next_cu = d->debug_info.subspan(cu.unit_length + cu.unit_length.size());
+    //stripped binaries have no .debug_info at all
+    if (*this != end()) {
+        debug_info_reader & cu;
+        cu.d = d;
+        next_cu = d->debug_info.subspan(cu.unit_length + cu.unit_length.size());
+    }
 }
 const compilation_unit_header compilation_unit_header::iterator::operator*() const {
     return cu;
@@ -27,6 +31,7 @@ compilation_unit_header::iterator& compilation_unit_header::iterator::operator++
     debug_info_reader.data = next_cu;
     if (*this != end()) {
         debug_info_reader & cu;
+        cu.d = d;
         next_cu = next_cu.subspan(cu.unit_length + cu.unit_length.size());
     }
     return *this;
@@ -37,10 +42,13 @@ compilation_unit_header::iterator compilation_unit_header::iterator::operator++(
     return ret;
 }
 span_reader compilation_unit_header::iterator::die_reader() {
-    return debug_info_reader;
+    return cu.context.reader(debug_info_reader.data);
+}
+std::span<std::byte> compilation_unit_header::iterator::die_data() const {
+    return {debug_info_reader.data.data(), next_cu.data()};
 }
 debugging_information_entry::iterator compilation_unit_header::iterator::die_iter() {
-    return debugging_information_entry::iterator{d, debug_info_reader};
+    return debugging_information_entry::iterator{d, die_reader()};
 }
 
 compilation_unit_header::iterator compilation_unit_header::iterator::begin() const {
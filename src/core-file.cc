@@ -0,0 +1,212 @@
+#include "core-file.hh"
+
+#include <cstring>
+#include <map>
+
+namespace elfy {
+
+using std::to_string;
+
+namespace {
+
+//PT_LOAD, PT_NOTE
+constexpr uint32_t pt_load = 1;
+constexpr uint32_t pt_note = 4;
+//NT_PRSTATUS and NT_FILE, owned by "CORE"; NT_GNU_BUILD_ID owned by "GNU"
+constexpr uint32_t nt_prstatus = 1;
+constexpr uint32_t nt_file = 0x46494c45;
+constexpr uint32_t nt_gnu_build_id = 3;
+
+std::string hex(std::span<const std::byte> bytes) {
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string s;
+    for (std::byte b: bytes) {
+        s += digits[static_cast<uint8_t>(b) >> 4];
+        s += digits[static_cast<uint8_t>(b) & 0xf];
+    }
+    return s;
+}
+
+}
+
+core_file::core_file(const elf& e_):
+    e(e_)
+{
+    if (!e.core()) {
+        throw std::invalid_argument("not an ELF core file");
+    }
+    std::vector<program_header> notes;
+    for (size_t i = 0; i < e.program_count(); i++) {
+        program_header ph = e.get_program_by_id(i).value();
+        if (ph.segment_type() == pt_load) {
+            loads.push_back(ph);
+        } else if (ph.segment_type() == pt_note) {
+            notes.push_back(ph);
+        }
+    }
+    std::sort(loads.begin(), loads.end(), [](const program_header& a, const program_header& b) {
+        return a.address() < b.address();
+    });
+    for (const program_header& ph: notes) {
+        for (const note& n: read_notes(e.segment_data(ph), e.ident.endianness(), ph.alignment())) {
+            if (n.owner != "CORE") {
+                continue;
+            }
+            if (n.type == nt_file) {
+                read_file_note(n.desc);
+            } else if (n.type == nt_prstatus) {
+                read_prstatus(n.desc);
+            }
+        }
+    }
+    std::sort(mappings_.begin(), mappings_.end(), [](const core_mapping& a, const core_mapping& b) {
+        return a.start < b.start;
+    });
+    read_modules();
+}
+
+std::span<std::byte> core_file::memory(uint64_t address) const {
+    auto it = std::upper_bound(loads.begin(), loads.end(), address, [](uint64_t address, const program_header& ph) {
+        return address < ph.address();
+    });
+    if (it == loads.begin()) {
+        return {};
+    }
+    const program_header& ph = *std::prev(it);
+    std::span<std::byte> dumped = e.segment_data(ph);
+    if (address - ph.address() >= dumped.size()) {
+        return {};
+    }
+    return dumped.subspan(address - ph.address());
+}
+
+//count and page size words, count (start, end, page offset) triples, then count NUL terminated paths
+void core_file::read_file_note(std::span<std::byte> desc) {
+    span_reader r {desc};
+    r.file_offset_size = e.ident.bitwidth();
+    r.file_endianness = e.ident.endianness();
+    file_offset_size count;
+    file_offset_size page_size;
+    r & count & page_size;
+    if (count * 3 * r.file_offset_size > r.data.size()) {
+        throw std::runtime_error("bad NT_FILE note, " + to_string(count.data) + " entries don't fit in " + to_string(desc.size()) + " bytes");
+    }
+    size_t first = mappings_.size();
+    for (uint64_t i = 0; i < count; i++) {
+        file_offset_size start;
+        file_offset_size end;
+        file_offset_size page_offset;
+        r & start & end & page_offset;
+        mappings_.push_back({start, end, page_offset * page_size, {}, {}});
+    }
+    std::string_view paths {reinterpret_cast<const char*>(r.data.data()), r.data.size()};
+    for (size_t i = first; i < mappings_.size(); i++) {
+        size_t length = paths.find('\0');
+        if (length == std::string_view::npos) {
+            throw std::runtime_error("bad NT_FILE note, fewer paths than entries");
+        }
+        mappings_[i].path = paths.substr(0, length);
+        paths.remove_prefix(length + 1);
+    }
+}
+
+//struct elf_prstatus, the general purpose registers start after the signal, pid and time fields
+void core_file::read_prstatus(std::span<std::byte> desc) {
+    if (e.ident.bitwidth() != sizeof(uint64_t)) {
+        throw std::runtime_error("only 64-bit core files are supported");
+    }
+    constexpr size_t pid_offset = 32;
+    constexpr size_t registers_offset = 112;
+    size_t pc_index;
+    size_t sp_index;
+    switch (e.machine()) {
+        //EM_X86_64, struct user_regs_struct: rip and rsp
+        case 62:
+            pc_index = 16;
+            sp_index = 19;
+            break;
+        //EM_AARCH64, struct user_pt_regs: x0-x30, sp, pc, pstate
+        case 183:
+            pc_index = 32;
+            sp_index = 31;
+            break;
+        default:
+            throw std::runtime_error("unsupported core file machine: " + to_string(e.machine()));
+    }
+    if (registers_offset + 8 * (std::max(pc_index, sp_index) + 1) > desc.size()) {
+        throw std::runtime_error("NT_PRSTATUS note too small: " + to_string(desc.size()));
+    }
+    auto at = [&](size_t offset, auto& v) {
+        span_reader r {desc.subspan(offset)};
+        r.file_endianness = e.ident.endianness();
+        r & v;
+    };
+    core_thread t;
+    at(pid_offset, t.pid);
+    at(registers_offset + 8 * pc_index, t.pc);
+    at(registers_offset + 8 * sp_index, t.sp);
+    threads_.push_back(t);
+}
+
+//for each file, its build-id and load bias come from its ELF header and notes, which the kernel dumps
+//along with the first page of every mapped ELF file (coredump_filter bit 4, on by default)
+void core_file::read_modules() {
+    std::map<std::string_view, size_t> by_path;
+    for (const core_mapping& m: mappings_) {
+        auto [it, inserted] = by_path.emplace(m.path, modules_.size());
+        if (inserted) {
+            modules_.push_back({m.path, {}, m.start, m.end, m.start - m.file_offset});
+        }
+        core_module& module = modules_[it->second];
+        module.start = std::min(module.start, m.start);
+        module.end = std::max(module.end, m.end);
+    }
+    for (core_module& module: modules_) {
+        //the mapping of the start of the file, where the headers are
+        auto header = std::find_if(mappings_.begin(), mappings_.end(), [&](const core_mapping& m) {
+            return m.path == module.path && m.file_offset == 0;
+        });
+        if (header == mappings_.end()) {
+            continue;
+        }
+        std::span<std::byte> image = memory(header->start);
+        if (image.size() < 64 || std::memcmp(image.data(), "\x7f" "ELF", 4) != 0) {
+            continue;
+        }
+        try {
+            elf file {image};
+            if (file.program_headers_end() > image.size()) {
+                continue;
+            }
+            std::optional<uint64_t> first_load;
+            for (size_t i = 0; i < file.program_count(); i++) {
+                program_header ph = file.get_program_by_id(i).value();
+                if (ph.segment_type() == pt_load && !first_load) {
+                    first_load = ph.address() - ph.file_offset();
+                } else if (ph.segment_type() == pt_note && module.build_id.empty()) {
+                    //the notes are in the first mapping, at their file offset
+                    if (ph.file_offset() + ph.file_size() > image.size()) {
+                        continue;
+                    }
+                    for (const note& n: read_notes(image.subspan(ph.file_offset(), ph.file_size()), file.ident.endianness(), ph.alignment())) {
+                        if (n.owner == "GNU" && n.type == nt_gnu_build_id) {
+                            module.build_id = hex(n.desc);
+                        }
+                    }
+                }
+            }
+            //executables linked at a fixed address have a bias of 0, position independent ones their
+            //load address
+            if (first_load) {
+                module.load_bias = header->start - *first_load;
+            }
+        } catch (std::exception&) {
+            //a page that only looks like an ELF header, the module just has no build-id
+        }
+    }
+    for (core_mapping& m: mappings_) {
+        m.build_id = modules_[by_path[m.path]].build_id;
+    }
+}
+
+}
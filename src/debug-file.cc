@@ -0,0 +1,245 @@
+#include "debug-file.hh"
+
+#include <unistd.h>
+#include <array>
+#include <cstring>
+
+namespace elfy {
+
+using std::to_string;
+
+namespace {
+
+constexpr std::array<std::array<uint32_t, 256>, 8> make_crc32_tables() {
+    std::array<std::array<uint32_t, 256>, 8> t{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+        t[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (size_t s = 1; s < 8; s++) {
+            t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+        }
+    }
+    return t;
+}
+
+constexpr auto crc32_tables = make_crc32_tables();
+
+static_assert(crc32_tables[0][1] == 0x77073096);
+
+}
+
+uint32_t crc32(std::span<const std::byte> data, uint32_t crc) {
+    const auto& t = crc32_tables;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+    size_t n = data.size();
+    crc = ~crc;
+    //slicing-by-8: fold in eight bytes per step with one lookup per byte in eight tables
+    for (; n >= 8; p += 8, n -= 8) {
+        uint32_t lo = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24);
+        crc =
+            t[7][lo & 0xff] ^ t[6][lo >> 8 & 0xff] ^ t[5][lo >> 16 & 0xff] ^ t[4][lo >> 24] ^
+            t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; n > 0; p++, n--) {
+        crc = t[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+std::span<std::byte> build_id(elf& e) {
+    std::span<std::byte> notes = e.get_section_data_by_name(".note.gnu.build-id");
+    span_reader r {notes};
+    r.file_endianness = e.ident.endianness();
+    auto align4 = [](uint64_t n) {
+        return (n + 3) & ~uint64_t{3};
+    };
+    while (r.data.size() >= 12) {
+        uint32_t namesz;
+        uint32_t descsz;
+        uint32_t type;
+        r & namesz & descsz & type;
+        if (align4(namesz) + align4(descsz) > r.data.size()) {
+            throw std::runtime_error("bad ELF note, past the end of its section");
+        }
+        std::span<std::byte> name = r.read_bytes(align4(namesz)).first(namesz);
+        std::span<std::byte> desc = r.read_bytes(align4(descsz)).first(descsz);
+        //NT_GNU_BUILD_ID
+        if (type == 3 && namesz == 4 && std::memcmp(name.data(), "GNU", 4) == 0) {
+            return desc;
+        }
+    }
+    return {};
+}
+
+std::string build_id_hex(std::span<const std::byte> id) {
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string s;
+    s.reserve(id.size() * 2);
+    for (std::byte b: id) {
+        s += digits[std::to_integer<uint8_t>(b) >> 4];
+        s += digits[std::to_integer<uint8_t>(b) & 0xf];
+    }
+    return s;
+}
+
+std::optional<debug_link> read_debug_link(elf& e) {
+    std::span<std::byte> section = e.get_section_data_by_name(".gnu_debuglink");
+    if (section.empty()) {
+        return std::nullopt;
+    }
+    const char* p = reinterpret_cast<const char*>(section.data());
+    size_t length = strnlen(p, section.size());
+    //the filename is NUL terminated and padded to 4 bytes, then comes the CRC
+    size_t crc_offset = (length + 1 + 3) & ~size_t{3};
+    if (crc_offset + 4 > section.size()) {
+        throw std::runtime_error("bad .gnu_debuglink section, too short for its CRC: " + to_string(section.size()));
+    }
+    span_reader r {section.subspan(crc_offset)};
+    r.file_endianness = e.ident.endianness();
+    debug_link link;
+    link.filename = std::string{p, length};
+    r & link.crc;
+    return link;
+}
+
+}
+
+namespace dwarfy {
+
+namespace {
+
+bool file_exists(const std::string& path) {
+    return !path.empty() && access(path.c_str(), R_OK) == 0;
+}
+
+std::string dirname(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) {
+        return ".";
+    }
+    return path.substr(0, std::max<size_t>(slash, 1));
+}
+
+std::shared_ptr<elfy::mapped_file> open_if_build_id(const std::string& path, std::span<std::byte> id) {
+    if (!file_exists(path)) {
+        return nullptr;
+    }
+    auto f = std::make_shared<elfy::mapped_file>(path);
+    elfy::elf e{f->data};
+    std::span<std::byte> other = elfy::build_id(e);
+    if (!std::ranges::equal(other, id)) {
+        return nullptr;
+    }
+    return f;
+}
+
+std::shared_ptr<elfy::mapped_file> open_if_crc(const std::string& path, uint32_t crc) {
+    if (!file_exists(path)) {
+        return nullptr;
+    }
+    auto f = std::make_shared<elfy::mapped_file>(path);
+    if (elfy::crc32(f->data) != crc) {
+        return nullptr;
+    }
+    return f;
+}
+
+}
+
+std::shared_ptr<elfy::mapped_file> debug_file_resolver::search(elfy::elf& e, const std::string& path, std::span<std::byte> id) {
+    if (!id.empty()) {
+        std::string hex = elfy::build_id_hex(id);
+        for (const std::string& dir: debug_directories) {
+            std::string candidate = dir + "/.build-id/" + hex.substr(0, 2) + "/" + hex.substr(2) + ".debug";
+            if (auto f = open_if_build_id(candidate, id)) {
+                return f;
+            }
+        }
+    }
+
+    std::optional<elfy::debug_link> link = elfy::read_debug_link(e);
+    if (!link) {
+        return nullptr;
+    }
+    //same order as gdb: next to the binary, in .debug next to it, then under each debug directory
+    std::string dir = dirname(path);
+    std::vector<std::string> candidates = {
+        dir + "/" + link->filename,
+        dir + "/.debug/" + link->filename,
+    };
+    for (const std::string& debug_dir: debug_directories) {
+        candidates.push_back(debug_dir + (dir.starts_with("/") ? "" : "/") + dir + "/" + link->filename);
+    }
+    for (const std::string& candidate: candidates) {
+        //a debuglink naming the binary itself is common (e.g. before stripping), don't pair it with itself
+        if (candidate == path) {
+            continue;
+        }
+        if (auto f = open_if_crc(candidate, link->crc)) {
+            return f;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<elfy::mapped_file> debug_file_resolver::find(elfy::elf& e, const std::string& path) {
+    std::span<std::byte> id = elfy::build_id(e);
+    if (id.empty()) {
+        return search(e, path, id);
+    }
+    std::string key = elfy::build_id_hex(id);
+    {
+        std::lock_guard lock{m};
+        auto it = by_build_id.find(key);
+        if (it != by_build_id.end()) {
+            return it->second;
+        }
+    }
+    //search outside the lock, checksumming a large debug file takes a while
+    std::shared_ptr<elfy::mapped_file> f = search(e, path, id);
+    std::lock_guard lock{m};
+    return by_build_id.emplace(key, f).first->second;
+}
+
+debug_file_pair debug_file_resolver::open(const std::string& path) {
+    auto binary = std::make_shared<elfy::mapped_file>(path);
+    elfy::elf e{binary->data};
+    std::shared_ptr<elfy::mapped_file> debug = find(e, path);
+    if (!debug) {
+        return {binary, nullptr, std::nullopt, dwarf{e}};
+    }
+    elfy::elf de{debug->data};
+    dwarf d = combine_debug_sections(e, de);
+    return {binary, debug, std::move(de), std::move(d)};
+}
+
+size_t debug_file_resolver::memoized() {
+    std::lock_guard lock{m};
+    return by_build_id.size();
+}
+
+dwarf combine_debug_sections(elfy::elf& binary, elfy::elf& debug) {
+    dwarf d{binary};
+    dwarf other{debug};
+    static constexpr std::span<std::byte> dwarf::* sections[] = {
+        &dwarf::debug_abbrev, &dwarf::debug_addr, &dwarf::debug_aranges, &dwarf::debug_frame,
+        &dwarf::debug_info, &dwarf::debug_line, &dwarf::debug_line_str, &dwarf::debug_loc,
+        &dwarf::debug_loclists, &dwarf::debug_macinfo, &dwarf::debug_macro, &dwarf::debug_names,
+        &dwarf::debug_pubnames, &dwarf::debug_pubtypes, &dwarf::debug_ranges, &dwarf::debug_rnglists,
+        &dwarf::debug_str, &dwarf::debug_str_offsets, &dwarf::debug_sup, &dwarf::debug_types,
+        &dwarf::debug_cu_index, &dwarf::debug_tu_index,
+    };
+    for (auto section: sections) {
+        if ((d.*section).empty()) {
+            d.*section = other.*section;
+        }
+    }
+    return d;
+}
+
+}
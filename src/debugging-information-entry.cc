@@ -16,7 +16,7 @@ debugging_information_entry::iterator::iterator():
     debug_info_reader({}),
     debug_abbrev_reader({})
 {}
-debugging_information_entry::iterator::iterator(dwarf* d_, span_reader debug_info_reader_):
+debugging_information_entry::iterator::iterator(const dwarf* d_, span_reader debug_info_reader_):
     d(d_),
     debug_info_reader(debug_info_reader_),
     debug_abbrev_reader(d->debug_abbrev)
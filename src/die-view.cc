@@ -0,0 +1,122 @@
+#include "die-view.hh"
+
+#include <algorithm>
+
+namespace dwarfy {
+
+using std::to_string;
+
+size_t fixed_form_size(dw_form form, const unit_context& unit) {
+    switch (form) {
+        case dw_form::flag_present:
+        case dw_form::implicit_const:
+            return 0;
+        case dw_form::data1:
+        case dw_form::flag:
+        case dw_form::ref1:
+        case dw_form::strx1:
+        case dw_form::addrx1:
+            return 1;
+        case dw_form::data2:
+        case dw_form::ref2:
+        case dw_form::strx2:
+        case dw_form::addrx2:
+            return 2;
+        case dw_form::strx3:
+        case dw_form::addrx3:
+            return 3;
+        case dw_form::data4:
+        case dw_form::ref4:
+        case dw_form::ref_sup4:
+        case dw_form::strx4:
+        case dw_form::addrx4:
+            return 4;
+        case dw_form::data8:
+        case dw_form::ref8:
+        case dw_form::ref_sup8:
+        case dw_form::ref_sig8:
+            return 8;
+        case dw_form::data16:
+            return 16;
+        case dw_form::addr:
+            return unit.address_size;
+        //as read_form reads them, offset sized
+        case dw_form::strp:
+        case dw_form::line_strp:
+        case dw_form::strp_sup:
+        case dw_form::ref_addr:
+        case dw_form::sec_offset:
+        case dw_form::GNU_ref_alt:
+        case dw_form::GNU_strp_alt:
+            return unit.offset_size;
+        default:
+            return SIZE_MAX;
+    }
+}
+
+decode_plans::decode_plans(const dwarf& d_, compilation_unit_header& cu_, dw_tag tag_, std::span<const dw_at> names_):
+    d(d_),
+    cu(cu_),
+    tag(tag_),
+    names(names_)
+{}
+
+const abbrev_plan& decode_plans::build(uint64_t code) {
+    span_reader ar {d.debug_abbrev.subspan(d.find_abbrev(uleb128{code}, cu))};
+    ar.file_endianness = d.initial_endianness;
+    debug_abbrev_entry dae;
+    ar & dae;
+    abbrev_plan plan;
+    plan.built = true;
+    plan.wanted = dae.tag == tag;
+    uint32_t skip = 0;
+    while (true) {
+        decode_step s;
+        ar & s.name & s.form;
+        if (s.form == dw_form::implicit_const) {
+            std::span<std::byte> start = ar.data;
+            sleb128 v;
+            ar & v;
+            s.implicit = start.first(start.size() - ar.data.size());
+        }
+        if (s.name == static_cast<dw_at>(0) && s.form == static_cast<dw_form>(0)) {
+            break;
+        }
+        if (plan.wanted) {
+            auto it = std::find(names.begin(), names.end(), s.name);
+            if (it != names.end()) {
+                s.slot = it - names.begin();
+            }
+        }
+        size_t size = fixed_form_size(s.form, cu.context);
+        if (s.slot == decode_step::no_slot && size != SIZE_MAX) {
+            skip += size;
+            continue;
+        }
+        s.skip = skip;
+        skip = 0;
+        plan.steps.push_back(s);
+    }
+    if (skip != 0) {
+        decode_step s;
+        s.skip = skip;
+        plan.steps.push_back(s);
+    }
+    if (code >= plans.size()) {
+        plans.resize(code + 1);
+    }
+    plans[code] = std::move(plan);
+    return plans[code];
+}
+
+visit_unit prepare_visit(compilation_unit_header::iterator& cu_it) {
+    visit_unit u {(*cu_it).d, *cu_it, cu_it.die_data()};
+    if (!u.dies.empty()) {
+        span_reader r = u.cu.context.reader(u.dies);
+        debug_abbrev_entry dae;
+        u.cu.context.read_bases(u.d->read_attributes(r, u.cu, dae));
+    }
+    return u;
+}
+
+}
@@ -31,26 +31,138 @@ std::string to_string(attribute attr) {
 }
 void read(span_reader &ir, span_reader &ar, attribute& a) {
     ar & a.name & a.form;
-    if (!a.is_last()) {
+    if (a.form == dw_form::indirect) {
+        ir & a.form;
+    }
+    if (a.form == dw_form::implicit_const) {
+        //the value lives in the abbreviation rather than in .debug_info
+        std::span<std::byte> start = ar.data;
+        sleb128 v;
+        ar & v;
+        a.data = start.first(start.size() - ar.data.size());
+    } else if (!a.is_last()) {
         a.data = read_form(ir, a.form);
     }
 }
+uint64_t attribute::unsigned_value(std::endian endianness) const {
+    span_reader r {data};
+    r.file_endianness = endianness;
+    switch (form) {
+        case dw_form::flag_present:
+            return 1;
+        case dw_form::sdata:
+        case dw_form::implicit_const:
+            return signed_value(endianness);
+        case dw_form::udata:
+        case dw_form::ref_udata:
+        case dw_form::strx:
+        case dw_form::addrx:
+        case dw_form::loclistx:
+        case dw_form::rnglistx:
+        case dw_form::GNU_addr_index:
+        case dw_form::GNU_str_index:
+            {
+                uleb128 v;
+                r & v;
+                return v;
+            }
+        default:
+            break;
+    }
+    if (data.size() > sizeof(uint64_t)) {
+        throw std::runtime_error("attribute of form " + to_string(form) + " is too large for an integer");
+    }
+    //fixed size forms are exactly their encoded bytes
+    uint64_t v = 0;
+    for (size_t i = 0; i < data.size(); i++) {
+        size_t shift = endianness == std::endian::little ? i : data.size() - 1 - i;
+        v |= static_cast<uint64_t>(data[i]) << (8 * shift);
+    }
+    return v;
+}
+int64_t attribute::signed_value(std::endian endianness) const {
+    if (form == dw_form::sdata || form == dw_form::implicit_const) {
+        span_reader r {data};
+        r.file_endianness = endianness;
+        sleb128 v;
+        r & v;
+        return static_cast<int64_t>(v.data);
+    }
+    uint64_t v = unsigned_value(endianness);
+    size_t bits = data.size() * 8;
+    if (bits > 0 && bits < 64 && (v & (1ULL << (bits - 1)))) {
+        v |= ~0ULL << bits;
+    }
+    return static_cast<int64_t>(v);
+}
 void read(span_reader &r, debugging_information_entry& die) {
     r & die.abbrev_code;
 }
+span_reader unit_context::reader(std::span<std::byte> data) const {
+    span_reader r {data};
+    r.file_endianness = endianness;
+    r.file_offset_size = offset_size;
+    r.machine_address_size = address_size;
+    r.machine_segment_size = 0;
+    return r;
+}
+void unit_context::read_bases(std::span<const attribute> root_attributes) {
+    for (const attribute& a: root_attributes) {
+        if (a.name == dw_at::str_offsets_base) {
+            str_offsets_base = a.unsigned_value(endianness);
+        } else if (a.name == dw_at::addr_base || a.name == dw_at::GNU_addr_base) {
+            addr_base = a.unsigned_value(endianness);
+        }
+    }
+}
+
+//the header's own fields are read through a reader set up from its context, the caller's reader only
+//moves past them
 void read(span_reader &r, type_unit_header& tu) {
-    r & tu.unit_length & tu.version & tu.debug_abbrev_offset & tu.address_size & tu.type_signature & tu.type_offset;
-    r.machine_address_size = tu.address_size;
+    r & tu.unit_length & tu.version;
     if (tu.version < 2 || tu.version > 5) {
         throw std::runtime_error("unsupported DWARF version, expected 2 <= version <= 5, got: " + to_string(tu.version));
     }
+    tu.context.version = tu.version;
+    tu.context.offset_size = tu.unit_length.offset_size();
+    tu.context.endianness = r.file_endianness;
+    span_reader hr = tu.context.reader(r.data);
+    hr & tu.debug_abbrev_offset & tu.address_size & tu.type_signature & tu.type_offset;
+    tu.context.address_size = tu.address_size;
+    r.data = hr.data;
 }
 void read(span_reader &r, compilation_unit_header& cu) {
-    r & cu.unit_length & cu.version & cu.debug_abbrev_offset & cu.address_size;
-    r.machine_address_size = cu.address_size;
+    r & cu.unit_length & cu.version;
     if (cu.version < 2 || cu.version > 5) {
         throw std::runtime_error("unsupported DWARF version, expected 2 <= version <= 5, got: " + to_string(cu.version));
     }
+    cu.context = {};
+    cu.context.version = cu.version;
+    cu.context.offset_size = cu.unit_length.offset_size();
+    cu.context.endianness = r.file_endianness;
+    span_reader hr = cu.context.reader(r.data);
+    if (cu.version >= 5) {
+        uint8_t unit_type;
+        hr & unit_type & cu.address_size & cu.debug_abbrev_offset;
+        cu.unit_type = static_cast<dw_ut>(unit_type);
+        if (cu.unit_type == dw_ut::skeleton || cu.unit_type == dw_ut::split_compile) {
+            hr & cu.dwo_id;
+        } else if (cu.unit_type == dw_ut::type || cu.unit_type == dw_ut::split_type) {
+            hr & cu.type_signature & cu.type_offset;
+        }
+        //split units have no DW_AT_str_offsets_base, their strx forms index the .debug_str_offsets.dwo
+        //table (or the unit's contribution to it in a .dwp) from just after its header
+        if (cu.unit_type == dw_ut::split_compile || cu.unit_type == dw_ut::split_type) {
+            cu.context.str_offsets_base = cu.context.offset_size == 4 ? 8 : 16;
+        }
+    } else {
+        hr & cu.debug_abbrev_offset & cu.address_size;
+    }
+    if (cu.address_size != 4 && cu.address_size != 8) {
+        throw std::runtime_error("unsupported unit address size: " + to_string(cu.address_size));
+    }
+    cu.context.address_size = cu.address_size;
+    r.data = hr.data;
 }
 void read(span_reader &r, debug_abbrev_entry& dae) {
     r & dae.abbrev_code;
@@ -63,87 +175,349 @@ void read(span_reader& r, initial_length& i) {
     uint32_t l;
     r & l;
     if (l == 0xffffffffUL) {
-        r.file_offset_size = 8;
         r & i.length;
         i.read_bytes = 12;
     } else if (l < 0xfffffff0UL) {
-        r.file_offset_size = 4;
         i.length = l;
         i.read_bytes = 4;
     } else {
         throw std::runtime_error("bad DWARF initial length field, expected ==0xffffffff or <0xfffffff0, got: " + to_string(l));
     }
-    //FIXME what about mixed bitwidths in the same file?
 };
 
-compilation_unit_header::iterator dwarf::cu_iter() {
-    return compilation_unit_header::iterator{this};
+std::span<std::byte> dwarf::section_data(std::string_view name) const {
+    std::optional<elfy::section_header> sh;
+    {
+        scoped_phase timer{stats, phase::section_lookup};
+        sh = elf.get_section_by_name(name);
+    }
+    if (!sh) {
+        return {};
+    }
+    if (sh->compressed()) {
+        scoped_phase timer{stats, phase::decompression};
+        return sh->data(elf);
+    }
+    return sh->data(elf);
 }
 
-size_t dwarf::find_abbrev(uleb128 abbrev_code) {
-    static std::vector<size_t> abbrev_vec;
-
-    if (abbrev_vec.empty()) {
-        span_reader debug_abbrev_reader {debug_abbrev};
-        debug_abbrev_reader.file_endianness = initial_endianness;
+const std::vector<size_t>& dwarf::abbrev_table(const std::byte* start) const {
+    {
+        std::lock_guard lock{cache->abbrev_m};
+        auto it = cache->abbrev_tables.find(start);
+        if (it != cache->abbrev_tables.end()) {
+            stats.abbrev_hit();
+            return it->second;
+        }
+    }
+    stats.abbrev_miss();
+    //decoded outside the lock, if two threads race for one table the first to insert wins
+    scoped_phase timer{stats, phase::abbrev_decode};
+    std::vector<size_t> table;
+    span_reader debug_abbrev_reader {debug_abbrev.subspan(start - debug_abbrev.data())};
+    debug_abbrev_reader.file_endianness = initial_endianness;
+    while (!debug_abbrev_reader.data.empty()) {
+        size_t offset = debug_abbrev_reader.data.data() - debug_abbrev.data();
+        debug_abbrev_entry dae;
+        debug_abbrev_reader & dae;
+        if (dae.is_last()) {
+            break;
+        }
+        //codes are normally 1 to n, anything sparser than that is a corrupt table
+        if (dae.abbrev_code > 4 * (table.size() + 1024)) {
+            throw std::runtime_error("abbrev code out of range: " + to_string(dae.abbrev_code.data));
+        }
+        if (dae.abbrev_code >= table.size()) {
+            table.resize(dae.abbrev_code + 1, SIZE_MAX);
+        }
+        table[dae.abbrev_code] = offset;
         while (true) {
-            debug_abbrev_entry dae;
-            std::span<std::byte> start = debug_abbrev_reader.data;
-            std::cout << "reading dae at offset " << start.data() - debug_abbrev.data() << std::endl;
-            debug_abbrev_reader & dae;
-            if (dae.is_last()) {
-                continue;
-            }
-
-            while (true) {
-                attribute a;
-                debug_abbrev_reader & a.name & a.form;
-                if (a.is_last()) {
-                    break;
-                }
+            attribute a;
+            debug_abbrev_reader & a.name & a.form;
+            if (a.form == dw_form::implicit_const) {
+                sleb128 v;
+                debug_abbrev_reader & v;
             }
-
-            size_t offset = start.data() - debug_abbrev.data();
-            abbrev_vec.resize(std::max(abbrev_vec.size(), dae.abbrev_code + 1));
-            abbrev_vec[dae.abbrev_code] = offset;
-
-            //FIXME
-            //seems to run off the end of real DAEs but still has data in the section
-            if (debug_abbrev_reader.data.empty()) {
+            if (a.is_last()) {
                 break;
             }
         }
     }
-    if (abbrev_code < abbrev_vec.size()) {
-        return abbrev_vec[abbrev_code];
-    } else {
+    stats.section_read(stats_section::abbrev, debug_abbrev_reader.data.data() - start);
+    std::lock_guard lock{cache->abbrev_m};
+    return cache->abbrev_tables.emplace(start, std::move(table)).first->second;
+}
+
+compilation_unit_header::iterator dwarf::cu_iter() const {
+    return compilation_unit_header::iterator{this};
+}
+
+size_t dwarf::find_abbrev(uleb128 abbrev_code, compilation_unit_header& cu) const {
+    if (cu.debug_abbrev_offset >= debug_abbrev.size()) {
+        throw std::runtime_error("abbrev offset out of range: " + to_string(cu.debug_abbrev_offset));
+    }
+    const std::byte* key = debug_abbrev.data() + cu.debug_abbrev_offset;
+    if (cu.abbrev_table != key) {
+        cu.abbrevs = &abbrev_table(key);
+        cu.abbrev_table = key;
+    }
+    const std::vector<size_t>& table = *cu.abbrevs;
+    if (abbrev_code >= table.size() || table[abbrev_code] == SIZE_MAX) {
         throw std::runtime_error("no abbrev code found for die");
     }
+    return table[abbrev_code];
 }
 
-size_t dwarf::find_abbrev(uleb128 abbrev_code, compilation_unit_header& cu) {
-    size_t offset = cu.debug_abbrev_offset;
-    span_reader debug_abbrev_reader {debug_abbrev.subspan(offset)};
+std::vector<attribute> dwarf::read_attributes(span_reader& reader, compilation_unit_header& cu, debug_abbrev_entry& dae) const {
+    scoped_phase timer{stats, phase::die_walk};
+    span_reader debug_info_reader = cu.context.reader(reader.data);
+    const std::byte* start = debug_info_reader.data.data();
+    std::vector<attribute> attributes;
+    debugging_information_entry die;
+    debug_info_reader & die;
+    stats.leb128(debug_info_reader.data.data() - start);
+    if (die.is_last()) {
+        dae = {};
+        stats.die(debug_info_reader.data.data() - start);
+        reader.data = debug_info_reader.data;
+        return attributes;
+    }
+    span_reader debug_abbrev_reader {debug_abbrev.subspan(find_abbrev(die.abbrev_code, cu))};
     debug_abbrev_reader.file_endianness = initial_endianness;
-    debug_abbrev_entry dae;
+    debug_abbrev_reader & dae;
     while (true) {
-        offset = debug_abbrev_reader.data.data() - debug_abbrev.data();
-        //std::cout << "reading dae at offset " << offset << std::endl;
-        debug_abbrev_reader & dae;
-        if (dae.is_last()) {
-            throw std::runtime_error("no abbrev code found for die");
+        attribute attr;
+        read(debug_info_reader, debug_abbrev_reader, attr);
+        if (attr.is_last()) {
+            break;
         }
-        if (dae.abbrev_code == abbrev_code) {
-            return offset;
+        stats.form(attr.form);
+        switch (attr.form) {
+            case dw_form::udata:
+            case dw_form::sdata:
+            case dw_form::ref_udata:
+            case dw_form::strx:
+            case dw_form::addrx:
+            case dw_form::loclistx:
+            case dw_form::rnglistx:
+            case dw_form::GNU_addr_index:
+            case dw_form::GNU_str_index:
+                stats.leb128(attr.data.size());
+                break;
+            default:
+                break;
         }
-        while (true) {
-            attribute a;
-            debug_abbrev_reader & a.name & a.form;
-            if (a.is_last()) {
+        attributes.push_back(attr);
+    }
+    stats.die(debug_info_reader.data.data() - start);
+    reader.data = debug_info_reader.data;
+    return attributes;
+}
+
+list_context dwarf::unit_list_context(compilation_unit_header::iterator& cu_it) const {
+    compilation_unit_header cu = *cu_it;
+    span_reader r = cu_it.die_reader();
+    list_context ctx;
+    ctx.version = cu.context.version;
+    ctx.address_size = cu.context.address_size;
+    ctx.offset_size = cu.context.offset_size;
+    ctx.endianness = initial_endianness;
+    ctx.debug_addr = debug_addr;
+
+    debug_abbrev_entry dae;
+    std::optional<attribute> low_pc;
+    for (const attribute& a: read_attributes(r, cu, dae)) {
+        switch (a.name) {
+            case dw_at::low_pc:
+                low_pc = a;
                 break;
-            }
+            case dw_at::addr_base:
+            case dw_at::GNU_addr_base:
+                ctx.addr_base = a.unsigned_value(initial_endianness);
+                break;
+            case dw_at::rnglists_base:
+                ctx.rnglists_base = a.unsigned_value(initial_endianness);
+                break;
+            case dw_at::loclists_base:
+                ctx.loclists_base = a.unsigned_value(initial_endianness);
+                break;
+            default:
+                break;
+        }
+    }
+    if (cu.version >= 5) {
+        //without an explicit base the offsets array follows the first list table header
+        size_t header_size = ctx.offset_size == 4 ? 12 : 20;
+        if (ctx.rnglists_base == 0) {
+            ctx.rnglists_base = header_size;
+        }
+        if (ctx.loclists_base == 0) {
+            ctx.loclists_base = header_size;
+        }
+    }
+    if (low_pc) {
+        uint64_t v = low_pc->unsigned_value(initial_endianness);
+        if (low_pc->form == dw_form::addr) {
+            ctx.base_address = v;
+        } else {
+            ctx.base_address = indexed_address(ctx, v);
         }
     }
+    return ctx;
+}
+
+range_list dwarf::ranges(const attribute& a, const list_context& ctx) const {
+    std::span<std::byte> section = ctx.version >= 5 ? debug_rnglists : debug_ranges;
+    uint64_t offset = a.unsigned_value(initial_endianness);
+    if (a.form == dw_form::rnglistx) {
+        offset = list_offset_from_index(section, ctx.rnglists_base, offset, ctx);
+    }
+    return range_list{section, offset, ctx};
+}
+
+location_list dwarf::locations(const attribute& a, const list_context& ctx) const {
+    std::span<std::byte> section = ctx.version >= 5 ? debug_loclists : debug_loc;
+    uint64_t offset = a.unsigned_value(initial_endianness);
+    if (a.form == dw_form::loclistx) {
+        offset = list_offset_from_index(section, ctx.loclists_base, offset, ctx);
+    }
+    return location_list{section, offset, ctx};
+}
+
+location_index_cache dwarf::location_cache(const list_context& ctx) const {
+    return location_index_cache{ctx.version >= 5 ? debug_loclists : debug_loc, ctx};
+}
+
+std::string_view dwarf::read_string(const attribute& a, const unit_context& unit) const {
+    auto c_string = [](std::span<std::byte> section, uint64_t offset) {
+        if (offset >= section.size()) {
+            throw std::runtime_error("string offset out of range: " + to_string(offset));
+        }
+        const char* s = reinterpret_cast<const char*>(section.data() + offset);
+        return std::string_view{s, strnlen(s, section.size() - offset)};
+    };
+    switch (a.form) {
+        case dw_form::string:
+            return c_string(a.data, 0);
+        case dw_form::strp:
+            {
+                std::string_view s = c_string(debug_str, a.unsigned_value(initial_endianness));
+                stats.section_read(stats_section::str, s.size() + 1);
+                return s;
+            }
+        case dw_form::line_strp:
+            return c_string(debug_line_str, a.unsigned_value(initial_endianness));
+        case dw_form::strx:
+        case dw_form::strx1:
+        case dw_form::strx2:
+        case dw_form::strx3:
+        case dw_form::strx4:
+        case dw_form::GNU_str_index:
+            {
+                uint64_t index = a.unsigned_value(initial_endianness);
+                if (unit.str_offsets_base > debug_str_offsets.size() || index >= (debug_str_offsets.size() - unit.str_offsets_base) / unit.offset_size) {
+                    throw std::runtime_error(".debug_str_offsets index out of range: " + to_string(index));
+                }
+                span_reader r = unit.reader(debug_str_offsets.subspan(unit.str_offsets_base + index * unit.offset_size));
+                file_offset_size offset;
+                r & offset;
+                stats.section_read(stats_section::str_offsets, unit.offset_size);
+                std::string_view s = c_string(debug_str, offset);
+                stats.section_read(stats_section::str, s.size() + 1);
+                return s;
+            }
+        default:
+            throw std::runtime_error("expected a string attribute, got form: " + to_string(a.form));
+    }
+}
+
+void dwarf::select_dwo_sections() {
+    debug_abbrev = debug_abbrev_dwo;
+    debug_info = debug_info_dwo;
+    debug_line = debug_line_dwo;
+    debug_loclists = debug_loclists_dwo;
+    debug_macro = debug_macro_dwo;
+    debug_rnglists = debug_rnglists_dwo;
+    debug_str = debug_str_dwo;
+    debug_str_offsets = debug_str_offsets_dwo;
+    debug_types = debug_types_dwo;
+    reset_cache();
+}
+
+void dwarf::reset_cache() {
+    cache = std::make_shared<dwarf_cache>();
+}
+
+const type_unit_entry* dwarf::type_by_signature(uint64_t signature) const {
+    dwarf_cache& c = *cache;
+    std::call_once(c.type_units_once, [&]() {
+        c.type_unit_map = scan_type_units(*this);
+    });
+    return c.type_unit_map->find(signature);
+}
+
+const type_unit_entry* dwarf::follow_signature(const attribute& a) const {
+    if (a.form != dw_form::ref_sig8) {
+        throw std::runtime_error("expected a ref_sig8 attribute, got form: " + to_string(a.form));
+    }
+    return type_by_signature(a.unsigned_value(initial_endianness));
+}
+
+const unit_index& dwarf::units() const {
+    dwarf_cache& c = *cache;
+    std::call_once(c.units_once, [&]() {
+        c.units.emplace(debug_info, initial_endianness);
+    });
+    return *c.units;
+}
+
+std::optional<uint64_t> dwarf::reference_target(const attribute& a, uint64_t unit_offset) const {
+    switch (a.form) {
+        case dw_form::ref1:
+        case dw_form::ref2:
+        case dw_form::ref4:
+        case dw_form::ref8:
+        case dw_form::ref_udata:
+            return unit_offset + a.unsigned_value(initial_endianness);
+        case dw_form::ref_addr:
+            return a.unsigned_value(initial_endianness);
+        case dw_form::ref_sig8:
+        case dw_form::GNU_ref_alt:
+        case dw_form::ref_sup4:
+        case dw_form::ref_sup8:
+            return std::nullopt;
+        default:
+            throw std::runtime_error("expected a reference attribute, got form: " + to_string(a.form));
+    }
+}
+
+unit_die dwarf::die_at(uint64_t offset) const {
+    std::optional<uint64_t> unit_offset = units().unit_containing(offset);
+    if (!unit_offset) {
+        throw std::runtime_error("DIE offset out of range: " + to_string(offset));
+    }
+    unit_die die;
+    die.offset = offset;
+    die.unit_offset = *unit_offset;
+    span_reader r {debug_info.subspan(*unit_offset)};
+    r.file_endianness = initial_endianness;
+    r & die.cu;
+    uint64_t root = r.data.data() - debug_info.data();
+    if (offset < root || offset >= *unit_offset + die.cu.unit_length + die.cu.unit_length.size()) {
+        throw std::runtime_error("DIE offset " + to_string(offset) + " is outside the DIEs of the unit at " + to_string(*unit_offset));
+    }
+    //the root DIE's bases are needed to decode the strx and addrx forms of any DIE in the unit
+    debug_abbrev_entry root_abbrev;
+    std::vector<attribute> root_attributes = read_attributes(r, die.cu, root_abbrev);
+    die.cu.context.read_bases(root_attributes);
+    if (offset == root) {
+        die.abbrev = root_abbrev;
+        die.attributes = std::move(root_attributes);
+        return die;
+    }
+    span_reader dr {debug_info.subspan(offset)};
+    die.attributes = read_attributes(dr, die.cu, die.abbrev);
+    return die;
 }
 
 struct target_address {
@@ -165,7 +539,9 @@ struct arange_unit_header {
     uint8_t machine_segment_size;
 };
 void read(span_reader &r, arange_unit_header& au) {
-    r & au.unit_length & au.version & au.debug_info_offset & au.machine_address_size & au.machine_segment_size;
+    r & au.unit_length;
+    r.file_offset_size = au.unit_length.offset_size();
+    r & au.version & au.debug_info_offset & au.machine_address_size & au.machine_segment_size;
     if (au.machine_segment_size > 8) {
         throw std::runtime_error("error, dwarfy doesn't support segment sizes over 8 bytes");
     }
@@ -230,7 +606,7 @@ void dwarf::read_debug_info() {
             debug_abbrev_entry dae;
             debug_abbrev_reader & dae;
 
-            std::cout << to_string(dae.tag) << std::endl;
+            std::cout << to_string_view(dae.tag) << std::endl;
 
             span_reader debug_info_reader = die_it.debug_info_reader;
             while (true) {
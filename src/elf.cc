@@ -1,13 +1,443 @@
 #include "elfy.hh"
+#include "parallel.hh"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <lzma.h>
+#include <zlib.h>
 
 namespace elfy {
 
-std::string_view section_header::name(elf& e) const {
+using std::to_string;
+
+struct elf_cache {
+    std::mutex decompressed_m;
+    //by section offset, std::map so buffers never move once handed out
+    std::map<uint64_t, std::vector<std::byte>> decompressed;
+
+    std::once_flag mini_once;
+    std::vector<std::byte> mini_data;
+    std::unique_ptr<elf> mini;
+
+    std::once_flag sorted_once;
+    std::vector<symbol> sorted;
+
+    //ET_REL only, the SHT_REL/SHT_RELA section indices that apply to each section, by its file offset
+    std::once_flag relocations_once;
+    std::unordered_map<uint64_t, std::vector<size_t>> relocation_sections;
+    std::mutex relocated_m;
+    //copy on write overlay of the sections that have relocations, sections without any stay mapped
+    std::map<uint64_t, std::vector<std::byte>> relocated;
+};
+
+namespace {
+
+std::vector<std::byte> decompress_xz(std::span<const std::byte> in) {
+    lzma_stream s = LZMA_STREAM_INIT;
+    lzma_ret ret = lzma_stream_decoder(&s, UINT64_MAX, 0);
+    if (ret != LZMA_OK) {
+        throw std::runtime_error("failed to initialise the xz decoder: " + to_string(ret));
+    }
+    std::vector<std::byte> out(std::max<size_t>(in.size() * 4, 4096));
+    s.next_in = reinterpret_cast<const uint8_t*>(in.data());
+    s.avail_in = in.size();
+    s.next_out = reinterpret_cast<uint8_t*>(out.data());
+    s.avail_out = out.size();
+    while (true) {
+        ret = lzma_code(&s, LZMA_FINISH);
+        if (ret == LZMA_STREAM_END) {
+            break;
+        }
+        if (ret != LZMA_OK) {
+            lzma_end(&s);
+            throw std::runtime_error("failed to decompress .gnu_debugdata: " + to_string(ret));
+        }
+        if (s.avail_out == 0) {
+            size_t used = out.size();
+            out.resize(used * 2);
+            s.next_out = reinterpret_cast<uint8_t*>(out.data() + used);
+            s.avail_out = out.size() - used;
+        }
+    }
+    out.resize(s.total_out);
+    lzma_end(&s);
+    return out;
+}
+
+}
+
+elf::elf(std::span<std::byte> data_):
+    data(data_),
+    cache(std::make_shared<elf_cache>())
+{
+    span_reader r {data};
+    r & ident & header;
+}
+
+std::string_view section_header::name(const elf& e) const {
     std::span<std::byte> section_names = e.get_section_by_id(e.header.shstrndx).value().data(e);
     return std::string_view{reinterpret_cast<char*>(section_names.subspan(name_).data())};
 }
-std::span<std::byte> section_header::data(elf& e) const {
-    return e.data.subspan(offset, size);
+std::span<std::byte> section_header::data(const elf& e) const {
+    std::span<std::byte> contents = e.data.subspan(offset, size);
+    if (compressed()) {
+        contents = e.decompress(offset, contents);
+    }
+    if (e.relocatable() && !allocated() && !is_relocation()) {
+        return e.relocate(*this, contents);
+    }
+    return contents;
+}
+
+std::span<std::byte> elf::segment_data(const program_header& ph) const {
+    if (ph.file_offset() >= data.size()) {
+        return {};
+    }
+    return data.subspan(ph.file_offset(), std::min<uint64_t>(ph.file_size(), data.size() - ph.file_offset()));
+}
+
+std::vector<note> read_notes(std::span<std::byte> contents, std::endian endianness, size_t alignment) {
+    alignment = alignment == 8 ? 8 : 4;
+    //the name and desc start at aligned offsets from the start of the segment, so in 8 byte aligned
+    //notes (.note.gnu.property) the padding after the 12 byte header and name isn't just the size rounded up
+    auto aligned = [&](uint64_t offset) {
+        return (offset + alignment - 1) & ~(alignment - 1);
+    };
+    std::vector<note> notes;
+    uint64_t offset = 0;
+    while (offset + 12 <= contents.size()) {
+        span_reader r {contents.subspan(offset)};
+        r.file_endianness = endianness;
+        uint32_t name_size;
+        uint32_t desc_size;
+        note n;
+        r & name_size & desc_size & n.type;
+        uint64_t name_offset = offset + 12;
+        uint64_t desc_offset = aligned(name_offset + name_size);
+        uint64_t end = aligned(desc_offset + desc_size);
+        if (desc_offset + desc_size > contents.size()) {
+            throw std::runtime_error("note runs off the end of its segment, name size " + to_string(name_size) + ", desc size " + to_string(desc_size));
+        }
+        n.owner = std::string_view{reinterpret_cast<const char*>(contents.data() + name_offset), name_size};
+        //the size includes the terminator
+        if (!n.owner.empty() && n.owner.back() == '\0') {
+            n.owner.remove_suffix(1);
+        }
+        n.desc = contents.subspan(desc_offset, desc_size);
+        notes.push_back(n);
+        offset = end;
+    }
+    return notes;
+}
+
+std::span<std::byte> elf::decompress(uint64_t offset, std::span<std::byte> compressed) const {
+    std::lock_guard lock{cache->decompressed_m};
+    auto it = cache->decompressed.find(offset);
+    if (it != cache->decompressed.end()) {
+        return it->second;
+    }
+
+    span_reader r {compressed};
+    r.file_offset_size = ident.bitwidth();
+    r.file_endianness = ident.endianness();
+    uint32_t type;
+    file_offset_size size;
+    file_offset_size align;
+    r & type;
+    if (r.file_offset_size == sizeof(uint64_t)) {
+        uint32_t reserved;
+        r & reserved;
+    }
+    r & size & align;
+    //ELFCOMPRESS_ZLIB
+    if (type != 1) {
+        throw std::runtime_error("unsupported ELF section compression type, only zlib is supported, got: " + to_string(type));
+    }
+    std::vector<std::byte> out(size);
+    uLongf out_size = out.size();
+    int err = uncompress(reinterpret_cast<Bytef*>(out.data()), &out_size, reinterpret_cast<const Bytef*>(r.data.data()), r.data.size());
+    if (err != Z_OK || out_size != out.size()) {
+        throw std::runtime_error("failed to decompress zlib compressed ELF section: " + to_string(err));
+    }
+    return cache->decompressed.emplace(offset, std::move(out)).first->second;
+}
+
+namespace {
+
+//how to apply one relocation type: the field width, and whether it's relative to the place it patches
+struct relocation_kind {
+    uint8_t size;
+    bool pc_relative;
+};
+
+//the relocation types compilers emit into debug sections, anything else is an error rather than a
+//silently wrong offset
+std::optional<relocation_kind> relocation_kind_of(uint16_t machine, uint32_t type) {
+    switch (machine) {
+        //EM_X86_64
+        case 62:
+            switch (type) {
+                case 0: return relocation_kind{0, false};   //R_X86_64_NONE
+                case 1: return relocation_kind{8, false};   //R_X86_64_64
+                case 2: return relocation_kind{4, true};    //R_X86_64_PC32
+                case 10: return relocation_kind{4, false};  //R_X86_64_32
+                case 11: return relocation_kind{4, false};  //R_X86_64_32S
+                case 17: return relocation_kind{8, false};  //R_X86_64_DTPOFF64
+                case 21: return relocation_kind{4, false};  //R_X86_64_DTPOFF32
+                case 24: return relocation_kind{8, true};   //R_X86_64_PC64
+                default: return std::nullopt;
+            }
+        //EM_AARCH64
+        case 183:
+            switch (type) {
+                case 0: return relocation_kind{0, false};     //R_AARCH64_NONE
+                case 257: return relocation_kind{8, false};   //R_AARCH64_ABS64
+                case 258: return relocation_kind{4, false};   //R_AARCH64_ABS32
+                case 259: return relocation_kind{2, false};   //R_AARCH64_ABS16
+                case 260: return relocation_kind{8, true};    //R_AARCH64_PREL64
+                case 261: return relocation_kind{4, true};    //R_AARCH64_PREL32
+                case 1031: return relocation_kind{8, false};  //R_AARCH64_TLS_DTPREL64
+                default: return std::nullopt;
+            }
+        //EM_386
+        case 3:
+            switch (type) {
+                case 0: return relocation_kind{0, false};   //R_386_NONE
+                case 1: return relocation_kind{4, false};   //R_386_32
+                case 2: return relocation_kind{4, true};    //R_386_PC32
+                case 35: return relocation_kind{4, false};  //R_386_TLS_LDO_32
+                default: return std::nullopt;
+            }
+        default:
+            return std::nullopt;
+    }
+}
+
+uint64_t load_field(std::span<const std::byte> field, std::endian endianness) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < field.size(); i++) {
+        size_t shift = endianness == std::endian::little ? i : field.size() - 1 - i;
+        v |= static_cast<uint64_t>(field[i]) << (8 * shift);
+    }
+    return v;
+}
+
+void store_field(std::span<std::byte> field, uint64_t v, std::endian endianness) {
+    for (size_t i = 0; i < field.size(); i++) {
+        size_t shift = endianness == std::endian::little ? i : field.size() - 1 - i;
+        field[i] = static_cast<std::byte>(v >> (8 * shift));
+    }
+}
+
+}
+
+std::vector<relocation> elf::relocations(const section_header& sh) const {
+    if (!sh.is_relocation()) {
+        throw std::runtime_error("expected a SHT_REL or SHT_RELA section, got type: " + to_string(sh.section_type()));
+    }
+    bool rela = sh.section_type() == 4;
+    span_reader r {sh.data(*this)};
+    r.file_offset_size = ident.bitwidth();
+    r.file_endianness = ident.endianness();
+    bool is_64 = r.file_offset_size == sizeof(uint64_t);
+    size_t entry_size = r.file_offset_size * (rela ? 3 : 2);
+
+    std::vector<relocation> entries;
+    entries.reserve(r.data.size() / entry_size);
+    while (r.data.size() >= entry_size) {
+        file_offset_size offset;
+        file_offset_size info;
+        r & offset & info;
+        relocation e {offset, 0, 0, 0};
+        //r_info packs the symbol index above the type, 32/32 bits in ELF64 and 24/8 in ELF32
+        if (is_64) {
+            e.symbol = info >> 32;
+            e.type = info & 0xffffffff;
+        } else {
+            e.symbol = info >> 8;
+            e.type = info & 0xff;
+        }
+        if (rela) {
+            file_offset_size addend;
+            r & addend;
+            e.addend = is_64 ? static_cast<int64_t>(addend.data) : static_cast<int32_t>(addend.data);
+        }
+        entries.push_back(e);
+    }
+    return entries;
+}
+
+std::span<std::byte> elf::relocate(const section_header& sh, std::span<std::byte> contents) const {
+    elf_cache& c = *cache;
+    std::call_once(c.relocations_once, [&]() {
+        for (size_t i = 0; i < header.shnum; i++) {
+            section_header rel = get_section_by_id(i).value();
+            if (!rel.is_relocation()) {
+                continue;
+            }
+            std::optional<section_header> target = get_section_by_id(rel.info_section());
+            if (target && !target->allocated()) {
+                c.relocation_sections[target->file_offset()].push_back(i);
+            }
+        }
+    });
+    auto sections = c.relocation_sections.find(sh.file_offset());
+    if (sections == c.relocation_sections.end()) {
+        return contents;
+    }
+    {
+        std::lock_guard lock{c.relocated_m};
+        auto it = c.relocated.find(sh.file_offset());
+        if (it != c.relocated.end()) {
+            return it->second;
+        }
+    }
+
+    //applied outside the lock, if two threads race for one section the first to insert wins
+    std::vector<std::byte> out(contents.begin(), contents.end());
+    std::endian endianness = ident.endianness();
+    size_t symbol_size = ident.bitwidth() == sizeof(uint64_t) ? 24 : 16;
+    for (size_t index: sections->second) {
+        section_header rel = get_section_by_id(index).value();
+        bool rela = rel.section_type() == 4;
+        std::optional<section_header> symtab = get_section_by_id(rel.linked_section());
+        if (!symtab) {
+            throw std::runtime_error("bad relocation section symbol table index: " + to_string(rel.linked_section()));
+        }
+        std::span<std::byte> symbols = symtab->data(*this);
+        for (const relocation& e: relocations(rel)) {
+            std::optional<relocation_kind> kind = relocation_kind_of(header.machine, e.type);
+            if (!kind) {
+                throw std::runtime_error("unsupported relocation type " + to_string(e.type) + " for machine " + to_string(header.machine));
+            }
+            if (kind->size == 0) {
+                continue;
+            }
+            if (e.offset + kind->size > out.size()) {
+                throw std::runtime_error("relocation offset out of range: " + to_string(e.offset));
+            }
+            if ((e.symbol + 1) * symbol_size > symbols.size()) {
+                throw std::runtime_error("relocation symbol index out of range: " + to_string(e.symbol));
+            }
+            span_reader sr {symbols.subspan(e.symbol * symbol_size)};
+            sr.file_offset_size = ident.bitwidth();
+            sr.file_endianness = endianness;
+            symbol_entry s;
+            sr & s;
+            std::span<std::byte> field {out.data() + e.offset, kind->size};
+            //REL keeps the addend in the field itself
+            uint64_t addend = rela ? e.addend : load_field(field, endianness);
+            //sections sit at address 0 in an object file, so the place is just the offset
+            uint64_t value = s.sym.value + addend - (kind->pc_relative ? sh.address() + e.offset : 0);
+            store_field(field, value, endianness);
+        }
+    }
+    std::lock_guard lock{c.relocated_m};
+    return c.relocated.emplace(sh.file_offset(), std::move(out)).first->second;
+}
+
+void elf::relocate_sections(unsigned threads) const {
+    if (!relocatable()) {
+        return;
+    }
+    std::vector<section_header> targets;
+    for (size_t i = 0; i < header.shnum; i++) {
+        section_header sh = get_section_by_id(i).value();
+        if (sh.section_type() != 8 && !sh.allocated() && !sh.is_relocation()) {
+            targets.push_back(sh);
+        }
+    }
+    //data() does the work, each section's relocations are independent of every other's
+    dwarfy::parallel_for(targets.size(), 1, threads, [&](unsigned worker, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            targets[i].data(*this);
+        }
+    });
+}
+
+std::vector<symbol> elf::symbols(const std::string_view& section) const {
+    std::optional<section_header> sh = get_section_by_name(section);
+    if (!sh) {
+        return {};
+    }
+    std::optional<section_header> strtab = get_section_by_id(sh->linked_section());
+    if (!strtab) {
+        throw std::runtime_error("bad symbol table string table index: " + to_string(sh->linked_section()));
+    }
+    std::span<std::byte> strings = strtab->data(*this);
+    span_reader r {sh->data(*this)};
+    r.file_offset_size = ident.bitwidth();
+    r.file_endianness = ident.endianness();
+    size_t entry_size = r.file_offset_size == sizeof(uint64_t) ? 24 : 16;
+
+    std::vector<symbol> syms;
+    syms.reserve(r.data.size() / entry_size);
+    while (r.data.size() >= entry_size) {
+        symbol_entry e;
+        r & e;
+        if (e.name >= strings.size()) {
+            throw std::runtime_error("bad symbol name offset: " + to_string(e.name));
+        }
+        const char* name = reinterpret_cast<const char*>(strings.data() + e.name);
+        e.sym.name = std::string_view{name, strnlen(name, strings.size() - e.name)};
+        syms.push_back(e.sym);
+    }
+    return syms;
+}
+
+const elf* elf::mini_debug_info() const {
+    elf_cache& index = *cache;
+    std::call_once(index.mini_once, [&]() {
+        std::span<std::byte> compressed = get_section_data_by_name(".gnu_debugdata");
+        if (compressed.empty()) {
+            return;
+        }
+        index.mini_data = decompress_xz(compressed);
+        index.mini = std::make_unique<elf>(std::span<std::byte>{index.mini_data});
+    });
+    return index.mini.get();
+}
+
+std::optional<symbol> elf::find_symbol(uint64_t address) const {
+    elf_cache& index = *cache;
+    std::call_once(index.sorted_once, [&]() {
+        std::vector<symbol> all = symbols(".symtab");
+        if (all.empty()) {
+            all = symbols(".dynsym");
+            if (const elf* mini = mini_debug_info()) {
+                std::vector<symbol> more = mini->symbols(".symtab");
+                all.insert(all.end(), more.begin(), more.end());
+            }
+        }
+        for (const symbol& s: all) {
+            //undefined symbols (shndx 0) have no address in this file
+            if (s.is_function() && s.shndx != 0) {
+                index.sorted.push_back(s);
+            }
+        }
+        std::sort(index.sorted.begin(), index.sorted.end(), [](const symbol& a, const symbol& b) {
+            return a.value < b.value || (a.value == b.value && a.size > b.size);
+        });
+        //aliases share an address, keep the one with the largest size
+        auto last = std::unique(index.sorted.begin(), index.sorted.end(), [](const symbol& a, const symbol& b) {
+            return a.value == b.value;
+        });
+        index.sorted.erase(last, index.sorted.end());
+    });
+
+    auto it = std::upper_bound(index.sorted.begin(), index.sorted.end(), address, [](uint64_t address, const symbol& s) {
+        return address < s.value;
+    });
+    if (it == index.sorted.begin()) {
+        return std::nullopt;
+    }
+    const symbol& s = *std::prev(it);
+    if (address < s.value + std::max<uint64_t>(s.size, 1)) {
+        return s;
+    }
+    return std::nullopt;
 }
 
 }
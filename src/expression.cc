@@ -0,0 +1,687 @@
+#include "expression.hh"
+
+#include <cstring>
+
+namespace dwarfy {
+
+using std::to_string;
+
+namespace {
+
+struct expression_stack {
+    static constexpr size_t capacity = 64;
+    std::array<uint64_t, capacity> values;
+    size_t size = 0;
+
+    void push(uint64_t v) {
+        if (size == capacity) {
+            throw std::runtime_error("DWARF expression stack overflow");
+        }
+        values[size++] = v;
+    }
+    uint64_t pop() {
+        if (size == 0) {
+            throw std::runtime_error("DWARF expression stack underflow");
+        }
+        return values[--size];
+    }
+    uint64_t& top(size_t i = 0) {
+        if (i >= size) {
+            throw std::runtime_error("DWARF expression stack underflow");
+        }
+        return values[size - 1 - i];
+    }
+};
+
+uint64_t read_register(const expression_context& c, uint64_t reg) {
+    std::optional<uint64_t> v;
+    if (c.read_register) {
+        v = c.read_register(reg);
+    }
+    if (!v) {
+        throw std::runtime_error("DWARF expression needs unavailable register: " + to_string(reg));
+    }
+    return v.value();
+}
+
+uint64_t read_memory(const expression_context& c, uint64_t address, size_t size) {
+    std::optional<uint64_t> v;
+    if (c.read_memory) {
+        v = c.read_memory(address, size);
+    }
+    if (!v) {
+        throw std::runtime_error("DWARF expression needs unavailable memory at: " + to_string(address));
+    }
+    return v.value();
+}
+
+uint64_t read_address_index(const expression_context& c, uint64_t index) {
+    std::optional<uint64_t> v;
+    if (c.read_address_index) {
+        v = c.read_address_index(index);
+    }
+    if (!v) {
+        throw std::runtime_error("DWARF expression needs unavailable .debug_addr index: " + to_string(index));
+    }
+    return v.value();
+}
+
+uint64_t truncate(uint64_t v, size_t address_size) {
+    if (address_size < 8) {
+        v &= (1ULL << (address_size * 8)) - 1;
+    }
+    return v;
+}
+
+span_reader expression_reader(std::span<std::byte> expression, size_t address_size, std::endian endianness, size_t offset_size = 4) {
+    span_reader r {expression};
+    r.file_endianness = endianness;
+    r.machine_address_size = address_size;
+    r.file_offset_size = offset_size;
+    return r;
+}
+
+uint64_t read_unsigned(span_reader& r) {
+    uleb128 v;
+    r & v;
+    return v;
+}
+
+int64_t read_signed(span_reader& r) {
+    sleb128 v;
+    r & v;
+    return static_cast<int64_t>(v.data);
+}
+
+}
+
+location evaluate_expression(std::span<std::byte> expression, const expression_context& context) {
+    span_reader r = expression_reader(expression, context.address_size, context.endianness, context.offset_size);
+    expression_stack stack;
+    location result;
+
+    //the simple location description being built, finished by a piece or the end of the expression
+    location_piece current;
+    bool has_current = false;
+    if (context.initial_value) {
+        stack.push(*context.initial_value);
+    }
+
+    auto finish = [&](uint64_t size_bits, uint64_t bit_offset) {
+        location_piece p = current;
+        if (!has_current) {
+            if (stack.size > 0) {
+                p.kind = location_kind::memory;
+                p.value = truncate(stack.top(), context.address_size);
+            } else {
+                p.kind = location_kind::empty;
+            }
+        }
+        p.size_bits = size_bits;
+        p.bit_offset = bit_offset;
+        result.push(p);
+        current = {};
+        has_current = false;
+        stack.size = 0;
+    };
+    auto jump = [&](int16_t delta) {
+        ptrdiff_t position = r.data.data() - expression.data() + delta;
+        if (position < 0 || static_cast<size_t>(position) > expression.size()) {
+            throw std::runtime_error("DWARF expression branch out of range");
+        }
+        r.data = expression.subspan(position);
+    };
+
+    while (!r.data.empty()) {
+        uint8_t raw;
+        r & raw;
+        dw_op op = static_cast<dw_op>(raw);
+        if (has_current && op != dw_op::piece && op != dw_op::bit_piece) {
+            throw std::runtime_error("DWARF expression has operations after a register, implicit or stack value location");
+        }
+        if (raw >= static_cast<uint8_t>(dw_op::lit0) && raw <= static_cast<uint8_t>(dw_op::lit31)) {
+            stack.push(raw - static_cast<uint8_t>(dw_op::lit0));
+            continue;
+        }
+        if (raw >= static_cast<uint8_t>(dw_op::reg0) && raw <= static_cast<uint8_t>(dw_op::reg31)) {
+            current.kind = location_kind::register_;
+            current.reg = raw - static_cast<uint8_t>(dw_op::reg0);
+            has_current = true;
+            continue;
+        }
+        if (raw >= static_cast<uint8_t>(dw_op::breg0) && raw <= static_cast<uint8_t>(dw_op::breg31)) {
+            int64_t offset = read_signed(r);
+            stack.push(read_register(context, raw - static_cast<uint8_t>(dw_op::breg0)) + offset);
+            continue;
+        }
+        switch (op) {
+            case dw_op::addr:
+                {
+                    machine_address_size a;
+                    r & a;
+                    stack.push(a);
+                    break;
+                }
+            case dw_op::deref:
+                stack.push(read_memory(context, stack.pop(), context.address_size));
+                break;
+            case dw_op::const1u:
+                {
+                    uint8_t v;
+                    r & v;
+                    stack.push(v);
+                    break;
+                }
+            case dw_op::const1s:
+                {
+                    int8_t v;
+                    r & v;
+                    stack.push(static_cast<int64_t>(v));
+                    break;
+                }
+            case dw_op::const2u:
+                {
+                    uint16_t v;
+                    r & v;
+                    stack.push(v);
+                    break;
+                }
+            case dw_op::const2s:
+                {
+                    int16_t v;
+                    r & v;
+                    stack.push(static_cast<int64_t>(v));
+                    break;
+                }
+            case dw_op::const4u:
+                {
+                    uint32_t v;
+                    r & v;
+                    stack.push(v);
+                    break;
+                }
+            case dw_op::const4s:
+                {
+                    int32_t v;
+                    r & v;
+                    stack.push(static_cast<int64_t>(v));
+                    break;
+                }
+            case dw_op::const8u:
+                {
+                    uint64_t v;
+                    r & v;
+                    stack.push(v);
+                    break;
+                }
+            case dw_op::const8s:
+                {
+                    int64_t v;
+                    r & v;
+                    stack.push(v);
+                    break;
+                }
+            case dw_op::constu:
+                stack.push(read_unsigned(r));
+                break;
+            case dw_op::consts:
+                stack.push(read_signed(r));
+                break;
+            case dw_op::dup:
+                stack.push(stack.top());
+                break;
+            case dw_op::drop:
+                stack.pop();
+                break;
+            case dw_op::over:
+                stack.push(stack.top(1));
+                break;
+            case dw_op::pick:
+                {
+                    uint8_t i;
+                    r & i;
+                    stack.push(stack.top(i));
+                    break;
+                }
+            case dw_op::swap:
+                std::swap(stack.top(0), stack.top(1));
+                break;
+            case dw_op::rot:
+                {
+                    uint64_t a = stack.top(0);
+                    stack.top(0) = stack.top(1);
+                    stack.top(1) = stack.top(2);
+                    stack.top(2) = a;
+                    break;
+                }
+            case dw_op::xderef:
+                {
+                    uint64_t address = stack.pop();
+                    stack.pop();
+                    stack.push(read_memory(context, address, context.address_size));
+                    break;
+                }
+            case dw_op::abs:
+                {
+                    int64_t v = stack.pop();
+                    stack.push(v < 0 ? -v : v);
+                    break;
+                }
+            case dw_op::and_:
+                {
+                    uint64_t b = stack.pop();
+                    stack.top() &= b;
+                    break;
+                }
+            case dw_op::div:
+                {
+                    int64_t b = stack.pop();
+                    int64_t a = stack.pop();
+                    if (b == 0) {
+                        throw std::runtime_error("DWARF expression divides by zero");
+                    }
+                    //a / -1 is -a, negated unsigned so INT64_MIN wraps to itself rather than trapping on x86-64
+                    stack.push(b == -1 ? static_cast<int64_t>(0 - static_cast<uint64_t>(a)) : a / b);
+                    break;
+                }
+            case dw_op::minus:
+                {
+                    uint64_t b = stack.pop();
+                    stack.top() -= b;
+                    break;
+                }
+            case dw_op::mod:
+                {
+                    uint64_t b = stack.pop();
+                    if (b == 0) {
+                        throw std::runtime_error("DWARF expression divides by zero");
+                    }
+                    stack.top() %= b;
+                    break;
+                }
+            case dw_op::mul:
+                {
+                    uint64_t b = stack.pop();
+                    stack.top() *= b;
+                    break;
+                }
+            case dw_op::neg:
+                stack.top() = -stack.top();
+                break;
+            case dw_op::not_:
+                stack.top() = ~stack.top();
+                break;
+            case dw_op::or_:
+                {
+                    uint64_t b = stack.pop();
+                    stack.top() |= b;
+                    break;
+                }
+            case dw_op::plus:
+                {
+                    uint64_t b = stack.pop();
+                    stack.top() += b;
+                    break;
+                }
+            case dw_op::plus_uconst:
+                stack.top() += read_unsigned(r);
+                break;
+            case dw_op::shl:
+                {
+                    uint64_t b = stack.pop();
+                    stack.top() = b >= 64 ? 0 : stack.top() << b;
+                    break;
+                }
+            case dw_op::shr:
+                {
+                    uint64_t b = stack.pop();
+                    stack.top() = b >= 64 ? 0 : stack.top() >> b;
+                    break;
+                }
+            case dw_op::shra:
+                {
+                    uint64_t b = stack.pop();
+                    int64_t a = stack.pop();
+                    stack.push(a >> std::min<uint64_t>(b, 63));
+                    break;
+                }
+            case dw_op::xor_:
+                {
+                    uint64_t b = stack.pop();
+                    stack.top() ^= b;
+                    break;
+                }
+            case dw_op::bra:
+                {
+                    int16_t delta;
+                    r & delta;
+                    if (stack.pop() != 0) {
+                        jump(delta);
+                    }
+                    break;
+                }
+            case dw_op::eq:
+            case dw_op::ge:
+            case dw_op::gt:
+            case dw_op::le:
+            case dw_op::lt:
+            case dw_op::ne:
+                {
+                    int64_t b = stack.pop();
+                    int64_t a = stack.pop();
+                    bool v = op == dw_op::eq ? a == b :
+                        op == dw_op::ge ? a >= b :
+                        op == dw_op::gt ? a > b :
+                        op == dw_op::le ? a <= b :
+                        op == dw_op::lt ? a < b :
+                        a != b;
+                    stack.push(v);
+                    break;
+                }
+            case dw_op::skip:
+                {
+                    int16_t delta;
+                    r & delta;
+                    jump(delta);
+                    break;
+                }
+            case dw_op::regx:
+                current.kind = location_kind::register_;
+                current.reg = read_unsigned(r);
+                has_current = true;
+                break;
+            case dw_op::fbreg:
+                stack.push(context.frame_base + read_signed(r));
+                break;
+            case dw_op::bregx:
+                {
+                    uint64_t reg = read_unsigned(r);
+                    int64_t offset = read_signed(r);
+                    stack.push(read_register(context, reg) + offset);
+                    break;
+                }
+            case dw_op::piece:
+                finish(read_unsigned(r) * 8, 0);
+                break;
+            case dw_op::bit_piece:
+                {
+                    uint64_t size = read_unsigned(r);
+                    uint64_t offset = read_unsigned(r);
+                    finish(size, offset);
+                    break;
+                }
+            case dw_op::deref_size:
+            case dw_op::xderef_size:
+                {
+                    uint8_t size;
+                    r & size;
+                    uint64_t address = stack.pop();
+                    if (op == dw_op::xderef_size) {
+                        stack.pop();
+                    }
+                    stack.push(read_memory(context, address, size));
+                    break;
+                }
+            case dw_op::nop:
+                break;
+            case dw_op::push_object_address:
+                stack.push(context.object_address);
+                break;
+            case dw_op::form_tls_address:
+            case dw_op::GNU_push_tls_address:
+                {
+                    uint64_t offset = stack.pop();
+                    std::optional<uint64_t> v;
+                    if (context.tls_address) {
+                        v = context.tls_address(offset);
+                    }
+                    if (!v) {
+                        throw std::runtime_error("DWARF expression needs an unavailable thread local address");
+                    }
+                    stack.push(v.value());
+                    break;
+                }
+            case dw_op::call_frame_cfa:
+                stack.push(context.cfa);
+                break;
+            case dw_op::implicit_value:
+                {
+                    uint64_t size = read_unsigned(r);
+                    current.kind = location_kind::implicit_value;
+                    current.bytes = r.read_bytes(size);
+                    has_current = true;
+                    break;
+                }
+            case dw_op::stack_value:
+                current.kind = location_kind::value;
+                current.value = stack.top();
+                has_current = true;
+                break;
+            case dw_op::implicit_pointer:
+                {
+                    //offset sized, 8 bytes in 64-bit DWARF units
+                    file_offset_size die;
+                    r & die;
+                    current.kind = location_kind::implicit_pointer;
+                    current.value = die;
+                    current.offset = read_signed(r);
+                    has_current = true;
+                    break;
+                }
+            case dw_op::addrx:
+            case dw_op::constx:
+            case dw_op::GNU_addr_index:
+            case dw_op::GNU_const_index:
+                stack.push(read_address_index(context, read_unsigned(r)));
+                break;
+            case dw_op::const_type:
+                {
+                    read_unsigned(r);
+                    uint8_t size;
+                    r & size;
+                    auto bytes = r.read_bytes(size);
+                    uint64_t v = 0;
+                    std::memcpy(&v, bytes.data(), std::min<size_t>(size, sizeof(v)));
+                    stack.push(v);
+                    break;
+                }
+            case dw_op::regval_type:
+                {
+                    uint64_t reg = read_unsigned(r);
+                    read_unsigned(r);
+                    stack.push(read_register(context, reg));
+                    break;
+                }
+            case dw_op::deref_type:
+            case dw_op::xderef_type:
+                {
+                    uint8_t size;
+                    r & size;
+                    read_unsigned(r);
+                    uint64_t address = stack.pop();
+                    if (op == dw_op::xderef_type) {
+                        stack.pop();
+                    }
+                    stack.push(read_memory(context, address, size));
+                    break;
+                }
+            case dw_op::convert:
+            case dw_op::reinterpret:
+                //XXX typed stack entries are treated as the generic type
+                read_unsigned(r);
+                break;
+            case dw_op::GNU_uninit:
+                break;
+            default:
+                //call2/call4/call_ref and entry_value need the DIE tree and the caller's frame
+                throw std::runtime_error("unsupported DW_OP in DWARF expression: " + to_string(raw));
+        }
+    }
+    if (result.size() == 0) {
+        finish(0, 0);
+    } else if (has_current || stack.size > 0) {
+        throw std::runtime_error("DWARF expression has a trailing location after its last piece");
+    }
+    return result;
+}
+
+namespace {
+
+//decodes one simple location op and an optional DW_OP_stack_value, false if the op isn't one we compile
+bool compile_piece(span_reader& r, compiled_expression::piece& p) {
+    using kind = compiled_expression::kind;
+    if (r.data.empty()) {
+        return false;
+    }
+    uint8_t raw;
+    r & raw;
+    dw_op op = static_cast<dw_op>(raw);
+    if (raw >= static_cast<uint8_t>(dw_op::reg0) && raw <= static_cast<uint8_t>(dw_op::reg31)) {
+        p.k = kind::reg;
+        p.reg = raw - static_cast<uint8_t>(dw_op::reg0);
+        return true;
+    } else if (raw >= static_cast<uint8_t>(dw_op::breg0) && raw <= static_cast<uint8_t>(dw_op::breg31)) {
+        p.k = kind::breg;
+        p.reg = raw - static_cast<uint8_t>(dw_op::breg0);
+        p.offset = read_signed(r);
+    } else if (op == dw_op::regx) {
+        p.k = kind::reg;
+        p.reg = read_unsigned(r);
+        return true;
+    } else if (op == dw_op::bregx) {
+        p.k = kind::breg;
+        p.reg = read_unsigned(r);
+        p.offset = read_signed(r);
+    } else if (op == dw_op::fbreg) {
+        p.k = kind::fbreg;
+        p.offset = read_signed(r);
+    } else if (op == dw_op::addr) {
+        machine_address_size a;
+        r & a;
+        p.k = kind::addr;
+        p.offset = a;
+    } else if (op == dw_op::call_frame_cfa) {
+        p.k = kind::cfa;
+    } else {
+        return false;
+    }
+    if (!r.data.empty() && static_cast<dw_op>(r.data.front()) == dw_op::stack_value) {
+        r.read_bytes(1);
+        p.stack_value = true;
+    }
+    return true;
+}
+
+}
+
+compiled_expression compile_expression(std::span<std::byte> expression, size_t address_size, std::endian endianness) {
+    using kind = compiled_expression::kind;
+    compiled_expression c;
+    c.bytecode = expression;
+    if (expression.empty()) {
+        return c;
+    }
+    span_reader r = expression_reader(expression, address_size, endianness);
+    try {
+        compiled_expression::piece first;
+        if (compile_piece(r, first) && r.data.empty()) {
+            c.k = first.k;
+            c.piece_count = 1;
+            c.pieces[0] = first;
+            return c;
+        }
+
+        r.data = expression;
+        c.k = kind::pieces;
+        while (!r.data.empty()) {
+            if (c.piece_count == compiled_expression::max_pieces) {
+                c.k = kind::interpreted;
+                break;
+            }
+            compiled_expression::piece p;
+            if (static_cast<dw_op>(r.data.front()) != dw_op::piece) {
+                if (!compile_piece(r, p)) {
+                    c.k = kind::interpreted;
+                    break;
+                }
+            }
+            uint8_t op;
+            r & op;
+            if (static_cast<dw_op>(op) != dw_op::piece) {
+                c.k = kind::interpreted;
+                break;
+            }
+            p.size_bytes = read_unsigned(r);
+            c.pieces[c.piece_count++] = p;
+        }
+    } catch (std::exception&) {
+        //leave malformed expressions for the interpreter to report properly
+        c.k = kind::interpreted;
+    }
+    if (c.k == kind::interpreted) {
+        c.piece_count = 0;
+    }
+    return c;
+}
+
+namespace {
+
+location_piece evaluate_piece(const compiled_expression::piece& p, const expression_context& context) {
+    using kind = compiled_expression::kind;
+    location_piece l;
+    switch (p.k) {
+        case kind::empty:
+            return l;
+        case kind::reg:
+            l.kind = location_kind::register_;
+            l.reg = p.reg;
+            return l;
+        case kind::addr:
+            l.value = p.offset;
+            break;
+        case kind::fbreg:
+            l.value = context.frame_base + p.offset;
+            break;
+        case kind::breg:
+            l.value = read_register(context, p.reg) + p.offset;
+            break;
+        case kind::cfa:
+            l.value = context.cfa;
+            break;
+        default:
+            throw std::runtime_error("bad compiled DWARF expression piece");
+    }
+    l.kind = p.stack_value ? location_kind::value : location_kind::memory;
+    l.value = truncate(l.value, context.address_size);
+    return l;
+}
+
+}
+
+location evaluate_expression(const compiled_expression& expression, const expression_context& context) {
+    using kind = compiled_expression::kind;
+    location result;
+    if (context.initial_value && (expression.k == kind::empty || expression.k == kind::pieces)) {
+        //the only shapes where a value already on the stack can end up in the result
+        return evaluate_expression(expression.bytecode, context);
+    }
+    switch (expression.k) {
+        case kind::interpreted:
+            return evaluate_expression(expression.bytecode, context);
+        case kind::empty:
+            result.push({});
+            return result;
+        case kind::pieces:
+            for (size_t i = 0; i < expression.piece_count; i++) {
+                location_piece l = evaluate_piece(expression.pieces[i], context);
+                l.size_bits = expression.pieces[i].size_bytes * 8;
+                result.push(l);
+            }
+            return result;
+        default:
+            result.push(evaluate_piece(expression.pieces[0], context));
+            return result;
+    }
+}
+
+}
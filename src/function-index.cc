@@ -0,0 +1,205 @@
+#include "function-index.hh"
+#include "die-view.hh"
+
+#include <algorithm>
+
+namespace dwarfy {
+
+using std::to_string;
+
+namespace {
+
+bool is_address_form(dw_form form) {
+    switch (form) {
+        case dw_form::addr:
+        case dw_form::addrx:
+        case dw_form::addrx1:
+        case dw_form::addrx2:
+        case dw_form::addrx3:
+        case dw_form::addrx4:
+        case dw_form::GNU_addr_index:
+            return true;
+        default:
+            return false;
+    }
+}
+
+//the name of the DIE at a .debug_info offset, like unit_walker::name for a DIE in some other unit
+std::string_view name_at(const dwarf& d, uint64_t offset, int depth) {
+    unit_die die = d.die_at(offset);
+    std::string_view name;
+    std::optional<uint64_t> origin;
+    for (const attribute& a: die.attributes) {
+        if (a.name == dw_at::linkage_name || a.name == dw_at::MIPS_linkage_name) {
+            return d.read_string(a, die.cu.context);
+        } else if (a.name == dw_at::name) {
+            name = d.read_string(a, die.cu.context);
+        } else if (a.name == dw_at::specification || a.name == dw_at::abstract_origin) {
+            origin = d.reference_target(a, die.unit_offset);
+        }
+    }
+    if (name.empty() && origin && depth < 4) {
+        return name_at(d, *origin, depth + 1);
+    }
+    return name;
+}
+
+struct unit_walker {
+    const dwarf& d;
+    compilation_unit_header cu;
+    std::span<std::byte> unit;
+    unit_context context;
+    list_context ctx;
+
+    //reads the DIE at r, false for a null entry
+    bool read_die(span_reader& r, dw_tag& tag, std::vector<attribute>& attributes) {
+        attributes.clear();
+        debugging_information_entry die;
+        r & die;
+        if (die.is_last()) {
+            return false;
+        }
+        //through the dwarf's shared abbreviation tables, cu keeps its own table after the first lookup
+        span_reader ar {d.debug_abbrev.subspan(d.find_abbrev(die.abbrev_code, cu))};
+        ar.file_endianness = d.initial_endianness;
+        debug_abbrev_entry dae;
+        ar & dae;
+        tag = dae.tag;
+        while (true) {
+            attribute a;
+            read(r, ar, a);
+            if (a.is_last()) {
+                break;
+            }
+            attributes.push_back(a);
+        }
+        return true;
+    }
+
+    span_reader reader_at(uint64_t unit_relative_offset) {
+        if (unit_relative_offset >= unit.size()) {
+            throw std::runtime_error("DIE reference out of range: " + to_string(unit_relative_offset));
+        }
+        return context.reader(unit.subspan(unit_relative_offset));
+    }
+
+    uint64_t address(const attribute& a) {
+        uint64_t v = a.unsigned_value(d.initial_endianness);
+        if (a.form == dw_form::addr) {
+            return v;
+        }
+        return indexed_address(ctx, v);
+    }
+
+    //the name of a subprogram, following DW_AT_specification and DW_AT_abstract_origin, within the unit
+    //through its own abbreviations and into other units (LTO output is full of those) through die_at
+    std::string_view name(const std::vector<attribute>& attributes, int depth = 0) {
+        std::string_view name;
+        std::optional<uint64_t> origin;
+        std::optional<uint64_t> cross_unit_origin;
+        for (const attribute& a: attributes) {
+            if (a.name == dw_at::linkage_name || a.name == dw_at::MIPS_linkage_name) {
+                return d.read_string(a, context);
+            } else if (a.name == dw_at::name) {
+                name = d.read_string(a, context);
+            } else if (a.name == dw_at::specification || a.name == dw_at::abstract_origin) {
+                if (a.form == dw_form::ref_addr) {
+                    cross_unit_origin = d.reference_target(a, 0);
+                } else if (a.form != dw_form::ref_sig8) {
+                    origin = a.unsigned_value(d.initial_endianness);
+                }
+            }
+        }
+        if (!name.empty() || depth >= 4) {
+            return name;
+        }
+        if (origin) {
+            span_reader r = reader_at(*origin);
+            dw_tag tag;
+            std::vector<attribute> origin_attributes;
+            if (read_die(r, tag, origin_attributes)) {
+                return this->name(origin_attributes, depth + 1);
+            }
+        } else if (cross_unit_origin) {
+            return name_at(d, *cross_unit_origin, depth + 1);
+        }
+        return name;
+    }
+};
+
+}
+
+function_index::function_index(const dwarf& d) {
+    for (auto cu_it = d.cu_iter(); cu_it != cu_it.end(); ++cu_it) {
+        unit_walker w {d, *cu_it, {}, {}, {}};
+        //split_compile for a split_dwarf's halves, whose skeletons have no subprograms
+        if (w.cu.version >= 5 && w.cu.unit_type != dw_ut::compile && w.cu.unit_type != dw_ut::partial && w.cu.unit_type != dw_ut::split_compile) {
+            continue;
+        }
+        span_reader r = cu_it.die_reader();
+        std::span<std::byte> unit_start = r.data;
+        //the reader starts after the unit header, but unit relative offsets count from the unit_length field
+        size_t header_size = w.cu.unit_length.size() + 2 + (w.cu.version >= 5 ? 2 : 1) + w.cu.context.offset_size;
+        if (w.cu.version >= 5 && (w.cu.unit_type == dw_ut::skeleton || w.cu.unit_type == dw_ut::split_compile)) {
+            header_size += sizeof(uint64_t);
+        }
+        std::span<std::byte> unit {unit_start.data() - header_size, w.cu.unit_length + w.cu.unit_length.size()};
+        w.unit = unit;
+        w.context = w.cu.context;
+        w.ctx = d.unit_list_context(cu_it);
+
+        std::vector<attribute> attributes;
+        dw_tag tag;
+        span_reader dr = w.reader_at(header_size);
+        if (w.read_die(dr, tag, attributes)) {
+            w.context.read_bases(attributes);
+        }
+        auto subprogram = projection<dw_at::low_pc, dw_at::high_pc, dw_at::ranges, dw_at::name, dw_at::linkage_name,
+            dw_at::MIPS_linkage_name, dw_at::specification, dw_at::abstract_origin>;
+        visit<dw_tag::subprogram>(cu_it, subprogram, [&](const auto& die) {
+            const attribute* low_pc = die.template get<dw_at::low_pc>();
+            const attribute* high_pc = die.template get<dw_at::high_pc>();
+            const attribute* ranges = die.template get<dw_at::ranges>();
+            if (!(low_pc && high_pc) && !ranges) {
+                //declarations and inlined-only abstract instances have no code
+                return;
+            }
+            attributes.clear();
+            for (const attribute& a: die.attributes) {
+                if (a.form != static_cast<dw_form>(0)) {
+                    attributes.push_back(a);
+                }
+            }
+            std::string_view name = w.name(attributes);
+            if (low_pc && high_pc) {
+                uint64_t low = w.address(*low_pc);
+                //DWARF 4 and later encode high_pc as a length from low_pc unless it has an address form
+                uint64_t high = is_address_form(high_pc->form) ? w.address(*high_pc) : low + high_pc->unsigned_value(d.initial_endianness);
+                if (low < high) {
+                    functions.push_back({low, high, name});
+                }
+            } else {
+                for (const address_range& range: d.ranges(*ranges, w.ctx)) {
+                    if (range.begin < range.end) {
+                        functions.push_back({range.begin, range.end, name});
+                    }
+                }
+            }
+        });
+    }
+    std::sort(functions.begin(), functions.end(), [](const function_range& a, const function_range& b) {
+        return a.begin < b.begin;
+    });
+}
+
+const function_range* function_index::find(uint64_t pc) const {
+    auto it = std::upper_bound(functions.begin(), functions.end(), pc, [](uint64_t pc, const function_range& f) {
+        return pc < f.begin;
+    });
+    if (it == functions.begin() || pc >= std::prev(it)->end) {
+        return nullptr;
+    }
+    return &*std::prev(it);
+}
+
+}
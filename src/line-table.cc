@@ -0,0 +1,350 @@
+#include "line-table.hh"
+
+#include <algorithm>
+
+namespace dwarfy {
+
+using std::to_string;
+
+namespace {
+
+struct line_program_header {
+    uint8_t minimum_instruction_length;
+    uint8_t maximum_operations_per_instruction = 1;
+    bool default_is_stmt;
+    int8_t line_base;
+    uint8_t line_range;
+    uint8_t opcode_base;
+    std::vector<uint8_t> standard_opcode_lengths;
+};
+
+struct entry_format {
+    dw_lnct type;
+    dw_form form;
+};
+
+std::vector<entry_format> read_entry_formats(span_reader& r) {
+    uint8_t count;
+    r & count;
+    std::vector<entry_format> formats(count);
+    for (entry_format& f: formats) {
+        uleb128 type;
+        r & type & f.form;
+        f.type = static_cast<dw_lnct>(type.data);
+    }
+    return formats;
+}
+
+}
+
+line_table::line_table(const dwarf& d, uint64_t offset, uint8_t address_size, std::string_view comp_dir) {
+    scoped_phase timer{d.stats, phase::line_program};
+    if (offset >= d.debug_line.size()) {
+        throw std::runtime_error("line table offset out of range: " + to_string(offset));
+    }
+    span_reader r {d.debug_line.subspan(offset)};
+    r.file_endianness = d.initial_endianness;
+    r.machine_address_size = address_size;
+    initial_length length;
+    r & length;
+    std::span<std::byte> unit = d.debug_line.subspan(offset, length + length.size());
+    r.data = unit.subspan(length.size());
+    r.file_offset_size = length.offset_size();
+    d.stats.section_read(stats_section::line, unit.size());
+
+    r & version;
+    if (version < 2 || version > 5) {
+        throw std::runtime_error("unsupported line table version, expected 2 <= version <= 5, got: " + to_string(version));
+    }
+    if (version >= 5) {
+        uint8_t segment_selector_size;
+        r & address_size & segment_selector_size;
+        r.machine_address_size = address_size;
+    }
+    file_offset_size header_length;
+    r & header_length;
+    std::span<std::byte> program = r.data.subspan(header_length);
+
+    line_program_header h;
+    uint8_t default_is_stmt;
+    r & h.minimum_instruction_length;
+    if (version >= 4) {
+        r & h.maximum_operations_per_instruction;
+    }
+    r & default_is_stmt & h.line_base & h.line_range & h.opcode_base;
+    h.default_is_stmt = default_is_stmt;
+    if (h.line_range == 0) {
+        throw std::runtime_error("bad line table, line_range is 0");
+    }
+    h.standard_opcode_lengths.resize(h.opcode_base);
+    for (size_t i = 1; i < h.opcode_base; i++) {
+        r & h.standard_opcode_lengths[i];
+    }
+
+    if (version >= 5) {
+        //entry forms are strp and line_strp in practice, the strx family would need the unit's base
+        unit_context strings;
+        strings.version = version;
+        strings.offset_size = length.offset_size();
+        strings.endianness = d.initial_endianness;
+        auto read_entries = [&](auto add) {
+            std::vector<entry_format> formats = read_entry_formats(r);
+            uleb128 count;
+            r & count;
+            for (uint64_t i = 0; i < count; i++) {
+                line_file f {{}, 0};
+                for (const entry_format& format: formats) {
+                    attribute a {dw_at::name, format.form, read_form(r, format.form)};
+                    if (format.type == dw_lnct::path) {
+                        f.name = d.read_string(a, strings);
+                    } else if (format.type == dw_lnct::directory_index) {
+                        f.directory = a.unsigned_value(d.initial_endianness);
+                    }
+                }
+                add(f);
+            }
+        };
+        read_entries([&](const line_file& f) {
+            directories.push_back(f.name);
+        });
+        read_entries([&](const line_file& f) {
+            files.push_back(f);
+        });
+    } else {
+        directories.push_back(comp_dir);
+        while (true) {
+            std::string_view dir = reinterpret_cast<const char*>(r.data.data());
+            r.read_bytes(dir.size() + 1);
+            if (dir.empty()) {
+                break;
+            }
+            directories.push_back(dir);
+        }
+        files.push_back({{}, 0});
+        while (true) {
+            std::string_view name = reinterpret_cast<const char*>(r.data.data());
+            r.read_bytes(name.size() + 1);
+            if (name.empty()) {
+                break;
+            }
+            uleb128 dir;
+            uleb128 mtime;
+            uleb128 size;
+            r & dir & mtime & size;
+            files.push_back({name, dir});
+        }
+    }
+
+    r.data = program.first(unit.data() + unit.size() - program.data());
+    std::vector<std::vector<line_row>> sequences(1);
+    line_row state;
+    auto reset = [&]() {
+        state = {0, 1, 1, 0, h.default_is_stmt, false};
+    };
+    reset();
+    auto advance = [&](uint64_t operation_advance) {
+        //op_index only matters for VLIW targets, which dwarfy doesn't support
+        state.address += h.minimum_instruction_length * operation_advance;
+    };
+    auto emit = [&]() {
+        sequences.back().push_back(state);
+    };
+    while (!r.data.empty()) {
+        uint8_t opcode;
+        r & opcode;
+        if (opcode >= h.opcode_base) {
+            uint8_t adjusted = opcode - h.opcode_base;
+            advance(adjusted / h.line_range);
+            state.line += h.line_base + adjusted % h.line_range;
+            emit();
+            continue;
+        }
+        if (opcode == 0) {
+            uleb128 length;
+            r & length;
+            if (length == 0) {
+                continue;
+            }
+            std::span<std::byte> args = r.read_bytes(length);
+            span_reader er {args};
+            er.file_endianness = r.file_endianness;
+            er.machine_address_size = r.machine_address_size;
+            uint8_t extended;
+            er & extended;
+            switch (static_cast<dw_lne>(extended)) {
+                case dw_lne::end_sequence:
+                    state.end_sequence = true;
+                    emit();
+                    sequences.emplace_back();
+                    reset();
+                    break;
+                case dw_lne::set_address:
+                    {
+                        machine_address_size address;
+                        er & address;
+                        state.address = address;
+                    }
+                    break;
+                default:
+                    //define_file, set_discriminator and vendor extensions don't affect rows
+                    break;
+            }
+            continue;
+        }
+        switch (static_cast<dw_lns>(opcode)) {
+            case dw_lns::copy:
+                emit();
+                break;
+            case dw_lns::advance_pc:
+                {
+                    uleb128 v;
+                    r & v;
+                    advance(v);
+                }
+                break;
+            case dw_lns::advance_line:
+                {
+                    sleb128 v;
+                    r & v;
+                    state.line += static_cast<int64_t>(v.data);
+                }
+                break;
+            case dw_lns::set_file:
+                {
+                    uleb128 v;
+                    r & v;
+                    state.file = v;
+                }
+                break;
+            case dw_lns::set_column:
+                {
+                    uleb128 v;
+                    r & v;
+                    state.column = v;
+                }
+                break;
+            case dw_lns::negate_stmt:
+                state.is_stmt = !state.is_stmt;
+                break;
+            case dw_lns::const_add_pc:
+                advance((255 - h.opcode_base) / h.line_range);
+                break;
+            case dw_lns::fixed_advance_pc:
+                {
+                    uint16_t v;
+                    r & v;
+                    state.address += v;
+                }
+                break;
+            default:
+                //set_basic_block, prologue/epilogue markers, set_isa and unknown opcodes: skip the operands
+                for (size_t i = 0; i < h.standard_opcode_lengths[opcode]; i++) {
+                    uleb128 v;
+                    r & v;
+                }
+                break;
+        }
+    }
+
+    //sequences removed by the linker (e.g. discarded COMDAT functions) start at address 0
+    std::erase_if(sequences, [](const std::vector<line_row>& s) {
+        return s.size() < 2 || s.front().address == 0;
+    });
+    std::sort(sequences.begin(), sequences.end(), [](const auto& a, const auto& b) {
+        return a.front().address < b.front().address;
+    });
+    for (const std::vector<line_row>& s: sequences) {
+        rows.insert(rows.end(), s.begin(), s.end());
+    }
+}
+
+const line_row* line_table::find(uint64_t pc) const {
+    auto it = std::upper_bound(rows.begin(), rows.end(), pc, [](uint64_t pc, const line_row& row) {
+        return pc < row.address;
+    });
+    if (it == rows.begin()) {
+        return nullptr;
+    }
+    const line_row* row = &*std::prev(it);
+    if (row->end_sequence) {
+        return nullptr;
+    }
+    return row;
+}
+
+std::string line_table::file_name(uint32_t file) const {
+    if (file >= files.size()) {
+        return {};
+    }
+    const line_file& f = files[file];
+    if (f.name.starts_with("/") || f.directory >= directories.size() || directories[f.directory].empty()) {
+        return std::string{f.name};
+    }
+    std::string_view dir = directories[f.directory];
+    if (!dir.starts_with("/") && f.directory != 0 && !directories[0].empty()) {
+        return std::string{directories[0]} + "/" + std::string{dir} + "/" + std::string{f.name};
+    }
+    return std::string{dir} + "/" + std::string{f.name};
+}
+
+std::optional<line_table> read_line_table(const dwarf& d, uint64_t cu_offset) {
+    span_reader r {d.debug_info.subspan(cu_offset)};
+    r.file_endianness = d.initial_endianness;
+    compilation_unit_header cu;
+    r & cu;
+    debug_abbrev_entry dae;
+    std::vector<attribute> attributes = d.read_attributes(r, cu, dae);
+    unit_context unit = cu.context;
+    unit.read_bases(attributes);
+    std::optional<uint64_t> stmt_list;
+    std::string_view comp_dir;
+    for (const attribute& a: attributes) {
+        if (a.name == dw_at::stmt_list) {
+            stmt_list = a.unsigned_value(d.initial_endianness);
+        } else if (a.name == dw_at::comp_dir) {
+            comp_dir = d.read_string(a, unit);
+        }
+    }
+    if (!stmt_list) {
+        return std::nullopt;
+    }
+    return line_table{d, *stmt_list, cu.address_size, comp_dir};
+}
+
+line_index::line_index(const dwarf& d_):
+    d(d_),
+    aranges(d_)
+{}
+
+std::optional<line_location> line_index::find(uint64_t pc) {
+    std::optional<uint64_t> cu = aranges.find(pc);
+    if (!cu) {
+        return std::nullopt;
+    }
+    std::shared_ptr<const line_table> table;
+    bool found;
+    {
+        std::lock_guard lock{m};
+        auto it = tables.find(*cu);
+        found = it != tables.end();
+        if (found) {
+            table = it->second;
+        }
+    }
+    if (!found) {
+        //decode outside the lock, if another thread got there first its table is the one kept
+        std::optional<line_table> decoded = read_line_table(d, *cu);
+        if (decoded) {
+            table = std::make_shared<const line_table>(std::move(*decoded));
+        }
+        std::lock_guard lock{m};
+        table = tables.emplace(*cu, table).first->second;
+    }
+    const line_row* row = table ? table->find(pc) : nullptr;
+    if (!row) {
+        return std::nullopt;
+    }
+    return line_location{table->file_name(row->file), row->line};
+}
+
+}
@@ -0,0 +1,359 @@
+#include "lists.hh"
+
+#include <algorithm>
+#include <set>
+
+namespace dwarfy {
+
+using std::to_string;
+
+namespace {
+
+span_reader list_reader(std::span<std::byte> section, uint64_t offset, const list_context& ctx) {
+    if (offset > section.size()) {
+        throw std::runtime_error("list offset out of range: " + to_string(offset));
+    }
+    span_reader r {section.subspan(offset)};
+    r.file_endianness = ctx.endianness;
+    r.machine_address_size = ctx.address_size;
+    r.file_offset_size = ctx.offset_size;
+    return r;
+}
+
+uint64_t max_address(const list_context& ctx) {
+    return ctx.address_size >= 8 ? ~0ULL : (1ULL << (ctx.address_size * 8)) - 1;
+}
+
+uint64_t read_address(span_reader& r) {
+    machine_address_size a;
+    r & a;
+    return a;
+}
+
+uint64_t read_unsigned(span_reader& r) {
+    uleb128 v;
+    r & v;
+    return v;
+}
+
+uint64_t read_indexed_address(span_reader& r, const list_context& ctx) {
+    return indexed_address(ctx, read_unsigned(r));
+}
+
+}
+
+uint64_t indexed_address(const list_context& ctx, uint64_t index) {
+    if (ctx.addr_base > ctx.debug_addr.size() || index >= (ctx.debug_addr.size() - ctx.addr_base) / ctx.address_size) {
+        throw std::runtime_error(".debug_addr index out of range: " + to_string(index));
+    }
+    span_reader ar = list_reader(ctx.debug_addr, ctx.addr_base + index * ctx.address_size, ctx);
+    return read_address(ar);
+}
+
+uint64_t list_offset_from_index(std::span<std::byte> section, uint64_t base, uint64_t index, const list_context& ctx) {
+    if (base > section.size() || index >= (section.size() - base) / ctx.offset_size) {
+        throw std::runtime_error("list index out of range: " + to_string(index));
+    }
+    span_reader r = list_reader(section, base + index * ctx.offset_size, ctx);
+    file_offset_size offset;
+    r & offset;
+    return base + offset;
+}
+
+range_list::range_list(std::span<std::byte> section_, uint64_t offset_, const list_context& ctx_):
+    section(section_),
+    offset(offset_),
+    ctx(ctx_)
+{}
+range_list::iterator range_list::begin() const {
+    return iterator{list_reader(section, offset, ctx), ctx};
+}
+range_list::sentinel range_list::end() const {
+    return sentinel{};
+}
+
+range_list::iterator::iterator():
+    r({}),
+    done(true)
+{}
+range_list::iterator::iterator(span_reader r_, const list_context& ctx_):
+    r(r_),
+    ctx(ctx_),
+    done(false)
+{
+    next();
+}
+bool range_list::iterator::operator==(sentinel) const {
+    return done;
+}
+const address_range& range_list::iterator::operator*() const {
+    return current;
+}
+range_list::iterator& range_list::iterator::operator++() {
+    next();
+    return *this;
+}
+range_list::iterator range_list::iterator::operator++(int) {
+    range_list::iterator ret = *this;
+    this->operator++();
+    return ret;
+}
+void range_list::iterator::next() {
+    while (true) {
+        if (ctx.version < 5) {
+            uint64_t begin = read_address(r);
+            uint64_t end = read_address(r);
+            if (begin == 0 && end == 0) {
+                done = true;
+                return;
+            }
+            if (begin == max_address(ctx)) {
+                ctx.base_address = end;
+                continue;
+            }
+            current = {ctx.base_address + begin, ctx.base_address + end};
+            return;
+        }
+        uint8_t kind;
+        r & kind;
+        switch (static_cast<dw_rle>(kind)) {
+            case dw_rle::end_of_list:
+                done = true;
+                return;
+            case dw_rle::base_addressx:
+                ctx.base_address = read_indexed_address(r, ctx);
+                continue;
+            case dw_rle::startx_endx:
+                {
+                    uint64_t begin = read_indexed_address(r, ctx);
+                    uint64_t end = read_indexed_address(r, ctx);
+                    current = {begin, end};
+                    return;
+                }
+            case dw_rle::startx_length:
+                {
+                    uint64_t begin = read_indexed_address(r, ctx);
+                    uint64_t length = read_unsigned(r);
+                    current = {begin, begin + length};
+                    return;
+                }
+            case dw_rle::offset_pair:
+                {
+                    uint64_t begin = read_unsigned(r);
+                    uint64_t end = read_unsigned(r);
+                    current = {ctx.base_address + begin, ctx.base_address + end};
+                    return;
+                }
+            case dw_rle::base_address:
+                ctx.base_address = read_address(r);
+                continue;
+            case dw_rle::start_end:
+                {
+                    uint64_t begin = read_address(r);
+                    uint64_t end = read_address(r);
+                    current = {begin, end};
+                    return;
+                }
+            case dw_rle::start_length:
+                {
+                    uint64_t begin = read_address(r);
+                    uint64_t length = read_unsigned(r);
+                    current = {begin, begin + length};
+                    return;
+                }
+            default:
+                throw std::runtime_error("unknown DW_RLE range list entry kind: " + to_string(kind));
+        }
+    }
+}
+
+location_list::location_list(std::span<std::byte> section_, uint64_t offset_, const list_context& ctx_):
+    section(section_),
+    offset(offset_),
+    ctx(ctx_)
+{}
+location_list::iterator location_list::begin() const {
+    return iterator{list_reader(section, offset, ctx), ctx};
+}
+location_list::sentinel location_list::end() const {
+    return sentinel{};
+}
+
+location_list::iterator::iterator():
+    r({}),
+    done(true)
+{}
+location_list::iterator::iterator(span_reader r_, const list_context& ctx_):
+    r(r_),
+    ctx(ctx_),
+    done(false)
+{
+    next();
+}
+bool location_list::iterator::operator==(sentinel) const {
+    return done;
+}
+const location_list_entry& location_list::iterator::operator*() const {
+    return current;
+}
+location_list::iterator& location_list::iterator::operator++() {
+    next();
+    return *this;
+}
+location_list::iterator location_list::iterator::operator++(int) {
+    location_list::iterator ret = *this;
+    this->operator++();
+    return ret;
+}
+void location_list::iterator::next() {
+    auto expression = [&]() {
+        return r.read_bytes(read_unsigned(r));
+    };
+    while (true) {
+        if (ctx.version < 5) {
+            uint64_t begin = read_address(r);
+            uint64_t end = read_address(r);
+            if (begin == 0 && end == 0) {
+                done = true;
+                return;
+            }
+            if (begin == max_address(ctx)) {
+                ctx.base_address = end;
+                continue;
+            }
+            uint16_t length;
+            r & length;
+            current = {ctx.base_address + begin, ctx.base_address + end, r.read_bytes(length), false};
+            return;
+        }
+        uint8_t kind;
+        r & kind;
+        switch (static_cast<dw_lle>(kind)) {
+            case dw_lle::end_of_list:
+                done = true;
+                return;
+            case dw_lle::base_addressx:
+                ctx.base_address = read_indexed_address(r, ctx);
+                continue;
+            case dw_lle::startx_endx:
+                {
+                    uint64_t begin = read_indexed_address(r, ctx);
+                    uint64_t end = read_indexed_address(r, ctx);
+                    current = {begin, end, expression(), false};
+                    return;
+                }
+            case dw_lle::startx_length:
+                {
+                    uint64_t begin = read_indexed_address(r, ctx);
+                    uint64_t length = read_unsigned(r);
+                    current = {begin, begin + length, expression(), false};
+                    return;
+                }
+            case dw_lle::offset_pair:
+                {
+                    uint64_t begin = read_unsigned(r);
+                    uint64_t end = read_unsigned(r);
+                    current = {ctx.base_address + begin, ctx.base_address + end, expression(), false};
+                    return;
+                }
+            case dw_lle::default_location:
+                current = {0, 0, expression(), true};
+                return;
+            case dw_lle::base_address:
+                ctx.base_address = read_address(r);
+                continue;
+            case dw_lle::start_end:
+                {
+                    uint64_t begin = read_address(r);
+                    uint64_t end = read_address(r);
+                    current = {begin, end, expression(), false};
+                    return;
+                }
+            case dw_lle::start_length:
+                {
+                    uint64_t begin = read_address(r);
+                    uint64_t length = read_unsigned(r);
+                    current = {begin, begin + length, expression(), false};
+                    return;
+                }
+            case dw_lle::GNU_view_pair:
+                read_unsigned(r);
+                read_unsigned(r);
+                continue;
+            default:
+                throw std::runtime_error("unknown DW_LLE location list entry kind: " + to_string(kind));
+        }
+    }
+}
+
+location_index::location_index(const location_list& list) {
+    std::vector<location_list_entry> listed;
+    for (const location_list_entry& e: list) {
+        if (e.is_default) {
+            default_location = e;
+        } else if (e.begin < e.end) {
+            listed.push_back(e);
+        }
+    }
+
+    //entries can overlap or nest, split them into disjoint intervals so find only has to look at one,
+    //where several cover a pc the first in list order wins
+    struct boundary {
+        uint64_t address;
+        bool begin;
+        size_t entry;
+    };
+    std::vector<boundary> boundaries;
+    boundaries.reserve(2 * listed.size());
+    for (size_t i = 0; i < listed.size(); i++) {
+        boundaries.push_back({listed[i].begin, true, i});
+        boundaries.push_back({listed[i].end, false, i});
+    }
+    std::sort(boundaries.begin(), boundaries.end(), [](const boundary& a, const boundary& b) {
+        return a.address < b.address;
+    });
+    std::set<size_t> active;
+    for (size_t i = 0; i < boundaries.size();) {
+        uint64_t address = boundaries[i].address;
+        for (; i < boundaries.size() && boundaries[i].address == address; i++) {
+            if (boundaries[i].begin) {
+                active.insert(boundaries[i].entry);
+            } else {
+                active.erase(boundaries[i].entry);
+            }
+        }
+        if (active.empty() || i == boundaries.size()) {
+            continue;
+        }
+        const location_list_entry& winner = listed[*active.begin()];
+        uint64_t next = boundaries[i].address;
+        if (!entries.empty() && entries.back().end == address && entries.back().expression.data() == winner.expression.data() && entries.back().expression.size() == winner.expression.size()) {
+            entries.back().end = next;
+        } else {
+            entries.push_back({address, next, winner.expression, false});
+        }
+    }
+}
+
+std::optional<std::span<std::byte>> location_index::find(uint64_t pc) const {
+    auto it = std::upper_bound(entries.begin(), entries.end(), pc, [](uint64_t pc, const location_list_entry& e) {
+        return pc < e.begin;
+    });
+    if (it != entries.begin() && pc < std::prev(it)->end) {
+        return std::prev(it)->expression;
+    }
+    if (default_location) {
+        return default_location->expression;
+    }
+    return std::nullopt;
+}
+
+const location_index& location_index_cache::get(uint64_t offset) {
+    auto it = indexes.find(offset);
+    if (it == indexes.end()) {
+        it = indexes.emplace(offset, location_index{location_list{section, offset, ctx}}).first;
+    }
+    return it->second;
+}
+
+}
@@ -0,0 +1,51 @@
+#include "mapped-file.hh"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdexcept>
+
+namespace elfy {
+
+mapped_file::mapped_file(std::string filename_):
+    filename(filename_)
+{
+    fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error(filename + ": " + strerror(errno));
+    }
+    struct stat st;
+    int err = fstat(fd, &st);
+    if (err < 0) {
+        int e = errno;
+        close(fd);
+        throw std::runtime_error(filename + ": " + strerror(e));
+    }
+    size_t len = st.st_size;
+    if (len == 0) {
+        data = {};
+        return;
+    }
+    void* addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        int e = errno;
+        close(fd);
+        throw std::runtime_error(filename + ": " + strerror(e));
+    }
+
+    data = {static_cast<std::byte*>(addr), len};
+}
+
+mapped_file::~mapped_file() {
+    //nothing sensible to do about failures here, and destructors mustn't throw
+    if (!data.empty()) {
+        munmap(data.data(), data.size());
+    }
+    close(fd);
+}
+
+}
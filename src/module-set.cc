@@ -0,0 +1,297 @@
+#include "module-set.hh"
+
+#include <unistd.h>
+#include <algorithm>
+
+namespace dwarfy {
+
+uint64_t next_module_id() {
+    static std::atomic<uint64_t> next = 1;
+    return next++;
+}
+
+std::shared_ptr<loaded_module> open_module(debug_file_resolver& resolver, const std::string& path) {
+    return std::make_shared<loaded_module>(resolver.open(path));
+}
+
+void build_function_index(loaded_module& m) {
+    try {
+        m.functions_storage = std::make_unique<function_index>(m.files.d);
+    } catch (std::runtime_error& e) {
+        //a module with broken DWARF still symbolizes through its symbol table
+        m.functions_storage = std::make_unique<function_index>();
+    }
+    m.functions.store(m.functions_storage.get(), std::memory_order_release);
+}
+
+line_index& module_lines(loaded_module& m) {
+    std::call_once(m.lines_once, [&]() {
+        m.lines = std::make_unique<line_index>(m.files.d);
+    });
+    return *m.lines;
+}
+
+bool symbolize(loaded_module& m, uint64_t pc, symbolized_frame& f) {
+    const function_index* functions = m.functions.load(std::memory_order_acquire);
+    if (const function_range* fr = functions ? functions->find(pc) : nullptr) {
+        f.function = fr->name;
+        f.offset = pc - fr->begin;
+        return true;
+    }
+    //a stripped binary only has .dynsym, its separate debug file keeps the full .symtab
+    std::optional<elfy::symbol> sym;
+    if (m.files.debug_elf) {
+        sym = m.files.debug_elf->find_symbol(pc);
+    }
+    if (!sym) {
+        sym = m.files.d.elf.find_symbol(pc);
+    }
+    if (!sym) {
+        return false;
+    }
+    f.function = sym->name;
+    f.offset = pc - sym->value;
+    return true;
+}
+
+module_cache::module_cache(size_t capacity, size_t shard_count, unsigned builder_threads):
+    capacity_per_shard(std::max<size_t>((capacity + std::max<size_t>(shard_count, 1) - 1) / std::max<size_t>(shard_count, 1), 1)),
+    shards(std::max<size_t>(shard_count, 1))
+{
+    for (unsigned t = 0; t < builder_threads; t++) {
+        builders.emplace_back([this]() {
+            build_indexes();
+        });
+    }
+}
+
+module_cache::~module_cache() {
+    {
+        std::lock_guard lock{queue_m};
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    for (std::thread& t: builders) {
+        t.join();
+    }
+}
+
+void module_cache::build_indexes() {
+    while (true) {
+        std::shared_ptr<loaded_module> m;
+        {
+            std::unique_lock lock{queue_m};
+            queue_cv.wait(lock, [&]() {
+                return stopping || !queue.empty();
+            });
+            if (stopping) {
+                return;
+            }
+            m = queue.front().lock();
+            queue.pop_front();
+        }
+        //modules evicted before their turn aren't worth indexing
+        if (m) {
+            build_function_index(*m);
+            m.reset();
+        }
+        {
+            std::lock_guard lock{queue_m};
+            pending--;
+        }
+        queue_cv.notify_all();
+    }
+}
+
+void module_cache::wait_for_indexes() {
+    std::unique_lock lock{queue_m};
+    queue_cv.wait(lock, [&]() {
+        return pending == 0;
+    });
+}
+
+std::shared_ptr<loaded_module> module_cache::open(const std::string& path) {
+    if (path.empty() || access(path.c_str(), R_OK) != 0) {
+        return nullptr;
+    }
+    std::shared_ptr<loaded_module> opened = open_module(resolver, path);
+    elfy::elf e{opened->files.binary->data};
+    std::string build_id = elfy::build_id_hex(elfy::build_id(e));
+    if (!build_id.empty()) {
+        std::lock_guard lock{build_ids_m};
+        std::weak_ptr<loaded_module>& same = by_build_id[build_id];
+        if (std::shared_ptr<loaded_module> existing = same.lock()) {
+            //the same binary through another path or inode, use the existing index
+            return existing;
+        }
+        same = opened;
+    }
+    if (builders.empty()) {
+        build_function_index(*opened);
+    } else {
+        {
+            std::lock_guard lock{queue_m};
+            queue.push_back(opened);
+            pending++;
+        }
+        //wait_for_indexes shares the condition variable, so wake everyone to be sure a builder sees it
+        queue_cv.notify_all();
+    }
+    return opened;
+}
+
+std::shared_ptr<loaded_module> module_cache::get(const std::string& key, const std::function<std::string()>& locate) {
+    shard& s = shards[std::hash<std::string>{}(key) % shards.size()];
+    std::shared_ptr<entry> e;
+    {
+        std::lock_guard lock{s.m};
+        auto it = s.entries.find(key);
+        if (it != s.entries.end()) {
+            s.lru.splice(s.lru.begin(), s.lru, it->second);
+            e = it->second->second;
+        } else {
+            e = std::make_shared<entry>();
+            s.lru.emplace_front(key, e);
+            s.entries[key] = s.lru.begin();
+            while (s.lru.size() > capacity_per_shard) {
+                s.entries.erase(s.lru.back().first);
+                s.lru.pop_back();
+            }
+        }
+    }
+    //opened outside the shard lock, mapping and checksumming debug files is slow; a throw leaves the
+    //flag unset, so the next lookup tries again
+    std::call_once(e->once, [&]() {
+        e->module = open(locate());
+    });
+    return e->module;
+}
+
+std::shared_ptr<loaded_module> module_cache::get(const std::string& path) {
+    return get(path, [&]() {
+        return path;
+    });
+}
+
+size_t module_cache::size() {
+    size_t n = 0;
+    for (shard& s: shards) {
+        std::lock_guard lock{s.m};
+        n += s.lru.size();
+    }
+    return n;
+}
+
+module_set::module_set(std::vector<module_mapping> mappings_, size_t max_open_modules, size_t shard_count, unsigned builder_threads):
+    mappings(std::move(mappings_)),
+    cache(max_open_modules, shard_count, std::max(builder_threads, 1u)),
+    resolver(cache.resolver)
+{
+    by_address.resize(mappings.size());
+    for (size_t i = 0; i < mappings.size(); i++) {
+        by_address[i] = i;
+    }
+    std::sort(by_address.begin(), by_address.end(), [&](size_t a, size_t b) {
+        return mappings[a].load_address < mappings[b].load_address;
+    });
+    for (size_t i: by_address) {
+        load_addresses.push_back(mappings[i].load_address);
+    }
+}
+
+void module_set::wait_for_indexes() {
+    cache.wait_for_indexes();
+}
+
+std::optional<size_t> module_set::find_module(uint64_t address) const {
+    auto it = std::upper_bound(load_addresses.begin(), load_addresses.end(), address);
+    if (it == load_addresses.begin()) {
+        return std::nullopt;
+    }
+    size_t i = by_address[it - load_addresses.begin() - 1];
+    const module_mapping& m = mappings[i];
+    if (m.size != 0 && address - m.load_address >= m.size) {
+        return std::nullopt;
+    }
+    return i;
+}
+
+std::string module_set::locate(size_t i) {
+    const module_mapping& mapping = mappings[i];
+    std::string path = mapping.path;
+    //a core or trace from another machine names files that may not be here, the build-id still finds them
+    if ((path.empty() || access(path.c_str(), R_OK) != 0) && mapping.build_id.size() > 2) {
+        path.clear();
+        //.build-id/xx/yyyy links to the binary itself, .build-id/xx/yyyy.debug to its debug file
+        for (const std::string& dir: resolver.debug_directories) {
+            std::string base = dir + "/.build-id/" + mapping.build_id.substr(0, 2) + "/" + mapping.build_id.substr(2);
+            if (access(base.c_str(), R_OK) == 0) {
+                path = base;
+                break;
+            }
+            if (access((base + ".debug").c_str(), R_OK) == 0) {
+                path = base + ".debug";
+                break;
+            }
+        }
+    }
+    return path;
+}
+
+std::shared_ptr<loaded_module> module_set::module(size_t i) {
+    //by path and build-id, so mappings of the same file share an entry
+    const module_mapping& mapping = mappings[i];
+    try {
+        return cache.get(mapping.path + '\0' + mapping.build_id, [&]() {
+            return locate(i);
+        });
+    } catch (std::runtime_error& e) {
+        return nullptr;
+    } catch (std::invalid_argument& e) {
+        return nullptr;
+    }
+}
+
+std::vector<module_mapping> core_modules(const elfy::core_file& core) {
+    std::vector<module_mapping> mappings;
+    for (const elfy::core_module& m: core.modules()) {
+        mappings.push_back({std::string{m.path}, m.build_id, m.load_bias, m.end - m.load_bias});
+    }
+    return mappings;
+}
+
+symbolized_frame module_set::symbolize(uint64_t address) {
+    return symbolize(std::span<const uint64_t>{&address, 1}).front();
+}
+
+std::vector<symbolized_frame> module_set::symbolize(std::span<const uint64_t> addresses) {
+    std::vector<symbolized_frame> frames;
+    frames.reserve(addresses.size());
+    //stacks mostly stay within a module for several frames, keep the last one rather than going
+    //back through the shard lock for each
+    std::optional<size_t> last_index;
+    std::shared_ptr<loaded_module> last;
+    for (uint64_t address: addresses) {
+        symbolized_frame f;
+        f.address = address;
+        std::optional<size_t> i = find_module(address);
+        if (!i) {
+            frames.push_back(std::move(f));
+            continue;
+        }
+        f.module = *i;
+        if (i != last_index) {
+            last = module(*i);
+            last_index = i;
+        }
+        if (!last) {
+            frames.push_back(std::move(f));
+            continue;
+        }
+        dwarfy::symbolize(*last, address - mappings[*i].load_address, f);
+        frames.push_back(std::move(f));
+    }
+    return frames;
+}
+
+}
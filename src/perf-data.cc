@@ -0,0 +1,306 @@
+#include "perf-data.hh"
+
+#include <sys/sysmacros.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace dwarfy {
+
+using std::to_string;
+
+namespace {
+
+constexpr size_t file_header_size = 104;
+constexpr size_t pipe_header_size = 16;
+constexpr size_t record_header_size = 8;
+
+//PERF_SAMPLE_*
+constexpr uint64_t sample_ip = 1 << 0;
+constexpr uint64_t sample_tid = 1 << 1;
+constexpr uint64_t sample_time = 1 << 2;
+constexpr uint64_t sample_addr = 1 << 3;
+constexpr uint64_t sample_read = 1 << 4;
+constexpr uint64_t sample_callchain = 1 << 5;
+constexpr uint64_t sample_id = 1 << 6;
+constexpr uint64_t sample_cpu = 1 << 7;
+constexpr uint64_t sample_period = 1 << 8;
+constexpr uint64_t sample_stream_id = 1 << 9;
+constexpr uint64_t sample_identifier = 1 << 16;
+
+//PERF_FORMAT_*
+constexpr uint64_t format_total_time_enabled = 1 << 0;
+constexpr uint64_t format_total_time_running = 1 << 1;
+constexpr uint64_t format_id = 1 << 2;
+constexpr uint64_t format_group = 1 << 3;
+constexpr uint64_t format_lost = 1 << 4;
+
+//PERF_RECORD_MISC_*
+constexpr uint16_t misc_cpumode_mask = 7;
+constexpr uint16_t misc_mmap_data = 1 << 13;
+constexpr uint16_t misc_comm_exec = 1 << 13;
+constexpr uint16_t misc_mmap_build_id = 1 << 14;
+
+struct file_section {
+    uint64_t offset;
+    uint64_t size;
+};
+
+template<typename R>
+void read(R& r, file_section& s) {
+    r & s.offset & s.size;
+}
+
+std::span<std::byte> section(std::span<std::byte> data, const file_section& s, std::string_view what) {
+    if (s.offset > data.size() || s.size > data.size() - s.offset) {
+        throw std::runtime_error("perf.data " + std::string{what} + " section runs off the end of the file");
+    }
+    return data.subspan(s.offset, s.size);
+}
+
+//a reader over a record body that checks every read, records come from outside and may be truncated
+struct record_reader {
+    span_reader r;
+    uint32_t type;
+
+    record_reader(std::span<std::byte> body, std::endian endianness, uint32_t type_):
+        r(body),
+        type(type_)
+    {
+        r.file_endianness = endianness;
+    }
+    void need(size_t size) {
+        if (r.data.size() < size) {
+            throw std::runtime_error("perf record of type " + to_string(type) + " is truncated");
+        }
+    }
+    template<typename T>
+    record_reader& operator&(T& v) {
+        need(sizeof(T));
+        r & v;
+        return *this;
+    }
+    void skip(size_t size) {
+        need(size);
+        r.read_bytes(size);
+    }
+    //NUL terminated and padded to 8 bytes, followed by the sample id fields if sample_id_all is set
+    std::string_view string() {
+        const char* s = reinterpret_cast<const char*>(r.data.data());
+        return {s, strnlen(s, r.data.size())};
+    }
+};
+
+}
+
+perf_data::perf_data(std::span<std::byte> data_):
+    data(data_)
+{
+    if (data.size() < pipe_header_size) {
+        throw std::invalid_argument("file too small for a perf.data header");
+    }
+    std::string_view magic {reinterpret_cast<const char*>(data.data()), 8};
+    if (magic == "PERFILE2") {
+        endianness_ = std::endian::little;
+    } else if (magic == "2ELIFREP") {
+        endianness_ = std::endian::big;
+    } else {
+        throw std::invalid_argument("bad perf.data magic number, this is likely not a perf.data file!");
+    }
+    span_reader r {data.subspan(8)};
+    r.file_endianness = endianness_;
+    uint64_t header_size;
+    r & header_size;
+    if (header_size == pipe_header_size) {
+        throw std::runtime_error("perf.data in pipe mode isn't supported, record to a file");
+    }
+    if (header_size < file_header_size || data.size() < file_header_size) {
+        throw std::runtime_error("bad perf.data header size: " + to_string(header_size));
+    }
+    uint64_t attr_size;
+    file_section attrs;
+    file_section records_section;
+    r & attr_size & attrs & records_section;
+    records = section(data, records_section, "data");
+
+    //each entry is a perf_event_attr, as big as the perf that wrote it knew about, then its ids' section
+    if (attr_size <= sizeof(file_section) || attr_size > 4096) {
+        throw std::runtime_error("bad perf.data attribute size: " + to_string(attr_size));
+    }
+    std::span<std::byte> attr_table = section(data, attrs, "attributes");
+    for (uint64_t offset = 0; offset + attr_size <= attr_table.size(); offset += attr_size) {
+        span_reader ar {attr_table.subspan(offset, attr_size)};
+        ar.file_endianness = endianness_;
+        perf_event_attributes a;
+        uint32_t size;
+        uint64_t period;
+        uint64_t flags;
+        //type, size, config, sample_period, sample_type, read_format and the flag bitfield are in
+        //every version of the struct
+        if (attr_size - sizeof(file_section) < 48) {
+            throw std::runtime_error("perf.data attributes too small: " + to_string(attr_size));
+        }
+        ar & a.type & size & a.config & period & a.sample_type & a.read_format & flags;
+        //bitfields are allocated from the other end on big endian machines
+        a.sample_id_all = endianness_ == std::endian::little ? flags >> 18 & 1 : flags >> 45 & 1;
+        ar.reset(attr_table.subspan(offset + attr_size - sizeof(file_section)));
+        file_section ids;
+        ar & ids;
+        span_reader ir {section(data, ids, "attribute ids")};
+        ir.file_endianness = endianness_;
+        while (ir.data.size() >= sizeof(uint64_t)) {
+            uint64_t id;
+            ir & id;
+            a.ids.push_back(id);
+        }
+        attributes_.push_back(std::move(a));
+    }
+    if (attributes_.empty()) {
+        throw std::runtime_error("perf.data has no event attributes");
+    }
+}
+
+bool perf_data::next(uint64_t& position, perf_record& record) const {
+    if (position + record_header_size > records.size()) {
+        return false;
+    }
+    span_reader r {records.subspan(position)};
+    r.file_endianness = endianness_;
+    uint16_t size;
+    r & record.type & record.misc & size;
+    if (size < record_header_size || size > records.size() - position) {
+        throw std::runtime_error("bad perf record size " + to_string(size) + " at data offset " + to_string(position));
+    }
+    record.body = records.subspan(position + record_header_size, size - record_header_size);
+    position += size;
+    return true;
+}
+
+//with several events, samples start with PERF_SAMPLE_IDENTIFIER to say whose layout they have
+const perf_event_attributes& perf_data::sample_attributes(std::span<std::byte> body) const {
+    const perf_event_attributes& first = attributes_.front();
+    bool same = std::all_of(attributes_.begin(), attributes_.end(), [&](const perf_event_attributes& a) {
+        return a.sample_type == first.sample_type && a.read_format == first.read_format;
+    });
+    if (same) {
+        return first;
+    }
+    if (!(first.sample_type & sample_identifier)) {
+        throw std::runtime_error("perf.data events have different sample layouts and no PERF_SAMPLE_IDENTIFIER");
+    }
+    record_reader r {body, endianness_, perf_record_sample};
+    uint64_t id;
+    r & id;
+    for (const perf_event_attributes& a: attributes_) {
+        if (std::find(a.ids.begin(), a.ids.end(), id) != a.ids.end()) {
+            return a;
+        }
+    }
+    throw std::runtime_error("perf sample with unknown id " + to_string(id));
+}
+
+perf_mmap perf_data::decode_mmap(const perf_record& record) const {
+    record_reader r {record.body, endianness_, record.type};
+    perf_mmap m;
+    r & m.pid & m.tid & m.start & m.length & m.page_offset;
+    if (record.type == perf_record_mmap) {
+        m.executable = !(record.misc & misc_mmap_data);
+    } else {
+        if (record.misc & misc_mmap_build_id) {
+            //build-id size, 3 reserved bytes and up to 20 bytes of build-id
+            r.skip(24);
+        } else {
+            uint32_t major;
+            uint32_t minor;
+            uint64_t generation;
+            r & major & minor & m.inode & generation;
+            m.device = makedev(major, minor);
+        }
+        uint32_t prot;
+        uint32_t flags;
+        r & prot & flags;
+        //PROT_EXEC
+        m.executable = prot & 4;
+    }
+    m.path = r.string();
+    return m;
+}
+
+perf_comm perf_data::decode_comm(const perf_record& record) const {
+    record_reader r {record.body, endianness_, record.type};
+    perf_comm c;
+    r & c.pid & c.tid;
+    c.exec = record.misc & misc_comm_exec;
+    c.comm = r.string();
+    return c;
+}
+
+perf_task perf_data::decode_task(const perf_record& record) const {
+    record_reader r {record.body, endianness_, record.type};
+    perf_task t;
+    r & t.pid & t.ppid & t.tid & t.ptid;
+    return t;
+}
+
+perf_sample perf_data::decode_sample(const perf_record& record) const {
+    const perf_event_attributes& a = sample_attributes(record.body);
+    record_reader r {record.body, endianness_, record.type};
+    perf_sample s;
+    s.cpu_mode = record.misc & misc_cpumode_mask;
+    uint64_t ignored;
+    uint32_t ignored32;
+    if (a.sample_type & sample_identifier) {
+        r & ignored;
+    }
+    if (a.sample_type & sample_ip) {
+        r & s.ip;
+    }
+    if (a.sample_type & sample_tid) {
+        r & s.pid & s.tid;
+    }
+    if (a.sample_type & sample_time) {
+        r & s.time;
+    }
+    if (a.sample_type & sample_addr) {
+        r & ignored;
+    }
+    if (a.sample_type & sample_id) {
+        r & ignored;
+    }
+    if (a.sample_type & sample_stream_id) {
+        r & ignored;
+    }
+    if (a.sample_type & sample_cpu) {
+        r & ignored32 & ignored32;
+    }
+    if (a.sample_type & sample_period) {
+        r & s.period;
+    }
+    if (a.sample_type & sample_read) {
+        //the counter values: one, or a group's count and then one per member
+        size_t times = !!(a.read_format & format_total_time_enabled) + !!(a.read_format & format_total_time_running);
+        size_t per_value = 1 + !!(a.read_format & format_id) + !!(a.read_format & format_lost);
+        if (a.read_format & format_group) {
+            uint64_t nr;
+            r & nr;
+            if (nr > r.r.data.size() / sizeof(uint64_t)) {
+                throw std::runtime_error("perf sample read group of " + to_string(nr) + " doesn't fit its record");
+            }
+            r.skip((times + nr * per_value) * sizeof(uint64_t));
+        } else {
+            r.skip((times + per_value) * sizeof(uint64_t));
+        }
+    }
+    if (a.sample_type & sample_callchain) {
+        uint64_t nr;
+        r & nr;
+        if (nr > r.r.data.size() / sizeof(uint64_t)) {
+            throw std::runtime_error("perf sample callchain of " + to_string(nr) + " doesn't fit its record");
+        }
+        s.callchain = {r.r.read_bytes(nr * sizeof(uint64_t)), endianness_};
+    }
+    return s;
+}
+
+}
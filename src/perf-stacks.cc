@@ -0,0 +1,389 @@
+#include "perf-stacks.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+
+#include "parallel.hh"
+
+namespace dwarfy {
+
+namespace {
+
+constexpr uint32_t pt_load = 1;
+//PERF_RECORD_MISC_KERNEL
+constexpr uint16_t cpumode_kernel = 1;
+
+//a file mapped executable by some process in the recording, opened by the first worker that needs it
+struct file_slot {
+    process_mapping mapping;
+    std::once_flag once;
+    std::shared_ptr<loaded_module> files;
+    std::vector<elfy::program_header> loads;
+    //what frames in it that don't symbolize are called
+    std::string unresolved;
+};
+
+enum class frame_kind : uint8_t {
+    file,
+    unmapped,
+    kernel,
+};
+
+struct frame {
+    frame_kind kind;
+    file_slot* file;
+    //into the file for frame_kind::file
+    uint64_t offset;
+};
+
+struct sample {
+    //points into the perf.data's COMM record
+    std::string_view comm;
+    size_t first_frame;
+    size_t frame_count;
+};
+
+struct batch {
+    std::vector<sample> samples;
+    //innermost first, like callchains
+    std::vector<frame> frames;
+};
+
+struct mapped_range {
+    uint64_t end;
+    uint64_t page_offset;
+    file_slot* file;
+};
+
+//executable mappings by start address
+using address_space = std::map<uint64_t, mapped_range>;
+
+struct frame_key {
+    const file_slot* file;
+    uint64_t offset;
+
+    bool operator==(const frame_key&) const = default;
+};
+
+struct frame_key_hash {
+    size_t operator()(const frame_key& k) const {
+        return std::hash<uint64_t>{}(k.offset * 0x9e3779b97f4a7c15 ^ reinterpret_cast<uintptr_t>(k.file));
+    }
+};
+
+//one worker's symbolization memo and stack counts
+class stack_counter {
+    module_cache& cache;
+    std::unordered_map<frame_key, std::string, frame_key_hash> names;
+public:
+    std::unordered_map<std::string, uint64_t> counts;
+
+    stack_counter(module_cache& cache_):
+        cache(cache_)
+    {}
+
+    const std::string& name(file_slot& slot, uint64_t offset) {
+        auto [it, inserted] = names.try_emplace(frame_key{&slot, offset});
+        if (!inserted) {
+            return it->second;
+        }
+        std::call_once(slot.once, [&]() {
+            if (!slot.mapping.path.starts_with('/')) {
+                return;
+            }
+            slot.files = open_mapping(cache, slot.mapping);
+            if (!slot.files) {
+                return;
+            }
+            elfy::elf e{slot.files->files.binary->data};
+            for (size_t i = 0; i < e.program_count(); i++) {
+                elfy::program_header ph = e.get_program_by_id(i).value();
+                if (ph.segment_type() == pt_load) {
+                    slot.loads.push_back(ph);
+                }
+            }
+        });
+        it->second = slot.unresolved;
+        if (!slot.files) {
+            return it->second;
+        }
+        for (const elfy::program_header& ph: slot.loads) {
+            if (ph.file_offset() <= offset && offset - ph.file_offset() < ph.file_size()) {
+                symbolized_frame f;
+                if (symbolize(*slot.files, offset - ph.file_offset() + ph.address(), f)) {
+                    it->second = std::move(f.function);
+                }
+                break;
+            }
+        }
+        return it->second;
+    }
+
+    void count(batch& b) {
+        std::string stack;
+        for (const sample& s: b.samples) {
+            stack = s.comm;
+            for (size_t i = s.frame_count; i-- > 0;) {
+                frame& f = b.frames[s.first_frame + i];
+                stack += ';';
+                if (f.kind == frame_kind::file) {
+                    stack += name(*f.file, f.offset);
+                } else if (f.kind == frame_kind::unmapped) {
+                    stack += "[unknown]";
+                } else {
+                    stack += "[kernel]";
+                }
+            }
+            counts[stack]++;
+        }
+    }
+};
+
+//hands batches from the reading thread to the workers, holding at most capacity so reading can't
+//run arbitrarily far ahead of symbolizing
+class batch_queue {
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<batch> batches;
+    size_t capacity;
+    bool closed = false;
+public:
+    batch_queue(size_t capacity_):
+        capacity(capacity_)
+    {}
+    void push(batch&& b) {
+        std::unique_lock lock{m};
+        cv.wait(lock, [&]() {
+            return batches.size() < capacity || closed;
+        });
+        batches.push_back(std::move(b));
+        cv.notify_all();
+    }
+    bool pop(batch& b) {
+        std::unique_lock lock{m};
+        cv.wait(lock, [&]() {
+            return !batches.empty() || closed;
+        });
+        if (batches.empty()) {
+            return false;
+        }
+        b = std::move(batches.front());
+        batches.pop_front();
+        cv.notify_all();
+        return true;
+    }
+    void close() {
+        std::lock_guard lock{m};
+        closed = true;
+        cv.notify_all();
+    }
+};
+
+//the reading stage: the processes' address spaces and thread names as of the current record
+class sample_reader {
+    const perf_data& perf;
+    std::unordered_map<uint32_t, address_space> spaces;
+    std::unordered_map<uint32_t, std::string_view> comms;
+    std::map<std::tuple<std::string_view, uint64_t, uint64_t>, file_slot*> by_file;
+public:
+    //owned here so frames can point at them, the workers only read what was set before a batch was pushed
+    std::vector<std::unique_ptr<file_slot>> files;
+
+    sample_reader(const perf_data& perf_):
+        perf(perf_)
+    {}
+
+    void mmap(const perf_record& record) {
+        perf_mmap m = perf.decode_mmap(record);
+        if (!m.executable || m.length == 0) {
+            return;
+        }
+        auto [it, inserted] = by_file.try_emplace({m.path, m.device, m.inode});
+        if (inserted) {
+            auto slot = std::make_unique<file_slot>();
+            slot->mapping = {m.start, m.start + m.length, m.page_offset, true, m.device, m.inode, std::string{m.path}};
+            std::string_view base = m.path.substr(m.path.find_last_of('/') + 1);
+            slot->unresolved = "[" + std::string{base.empty() ? m.path : base} + "]";
+            it->second = slot.get();
+            files.push_back(std::move(slot));
+        }
+        //a new mapping replaces whatever it overlaps
+        address_space& space = spaces[m.pid];
+        uint64_t end = m.start + m.length;
+        auto first = space.upper_bound(m.start);
+        if (first != space.begin() && std::prev(first)->second.end > m.start) {
+            first--;
+        }
+        auto last = space.lower_bound(end);
+        space.erase(first, last);
+        space.emplace(m.start, mapped_range{end, m.page_offset, it->second});
+    }
+
+    void comm(const perf_record& record) {
+        perf_comm c = perf.decode_comm(record);
+        comms[c.tid] = c.comm;
+        //the mappings of the new image follow
+        if (c.exec) {
+            spaces[c.pid].clear();
+        }
+    }
+
+    void fork(const perf_record& record) {
+        perf_task t = perf.decode_task(record);
+        if (t.pid != t.ppid) {
+            spaces[t.pid] = spaces[t.ppid];
+        }
+        if (auto it = comms.find(t.ptid); it != comms.end()) {
+            comms[t.tid] = it->second;
+        }
+    }
+
+    frame user_frame(const address_space* space, uint64_t ip) {
+        if (space) {
+            auto it = space->upper_bound(ip);
+            if (it != space->begin() && ip < std::prev(it)->second.end) {
+                const auto& [start, range] = *std::prev(it);
+                return {frame_kind::file, range.file, ip - start + range.page_offset};
+            }
+        }
+        return {frame_kind::unmapped, nullptr, ip};
+    }
+
+    void sample(const perf_record& record, batch& b) {
+        perf_sample s = perf.decode_sample(record);
+        auto space_it = spaces.find(s.pid);
+        const address_space* space = space_it == spaces.end() ? nullptr : &space_it->second;
+        auto comm_it = comms.find(s.tid);
+        struct sample out {comm_it == comms.end() ? std::string_view{"[unknown]"} : comm_it->second, b.frames.size(), 0};
+
+        bool kernel = s.cpu_mode == cpumode_kernel;
+        bool leaf = true;
+        auto add = [&](uint64_t ip) {
+            if (kernel) {
+                if (b.frames.size() == out.first_frame || b.frames.back().kind != frame_kind::kernel) {
+                    b.frames.push_back({frame_kind::kernel, nullptr, ip});
+                }
+                leaf = false;
+                return;
+            }
+            //callers' ips are return addresses, which can be past the end of a function ending in a
+            //call that doesn't return, so they're looked up a byte earlier, inside the call
+            b.frames.push_back(user_frame(space, leaf ? ip : ip - 1));
+            leaf = false;
+        };
+        if (s.callchain.size() == 0) {
+            add(s.ip);
+        }
+        for (size_t i = 0; i < s.callchain.size(); i++) {
+            uint64_t ip = s.callchain[i];
+            if (ip >= perf_context_max) {
+                kernel = ip != perf_context_user;
+                continue;
+            }
+            add(ip);
+        }
+        out.frame_count = b.frames.size() - out.first_frame;
+        b.samples.push_back(out);
+    }
+};
+
+}
+
+folded_stacks fold_perf_samples(const perf_data& perf, module_cache& cache, unsigned threads, size_t batch_samples) {
+    threads = parallel_threads(threads);
+    batch_queue queue {2 * static_cast<size_t>(threads)};
+    std::vector<stack_counter> counters(threads, stack_counter{cache});
+    std::mutex error_m;
+    std::exception_ptr error;
+    std::atomic<bool> failed = false;
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            batch b;
+            while (queue.pop(b)) {
+                //after an error keep draining so the reader never blocks on a full queue
+                try {
+                    if (!failed) {
+                        counters[t].count(b);
+                    }
+                } catch (...) {
+                    std::lock_guard lock{error_m};
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    failed = true;
+                }
+            }
+        });
+    }
+
+    folded_stacks result;
+    sample_reader reader {perf};
+    try {
+        batch b;
+        uint64_t position = 0;
+        perf_record record;
+        while (perf.next(position, record)) {
+            switch (record.type) {
+                case perf_record_mmap:
+                case perf_record_mmap2:
+                    reader.mmap(record);
+                    break;
+                case perf_record_comm:
+                    reader.comm(record);
+                    break;
+                case perf_record_fork:
+                    reader.fork(record);
+                    break;
+                case perf_record_sample:
+                    reader.sample(record, b);
+                    result.samples++;
+                    if (b.samples.size() >= batch_samples) {
+                        queue.push(std::move(b));
+                        b = {};
+                    }
+                    break;
+            }
+        }
+        if (!b.samples.empty()) {
+            queue.push(std::move(b));
+        }
+    } catch (...) {
+        std::lock_guard lock{error_m};
+        if (!error) {
+            error = std::current_exception();
+        }
+    }
+    queue.close();
+    for (std::thread& w: workers) {
+        w.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    std::unordered_map<std::string, uint64_t> merged = std::move(counters.front().counts);
+    for (size_t t = 1; t < counters.size(); t++) {
+        for (auto& [stack, count]: counters[t].counts) {
+            merged[stack] += count;
+        }
+    }
+    result.stacks.reserve(merged.size());
+    for (auto& [stack, count]: merged) {
+        result.stacks.push_back({stack, count});
+    }
+    std::sort(result.stacks.begin(), result.stacks.end(), [](const folded_stack& a, const folded_stack& b) {
+        return a.stack < b.stack;
+    });
+    return result;
+}
+
+}
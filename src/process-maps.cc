@@ -0,0 +1,225 @@
+#include "process-maps.hh"
+
+#include <fcntl.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+namespace dwarfy {
+
+using std::to_string;
+
+namespace {
+
+constexpr uint32_t pt_load = 1;
+
+std::string_view next_field(std::string_view& line) {
+    size_t start = line.find_first_not_of(' ');
+    if (start == std::string_view::npos) {
+        line = {};
+        return {};
+    }
+    line.remove_prefix(start);
+    size_t end = std::min(line.find(' '), line.size());
+    std::string_view field = line.substr(0, end);
+    line.remove_prefix(end);
+    return field;
+}
+
+uint64_t number(std::string_view field, int base, std::string_view line) {
+    uint64_t v = 0;
+    auto [end, ec] = std::from_chars(field.data(), field.data() + field.size(), v, base);
+    if (ec != std::errc{} || end != field.data() + field.size()) {
+        throw std::runtime_error("bad /proc/pid/maps line: '" + std::string{line} + "'");
+    }
+    return v;
+}
+
+//the address in the file of the mapping's first byte, through the PT_LOAD it's part of
+uint64_t load_bias(const loaded_module* files, const process_mapping& first) {
+    uint64_t bias = first.start - first.file_offset;
+    if (!files) {
+        return bias;
+    }
+    elfy::elf e{files->files.binary->data};
+    static const uint64_t page_size = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < e.program_count(); i++) {
+        elfy::program_header ph = e.get_program_by_id(i).value();
+        uint64_t page_offset = ph.file_offset() & ~(page_size - 1);
+        if (ph.segment_type() == pt_load && page_offset <= first.file_offset && first.file_offset < ph.file_offset() + ph.file_size()) {
+            return bias - (ph.address() - ph.file_offset());
+        }
+    }
+    return bias;
+}
+
+}
+
+std::vector<process_mapping> parse_process_maps(std::string_view maps) {
+    std::vector<process_mapping> mappings;
+    while (!maps.empty()) {
+        size_t newline = std::min(maps.find('\n'), maps.size());
+        std::string_view line = maps.substr(0, newline);
+        maps.remove_prefix(std::min(newline + 1, maps.size()));
+        if (line.empty()) {
+            continue;
+        }
+        std::string_view rest = line;
+        std::string_view range = next_field(rest);
+        std::string_view permissions = next_field(rest);
+        std::string_view offset = next_field(rest);
+        std::string_view device = next_field(rest);
+        std::string_view inode = next_field(rest);
+        size_t dash = range.find('-');
+        size_t colon = device.find(':');
+        if (dash == std::string_view::npos || colon == std::string_view::npos || permissions.size() < 3 || inode.empty()) {
+            throw std::runtime_error("bad /proc/pid/maps line: '" + std::string{line} + "'");
+        }
+        process_mapping m;
+        m.start = number(range.substr(0, dash), 16, line);
+        m.end = number(range.substr(dash + 1), 16, line);
+        m.file_offset = number(offset, 16, line);
+        m.executable = permissions[2] == 'x';
+        m.device = makedev(number(device.substr(0, colon), 16, line), number(device.substr(colon + 1), 16, line));
+        m.inode = number(inode, 10, line);
+        //the path is the rest of the line after the padding, and may have spaces in it
+        size_t path = rest.find_first_not_of(' ');
+        m.path = path == std::string_view::npos ? std::string{} : std::string{rest.substr(path)};
+        mappings.push_back(std::move(m));
+    }
+    return mappings;
+}
+
+//procfs files have no size, they're read until read returns 0
+std::string read_process_maps(pid_t pid) {
+    std::string path = "/proc/" + to_string(pid) + "/maps";
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open " + path + ": " + strerror(errno));
+    }
+    std::string contents;
+    char buffer[16384];
+    while (true) {
+        ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            int error = errno;
+            close(fd);
+            throw std::runtime_error("failed to read " + path + ": " + strerror(error));
+        }
+        if (n == 0) {
+            break;
+        }
+        contents.append(buffer, n);
+    }
+    close(fd);
+    return contents;
+}
+
+std::shared_ptr<loaded_module> open_mapping(module_cache& cache, const process_mapping& mapping, pid_t pid) {
+    //the device and inode tell a file replaced on disk (an upgrade) apart from the one still mapped
+    std::string key = mapping.path + '\0' + to_string(mapping.device) + ':' + to_string(mapping.inode);
+    try {
+        return cache.get(key, [&]() {
+            //a process in another mount namespace (a container) names files in its own root
+            std::string root = "/proc/" + to_string(pid) + "/root" + mapping.path;
+            if (pid != 0 && access(root.c_str(), R_OK) == 0) {
+                return root;
+            }
+            return mapping.path;
+        });
+    } catch (std::runtime_error& e) {
+        return nullptr;
+    } catch (std::invalid_argument& e) {
+        return nullptr;
+    }
+}
+
+process_modules::process_modules(pid_t pid, module_cache& cache_):
+    pid_(pid),
+    cache(cache_)
+{
+    refresh();
+}
+
+process_modules::changes process_modules::refresh() {
+    changes c;
+    std::string current = read_process_maps(pid_);
+    if (current == maps) {
+        return c;
+    }
+    maps = std::move(current);
+    std::vector<process_mapping> mappings = parse_process_maps(maps);
+
+    std::vector<module> updated;
+    std::vector<bool> kept(modules_.size());
+    for (size_t i = 0; i < mappings.size();) {
+        const process_mapping& first = mappings[i];
+        //the consecutive mappings of one file (its segments, and the gaps between them) make one module
+        size_t j = i + 1;
+        while (j < mappings.size() && mappings[j].inode == first.inode && mappings[j].device == first.device && mappings[j].path == first.path) {
+            j++;
+        }
+        uint64_t end = mappings[j - 1].end;
+        if (first.inode == 0 || !first.path.starts_with('/')) {
+            i = j;
+            continue;
+        }
+        auto old = std::lower_bound(modules_.begin(), modules_.end(), first.start, [](const module& m, uint64_t start) {
+            return m.start < start;
+        });
+        if (old != modules_.end() && old->start == first.start && old->end == end && old->inode == first.inode && old->device == first.device && old->path == first.path) {
+            kept[old - modules_.begin()] = true;
+            updated.push_back(std::move(*old));
+        } else {
+            std::shared_ptr<loaded_module> files = open_mapping(cache, first, pid_);
+            uint64_t bias = load_bias(files.get(), first);
+            updated.push_back({first.start, end, bias, first.device, first.inode, first.path, std::move(files)});
+            c.added.push_back(first.start);
+        }
+        i = j;
+    }
+    for (size_t i = 0; i < modules_.size(); i++) {
+        if (!kept[i]) {
+            c.removed.push_back(modules_[i].start);
+        }
+    }
+    modules_ = std::move(updated);
+    return c;
+}
+
+std::optional<size_t> process_modules::find_module(uint64_t address) const {
+    auto it = std::upper_bound(modules_.begin(), modules_.end(), address, [](uint64_t address, const module& m) {
+        return address < m.start;
+    });
+    if (it == modules_.begin() || address >= std::prev(it)->end) {
+        return std::nullopt;
+    }
+    return std::prev(it) - modules_.begin();
+}
+
+std::vector<symbolized_frame> process_modules::symbolize(std::span<const uint64_t> addresses) const {
+    std::vector<symbolized_frame> frames;
+    frames.reserve(addresses.size());
+    for (uint64_t address: addresses) {
+        symbolized_frame f;
+        f.address = address;
+        if (std::optional<size_t> i = find_module(address)) {
+            f.module = *i;
+            const module& m = modules_[*i];
+            if (m.files) {
+                dwarfy::symbolize(*m.files, address - m.load_bias, f);
+            }
+        }
+        frames.push_back(std::move(f));
+    }
+    return frames;
+}
+
+}
@@ -0,0 +1,307 @@
+#include "split-dwarf.hh"
+
+#include <unistd.h>
+#include <algorithm>
+
+namespace dwarfy {
+
+using std::to_string;
+
+std::vector<skeleton_unit> find_skeleton_units(const dwarf& d) {
+    std::vector<skeleton_unit> units;
+    for (uint64_t offset: unit_offsets(d.debug_info, d.initial_endianness)) {
+        span_reader r {d.debug_info.subspan(offset)};
+        r.file_endianness = d.initial_endianness;
+        compilation_unit_header cu;
+        r & cu;
+        if (cu.version >= 5 && cu.unit_type != dw_ut::skeleton) {
+            continue;
+        }
+
+        debug_abbrev_entry dae;
+        std::vector<attribute> attributes = d.read_attributes(r, cu, dae);
+        unit_context unit = cu.context;
+        unit.read_bases(attributes);
+        skeleton_unit u;
+        u.offset = offset;
+        u.dwo_id = cu.dwo_id;
+        u.addr_base = unit.addr_base;
+        bool has_dwo_id = cu.version >= 5;
+        for (const attribute& a: attributes) {
+            if (a.name == dw_at::GNU_dwo_id) {
+                u.dwo_id = a.unsigned_value(d.initial_endianness);
+                has_dwo_id = true;
+            }
+        }
+        for (const attribute& a: attributes) {
+            if (a.name == dw_at::dwo_name || a.name == dw_at::GNU_dwo_name) {
+                u.dwo_name = d.read_string(a, unit);
+            } else if (a.name == dw_at::comp_dir) {
+                u.comp_dir = d.read_string(a, unit);
+            }
+        }
+        if (has_dwo_id && !u.dwo_name.empty()) {
+            units.push_back(u);
+        }
+    }
+    return units;
+}
+
+package_index::package_index(std::span<std::byte> section, std::endian endianness_):
+    endianness(endianness_)
+{
+    span_reader r {section};
+    r.file_endianness = endianness;
+    uint16_t first;
+    uint16_t second;
+    r & first & second;
+    if (first == 5) {
+        version = 5;
+    } else {
+        version = endianness == std::endian::little ? first | (second << 16) : (first << 16) | second;
+    }
+    if (version != 2 && version != 5) {
+        throw std::runtime_error("unsupported .dwp index version, expected 2 or 5, got: " + to_string(version));
+    }
+    r & column_count & unit_count & slot_count;
+    if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0) {
+        throw std::runtime_error("bad .dwp index slot count, expected a power of two, got: " + to_string(slot_count));
+    }
+    hashes = r.read_bytes(slot_count * sizeof(uint64_t));
+    indexes = r.read_bytes(slot_count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < column_count; i++) {
+        uint32_t id;
+        r & id;
+        if (version == 2 && id == 5) {
+            columns.push_back(dw_sect::loc);
+        } else if (version == 2 && id == 7) {
+            columns.push_back(dw_sect::macinfo);
+        } else if (version == 2 && id == 8) {
+            columns.push_back(dw_sect::macro);
+        } else if (id >= 1 && id <= 8) {
+            columns.push_back(static_cast<dw_sect>(id));
+        } else {
+            throw std::runtime_error("unknown .dwp index section id: " + to_string(id));
+        }
+    }
+    offsets = r.read_bytes(unit_count * column_count * sizeof(uint32_t));
+    sizes = r.read_bytes(unit_count * column_count * sizeof(uint32_t));
+}
+
+std::optional<package_contribution> package_index::find(uint64_t signature) const {
+    auto read_at = [&]<typename T>(std::span<std::byte> table, size_t i, T v) {
+        span_reader r {table.subspan(i * sizeof(T), sizeof(T))};
+        r.file_endianness = endianness;
+        r & v;
+        return v;
+    };
+    uint64_t mask = slot_count - 1;
+    uint64_t h = signature & mask;
+    uint64_t step = ((signature >> 32) & mask) | 1;
+    for (uint32_t probes = 0; probes < slot_count; probes++, h = (h + step) & mask) {
+        uint32_t row = read_at(indexes, h, uint32_t{});
+        if (row == 0) {
+            return std::nullopt;
+        }
+        if (read_at(hashes, h, uint64_t{}) != signature) {
+            continue;
+        }
+        if (row > unit_count) {
+            throw std::runtime_error("bad .dwp index row: " + to_string(row));
+        }
+        package_contribution c;
+        for (uint32_t column = 0; column < column_count; column++) {
+            size_t i = (row - 1) * column_count + column;
+            c[columns[column]] = {read_at(offsets, i, uint32_t{}), read_at(sizes, i, uint32_t{})};
+        }
+        return c;
+    }
+    return std::nullopt;
+}
+
+namespace {
+
+//owns the mapping behind a split dwarf, handed out through aliasing shared_ptrs
+struct split_file {
+    std::shared_ptr<elfy::mapped_file> file;
+    elfy::elf elf;
+    dwarf d;
+
+    split_file(std::shared_ptr<elfy::mapped_file> file_):
+        file(file_),
+        elf(file->data),
+        d(elf)
+    {}
+    split_file(std::shared_ptr<elfy::mapped_file> file_, const dwarf& d_):
+        file(file_),
+        elf(d_.elf),
+        d(d_)
+    {}
+};
+
+bool file_exists(const std::string& path) {
+    return !path.empty() && access(path.c_str(), R_OK) == 0;
+}
+
+std::span<std::byte> contribution(std::span<std::byte> section, const section_contribution& c) {
+    if (c.size == 0) {
+        return {};
+    }
+    if (c.offset + c.size > section.size()) {
+        throw std::runtime_error("bad .dwp contribution, past the end of its section");
+    }
+    return section.subspan(c.offset, c.size);
+}
+
+//split units have no DW_AT_addr_base of their own, their DW_FORM_addrx indexes count from the
+//skeleton's; handing them the skeleton's .debug_addr from that base on lets them read it from 0
+std::span<std::byte> addresses_from(std::span<std::byte> debug_addr, uint64_t addr_base) {
+    if (addr_base > debug_addr.size()) {
+        throw std::runtime_error("skeleton DW_AT_addr_base past the end of .debug_addr: " + to_string(addr_base));
+    }
+    return debug_addr.subspan(addr_base);
+}
+
+}
+
+split_dwarf::split_dwarf(dwarf& skeleton_, size_t max_open_files_, const std::string& package_path):
+    skeleton(skeleton_),
+    units(find_skeleton_units(skeleton_)),
+    max_open_files(std::max<size_t>(max_open_files_, 1))
+{
+    if (!package_path.empty()) {
+        package_file = std::make_shared<elfy::mapped_file>(package_path);
+        elfy::elf e{package_file->data};
+        package.emplace(e);
+        cu_index = package_index{package->debug_cu_index, package->initial_endianness};
+        if (!package->debug_tu_index.empty()) {
+            tu_index = package_index{package->debug_tu_index, package->initial_endianness};
+        }
+    }
+}
+
+std::optional<size_t> split_dwarf::find_unit(uint64_t offset) const {
+    auto it = std::lower_bound(units.begin(), units.end(), offset, [](const skeleton_unit& u, uint64_t offset) {
+        return u.offset < offset;
+    });
+    if (it == units.end() || it->offset != offset) {
+        return std::nullopt;
+    }
+    return it - units.begin();
+}
+
+std::shared_ptr<dwarf> split_dwarf::cached(const cache_key& key) {
+    std::lock_guard lock{m};
+    for (auto it = lru.begin(); it != lru.end(); ++it) {
+        if (it->key == key) {
+            lru.splice(lru.begin(), lru, it);
+            return it->d;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<dwarf> split_dwarf::insert(cache_key key, std::shared_ptr<dwarf> d) {
+    std::lock_guard lock{m};
+    for (auto it = lru.begin(); it != lru.end(); ++it) {
+        if (it->key == key) {
+            lru.splice(lru.begin(), lru, it);
+            return it->d;
+        }
+    }
+    lru.push_front({std::move(key), std::move(d)});
+    while (lru.size() > max_open_files) {
+        lru.pop_back();
+    }
+    return lru.front().d;
+}
+
+std::shared_ptr<dwarf> split_dwarf::open_dwo(const std::string& path, uint64_t addr_base) {
+    if (std::shared_ptr<dwarf> d = cached({path})) {
+        return d;
+    }
+    //map outside the lock so one slow open doesn't stall lookups of already open files
+    auto f = std::make_shared<split_file>(std::make_shared<elfy::mapped_file>(path));
+    f->d.select_dwo_sections();
+    f->d.debug_addr = addresses_from(skeleton.debug_addr, addr_base);
+    return insert({path}, std::shared_ptr<dwarf>{f, &f->d});
+}
+
+std::shared_ptr<dwarf> split_dwarf::package_unit(const package_contribution& c, std::span<std::byte> debug_addr) {
+    auto f = std::make_shared<split_file>(package_file, *package);
+    dwarf& d = f->d;
+    d.debug_info = contribution(d.debug_info_dwo, c[dw_sect::info]);
+    //DWARF 4 packages keep type units in .debug_types.dwo
+    d.debug_types = contribution(d.debug_types_dwo, c[dw_sect::types]);
+    d.debug_abbrev = contribution(d.debug_abbrev_dwo, c[dw_sect::abbrev]);
+    d.debug_line = contribution(d.debug_line_dwo, c[dw_sect::line]);
+    d.debug_loclists = contribution(d.debug_loclists_dwo, c[dw_sect::loclists]);
+    d.debug_rnglists = contribution(d.debug_rnglists_dwo, c[dw_sect::rnglists]);
+    d.debug_macro = contribution(d.debug_macro_dwo, c[dw_sect::macro]);
+    //sliced, so the unit's str_offsets_base counts from its DW_SECT_STR_OFFSETS contribution
+    d.debug_str_offsets = contribution(d.debug_str_offsets_dwo, c[dw_sect::str_offsets]);
+    d.debug_str = d.debug_str_dwo;
+    d.debug_addr = debug_addr;
+    d.reset_cache();
+    return std::shared_ptr<dwarf>{f, &f->d};
+}
+
+std::shared_ptr<dwarf> split_dwarf::unit(size_t i) {
+    const skeleton_unit& u = units.at(i);
+
+    if (package) {
+        if (std::shared_ptr<dwarf> d = cached({"", u.dwo_id})) {
+            return d;
+        }
+        if (auto c = cu_index.find(u.dwo_id)) {
+            return insert({"", u.dwo_id}, package_unit(*c, addresses_from(skeleton.debug_addr, u.addr_base)));
+        }
+    }
+
+    std::vector<std::string> candidates;
+    if (u.dwo_name.starts_with("/")) {
+        candidates.push_back(u.dwo_name);
+    } else {
+        if (!u.comp_dir.empty()) {
+            candidates.push_back(u.comp_dir + "/" + u.dwo_name);
+        }
+        candidates.push_back(u.dwo_name);
+    }
+    std::string basename = u.dwo_name.substr(u.dwo_name.find_last_of('/') + 1);
+    for (const std::string& dir: search_paths) {
+        candidates.push_back(dir + "/" + u.dwo_name);
+        candidates.push_back(dir + "/" + basename);
+    }
+    for (const std::string& path: candidates) {
+        if (file_exists(path)) {
+            return open_dwo(path, u.addr_base);
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<dwarf> split_dwarf::type_unit(uint64_t signature) {
+    if (!package) {
+        return nullptr;
+    }
+    if (std::shared_ptr<dwarf> d = cached({"", signature, true})) {
+        return d;
+    }
+    std::optional<package_contribution> c = tu_index.slot_count ? tu_index.find(signature) : std::nullopt;
+    if (!c) {
+        return nullptr;
+    }
+    //shared by every unit that refers to it, so there's no one skeleton's addr_base to give it
+    return insert({"", signature, true}, package_unit(*c, {}));
+}
+
+size_t split_dwarf::open_files() {
+    std::lock_guard lock{m};
+    //package units all share the one package mapping
+    size_t dwo_files = std::count_if(lru.begin(), lru.end(), [](const cached_dwo& c) {
+        return !c.key.path.empty();
+    });
+    return dwo_files + (package_file ? 1 : 0);
+}
+
+}
@@ -0,0 +1,109 @@
+#include "stats.hh"
+
+#include <sstream>
+#include <thread>
+
+namespace dwarfy {
+
+using std::to_string;
+
+std::string to_string(phase p) {
+    switch (p) {
+        case phase::section_lookup: return "section_lookup";
+        case phase::decompression: return "decompression";
+        case phase::abbrev_decode: return "abbrev_decode";
+        case phase::die_walk: return "die_walk";
+        case phase::line_program: return "line_program";
+        default: return "unknown phase: " + to_string(static_cast<uint64_t>(p));
+    }
+}
+
+std::string to_string(stats_section s) {
+    switch (s) {
+        case stats_section::info: return ".debug_info";
+        case stats_section::abbrev: return ".debug_abbrev";
+        case stats_section::str: return ".debug_str";
+        case stats_section::str_offsets: return ".debug_str_offsets";
+        case stats_section::line: return ".debug_line";
+        default: return "unknown section: " + to_string(static_cast<uint64_t>(s));
+    }
+}
+
+double nanoseconds_per_tick() {
+    static const double ratio = []() {
+#if defined(__x86_64__) || defined(__i386__)
+        auto start = std::chrono::steady_clock::now();
+        uint64_t start_ticks = stats_ticks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        uint64_t ticks = stats_ticks() - start_ticks;
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        return ticks ? ns / ticks : 1.0;
+#else
+        return 1.0;
+#endif
+    }();
+    return ratio;
+}
+
+#if DWARFY_STATS
+dwarf_counters dwarf_stats::counters() const {
+    //read back through atomic_ref too, so a snapshot taken while other threads decode isn't a race
+    auto load = [](const uint64_t& counter) {
+        return std::atomic_ref{const_cast<uint64_t&>(counter)}.load(std::memory_order_relaxed);
+    };
+    dwarf_counters snapshot;
+    snapshot.dies_decoded = load(c.dies_decoded);
+    snapshot.abbrev_hits = load(c.abbrev_hits);
+    snapshot.abbrev_misses = load(c.abbrev_misses);
+    snapshot.leb128_bytes = load(c.leb128_bytes);
+    for (size_t i = 0; i < c.section_bytes.size(); i++) {
+        snapshot.section_bytes[i] = load(c.section_bytes[i]);
+    }
+    for (size_t i = 0; i < c.forms.size(); i++) {
+        snapshot.forms[i] = load(c.forms[i]);
+    }
+    for (size_t i = 0; i < c.phases.size(); i++) {
+        snapshot.phases[i].calls = load(c.phases[i].calls);
+        if (snapshot.phases[i].calls) {
+            snapshot.phases[i].nanoseconds = load(ticks[i]) * nanoseconds_per_tick();
+        }
+    }
+    return snapshot;
+}
+#endif
+
+std::string dwarf_counters::to_json() const {
+    std::stringstream out;
+    out << "{\n";
+    out << "  \"enabled\": " << (enabled ? "true" : "false") << ",\n";
+    out << "  \"dies_decoded\": " << dies_decoded << ",\n";
+    out << "  \"abbrev_hits\": " << abbrev_hits << ",\n";
+    out << "  \"abbrev_misses\": " << abbrev_misses << ",\n";
+    out << "  \"leb128_bytes\": " << leb128_bytes << ",\n";
+    out << "  \"section_bytes\": {";
+    for (size_t i = 0; i < section_bytes.size(); i++) {
+        out << (i ? ", " : "") << "\"" << to_string(static_cast<stats_section>(i)) << "\": " << section_bytes[i];
+    }
+    out << "},\n";
+    out << "  \"forms\": {";
+    bool first = true;
+    for (size_t i = 0; i < forms.size(); i++) {
+        if (forms[i] == 0) {
+            continue;
+        }
+        dw_form form = static_cast<dw_form>(i < 0x40 ? i : 0x1f00 + (i - 0x40));
+        std::string_view name = to_string_view(form);
+        out << (first ? "" : ", ") << "\"" << (name.empty() ? "other" : name) << "\": " << forms[i];
+        first = false;
+    }
+    out << "},\n";
+    out << "  \"phases\": {";
+    for (size_t i = 0; i < phases.size(); i++) {
+        out << (i ? ", " : "") << "\"" << to_string(static_cast<phase>(i)) << "\": {\"calls\": " << phases[i].calls << ", \"ns\": " << phases[i].nanoseconds << "}";
+    }
+    out << "}\n";
+    out << "}\n";
+    return out.str();
+}
+
+}
@@ -0,0 +1,56 @@
+#include "string-pool.hh"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace dwarfy {
+
+string_pool::string_pool() {
+    pages[0] = std::make_unique<std::string_view[]>(page_size);
+    indexes.emplace(std::string_view{}, 0);
+    count = 1;
+}
+
+//strings over a quarter of a block get their own allocation rather than wasting the rest of one
+std::string_view string_pool::store(std::string_view s) {
+    char* p;
+    if (s.size() > block_size / 4) {
+        large.push_back(std::make_unique<char[]>(s.size()));
+        p = large.back().get();
+    } else {
+        if (block_used + s.size() > block_size) {
+            blocks.push_back(std::make_unique<char[]>(block_size));
+            block_used = 0;
+        }
+        p = blocks.back().get() + block_used;
+        block_used += s.size();
+    }
+    std::memcpy(p, s.data(), s.size());
+    return {p, s.size()};
+}
+
+uint32_t string_pool::intern(std::string_view s) {
+    std::lock_guard lock{m};
+    auto it = indexes.find(s);
+    if (it != indexes.end()) {
+        return it->second;
+    }
+    if (count == page_size * max_pages) {
+        throw std::runtime_error("string pool full, " + std::to_string(count) + " strings");
+    }
+    if (count % page_size == 0) {
+        pages[count / page_size] = std::make_unique<std::string_view[]>(page_size);
+    }
+    std::string_view stored = store(s);
+    uint32_t index = count++;
+    pages[index / page_size][index % page_size] = stored;
+    indexes.emplace(stored, index);
+    return index;
+}
+
+size_t string_pool::size() {
+    std::lock_guard lock{m};
+    return count;
+}
+
+}
@@ -0,0 +1,134 @@
+#include "symbol-cache.hh"
+
+#include <bit>
+
+namespace dwarfy {
+
+cached_frame resolve_frame(loaded_module& m, uint64_t pc, string_pool& strings) {
+    cached_frame frame;
+    symbolized_frame f;
+    if (symbolize(m, pc, f)) {
+        frame.function = strings.intern(f.function);
+        frame.offset = f.offset;
+    }
+    if (std::optional<line_location> l = module_lines(m).find(pc)) {
+        frame.file = strings.intern(l->file);
+        frame.line = l->line;
+    }
+    return frame;
+}
+
+symbol_cache::symbol_cache(size_t capacity, size_t shard_count):
+    shards(std::bit_ceil(std::max<size_t>(shard_count, 1))),
+    //a power of two per shard, with room for capacity entries below the eviction threshold
+    slots_per_shard(std::bit_ceil(std::max<size_t>(capacity * 4 / 3 / shards.size(), 16)))
+{
+    for (shard& s: shards) {
+        s.slots.resize(slots_per_shard);
+    }
+}
+
+//splitmix64's finalizer over both halves of the key, the top bits pick the shard and the bottom ones the slot
+uint64_t symbol_cache::hash(uint64_t module, uint64_t pc) {
+    uint64_t h = pc ^ module * 0x9e3779b97f4a7c15;
+    h = (h ^ h >> 30) * 0xbf58476d1ce4e5b9;
+    h = (h ^ h >> 27) * 0x94d049bb133111eb;
+    return h ^ h >> 31;
+}
+
+bool symbol_cache::find(shard& s, uint64_t h, uint64_t module, uint64_t pc, cached_frame& frame) {
+    size_t mask = s.slots.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+        slot& e = s.slots[i];
+        if (e.module == 0) {
+            return false;
+        }
+        if (e.module == module && e.pc == pc) {
+            e.referenced = true;
+            frame = e.frame;
+            return true;
+        }
+    }
+}
+
+//removes the first unreferenced entry from the hand on, then closes the gap by shifting back the
+//entries after it that probed past it, so lookups never need tombstones
+void symbol_cache::evict(shard& s) {
+    size_t mask = s.slots.size() - 1;
+    while (true) {
+        slot& e = s.slots[s.hand];
+        if (e.module != 0 && !e.referenced) {
+            break;
+        }
+        e.referenced = false;
+        s.hand = (s.hand + 1) & mask;
+    }
+    size_t hole = s.hand;
+    s.slots[hole].module = 0;
+    s.used--;
+    s.stats.evictions++;
+    for (size_t i = (hole + 1) & mask; s.slots[i].module != 0; i = (i + 1) & mask) {
+        size_t home = hash(s.slots[i].module, s.slots[i].pc) & mask;
+        //whether home is cyclically outside (hole, i], so the entry can move back into the hole
+        bool movable = hole <= i ? home <= hole || home > i : home <= hole && home > i;
+        if (movable) {
+            s.slots[hole] = s.slots[i];
+            s.slots[i].module = 0;
+            hole = i;
+        }
+    }
+}
+
+void symbol_cache::insert(shard& s, uint64_t h, uint64_t module, uint64_t pc, const cached_frame& frame) {
+    if (s.used >= s.slots.size() / 4 * 3) {
+        evict(s);
+    }
+    size_t mask = s.slots.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+        slot& e = s.slots[i];
+        if (e.module == module && e.pc == pc) {
+            //another thread resolved it between our miss and now
+            return;
+        }
+        if (e.module == 0) {
+            e = {module, pc, frame, false};
+            s.used++;
+            return;
+        }
+    }
+}
+
+cached_frame symbol_cache::resolve(loaded_module& m, uint64_t pc) {
+    uint64_t h = hash(m.id, pc);
+    shard& s = shards[h >> 32 & (shards.size() - 1)];
+    cached_frame frame;
+    {
+        std::lock_guard lock{s.m};
+        if (find(s, h, m.id, pc, frame)) {
+            s.stats.hits++;
+            return frame;
+        }
+        s.stats.misses++;
+    }
+    //resolve outside the lock, decoding a line table can take a while
+    bool indexed = m.functions.load(std::memory_order_acquire) != nullptr;
+    frame = resolve_frame(m, pc, strings);
+    if (indexed) {
+        std::lock_guard lock{s.m};
+        insert(s, h, m.id, pc, frame);
+    }
+    return frame;
+}
+
+symbol_cache_stats symbol_cache::stats() {
+    symbol_cache_stats total;
+    for (shard& s: shards) {
+        std::lock_guard lock{s.m};
+        total.hits += s.stats.hits;
+        total.misses += s.stats.misses;
+        total.evictions += s.stats.evictions;
+    }
+    return total;
+}
+
+}
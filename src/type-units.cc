@@ -0,0 +1,142 @@
+#include "type-units.hh"
+#include "dwarfy.hh"
+#include "parallel.hh"
+
+#include <algorithm>
+#include <bit>
+
+namespace dwarfy {
+
+signature_map::signature_map():
+    slots(1),
+    occupied(1),
+    mask(0),
+    count(0)
+{}
+
+signature_map::signature_map(std::span<const type_unit_entry> entries) {
+    //keep the load factor at or below a half so probe sequences stay short
+    size_t capacity = std::bit_ceil(std::max<size_t>(entries.size() * 2, 1));
+    slots.resize(capacity);
+    occupied.resize(capacity);
+    mask = capacity - 1;
+    count = 0;
+    for (const type_unit_entry& e: entries) {
+        insert(e);
+    }
+}
+
+void signature_map::insert(const type_unit_entry& entry) {
+    if ((count + 1) * 2 > slots.size()) {
+        std::vector<type_unit_entry> old;
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (occupied[i]) {
+                old.push_back(slots[i]);
+            }
+        }
+        old.push_back(entry);
+        *this = signature_map{old};
+        return;
+    }
+    for (size_t i = slot(entry.signature);; i = (i + 1) & mask) {
+        if (!occupied[i]) {
+            slots[i] = entry;
+            occupied[i] = true;
+            count++;
+            return;
+        }
+        if (slots[i].signature == entry.signature) {
+            //duplicate type units (from COMDAT or several CUs) describe the same type, keep the first
+            return;
+        }
+    }
+}
+
+const type_unit_entry* signature_map::find(uint64_t signature) const {
+    for (size_t i = slot(signature);; i = (i + 1) & mask) {
+        if (!occupied[i]) {
+            return nullptr;
+        }
+        if (slots[i].signature == signature) {
+            return &slots[i];
+        }
+    }
+}
+
+std::vector<uint64_t> unit_offsets(std::span<std::byte> section, std::endian endianness) {
+    std::vector<uint64_t> offsets;
+    uint64_t offset = 0;
+    while (offset < section.size()) {
+        span_reader r {section.subspan(offset)};
+        r.file_endianness = endianness;
+        initial_length length;
+        r & length;
+        offsets.push_back(offset);
+        offset += length + length.size();
+    }
+    return offsets;
+}
+
+unit_index::unit_index(std::span<std::byte> section, std::endian endianness):
+    starts(unit_offsets(section, endianness)),
+    section_size(section.size())
+{}
+
+std::optional<uint64_t> unit_index::unit_containing(uint64_t offset) const {
+    if (offset >= section_size) {
+        return std::nullopt;
+    }
+    auto it = std::upper_bound(starts.begin(), starts.end(), offset);
+    if (it == starts.begin()) {
+        return std::nullopt;
+    }
+    return *std::prev(it);
+}
+
+signature_map scan_type_units(const dwarf& d) {
+    struct unit {
+        unit_section section;
+        uint64_t offset;
+    };
+    std::vector<unit> units;
+    for (uint64_t offset: unit_offsets(d.debug_info, d.initial_endianness)) {
+        units.push_back({unit_section::debug_info, offset});
+    }
+    for (uint64_t offset: unit_offsets(d.debug_types, d.initial_endianness)) {
+        units.push_back({unit_section::debug_types, offset});
+    }
+
+    std::vector<type_unit_entry> entries(units.size());
+    std::vector<uint8_t> is_type_unit(units.size());
+    parallel_for(units.size(), 1024, 0, [&](unsigned worker, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const unit& u = units[i];
+            std::span<std::byte> section = u.section == unit_section::debug_info ? d.debug_info : d.debug_types;
+            span_reader r {section.subspan(u.offset)};
+            r.file_endianness = d.initial_endianness;
+            if (u.section == unit_section::debug_types) {
+                type_unit_header tu;
+                r & tu;
+                entries[i] = {tu.type_signature, u.section, u.offset, u.offset + tu.type_offset};
+                is_type_unit[i] = true;
+            } else {
+                compilation_unit_header cu;
+                r & cu;
+                if (cu.version >= 5 && (cu.unit_type == dw_ut::type || cu.unit_type == dw_ut::split_type)) {
+                    entries[i] = {cu.type_signature, u.section, u.offset, u.offset + cu.type_offset};
+                    is_type_unit[i] = true;
+                }
+            }
+        }
+    });
+
+    std::vector<type_unit_entry> type_units;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (is_type_unit[i]) {
+            type_units.push_back(entries[i]);
+        }
+    }
+    return signature_map{type_units};
+}
+
+}
@@ -0,0 +1,216 @@
+#include "unwind.hh"
+#include "parallel.hh"
+
+#include <cstring>
+
+namespace dwarfy {
+
+using std::to_string;
+
+uint16_t stack_pointer_register(uint16_t elf_machine) {
+    switch (elf_machine) {
+        case 3: //EM_386
+            return 4;
+        case 40: //EM_ARM
+            return 13;
+        case 62: //EM_X86_64
+            return 7;
+        case 183: //EM_AARCH64
+            return 31;
+        case 243: //EM_RISCV
+            return 2;
+        default:
+            throw std::runtime_error("don't know the DWARF stack pointer register for ELF machine: " + to_string(elf_machine));
+    }
+}
+
+unwinder::unwinder(const unwind_table& table_, const elfy::elf& elf):
+    unwinder(table_, stack_pointer_register(elf.machine()))
+{
+    address_size = elf.ident.bitwidth();
+    endianness = elf.ident.endianness();
+}
+
+const unwind_location* unwinder::find(uint64_t pc, unwind_cache& cache) const {
+    auto& e = cache.entries[(pc ^ (pc >> 12)) & (unwind_cache::size - 1)];
+    if (e.pc != pc) {
+        cache.misses++;
+        e.pc = pc;
+        e.location = table.find(pc).value_or(unwind_location{nullptr, nullptr, {}});
+    } else {
+        cache.hits++;
+    }
+    if (e.location.row == nullptr) {
+        return nullptr;
+    }
+    return &e.location;
+}
+
+size_t unwinder::unwind(const stack_sample& sample, std::span<uint64_t> out, unwind_cache& cache) const {
+    register_set regs = sample.regs;
+    auto load_sized = [&](uint64_t address, size_t size) -> std::optional<uint64_t> {
+        uint64_t value = 0;
+        if (size > sizeof(value) || address < sample.stack_address || address - sample.stack_address + size > sample.stack.size()) {
+            return std::nullopt;
+        }
+        std::memcpy(&value, sample.stack.data() + (address - sample.stack_address), size);
+        return value;
+    };
+    auto load = [&](uint64_t address, uint64_t& value) {
+        std::optional<uint64_t> v = load_sized(address, sizeof(value));
+        value = v.value_or(0);
+        return v.has_value();
+    };
+    //the frame being unwound, for the context's register reads
+    const unwind_location* l = nullptr;
+    //set up once per sample, the callbacks read regs and l as the frames go by
+    expression_context context;
+    context.address_size = address_size;
+    context.endianness = endianness;
+    context.read_register = [&](uint16_t reg) -> std::optional<uint64_t> {
+        if (regs.has(reg)) {
+            return regs.regs[reg];
+        }
+        //the return address column stands for the pc when it isn't a real register (x86's rip)
+        if (reg == l->fde->return_address_register) {
+            return regs.pc;
+        }
+        return std::nullopt;
+    };
+    context.read_memory = load_sized;
+    //DW_CFA_def_cfa_expression, DW_CFA_expression and DW_CFA_val_expression, compiled when the table
+    //was built; nullopt when the expression needs a register or memory the sample doesn't have
+    auto evaluate = [&](uint32_t compiled, std::optional<uint64_t> cfa) -> std::optional<uint64_t> {
+        context.cfa = cfa.value_or(0);
+        context.initial_value = cfa;
+        try {
+            location result = evaluate_expression(table.expressions[compiled], context);
+            if (result.size() != 1 || (result[0].kind != location_kind::memory && result[0].kind != location_kind::value)) {
+                return std::nullopt;
+            }
+            return result[0].value;
+        } catch (std::runtime_error&) {
+            return std::nullopt;
+        }
+    };
+
+    size_t depth = 0;
+    bool exact_pc = true;
+    while (depth < out.size()) {
+        out[depth++] = regs.pc;
+        //a return address points after the call, which might be the first byte of the next function
+        uint64_t lookup = regs.pc - load_bias - (exact_pc ? 0 : 1);
+        l = find(lookup, cache);
+        if (!l) {
+            break;
+        }
+
+        const cfa_rule& cfa_rule = l->row->cfa;
+        uint64_t cfa;
+        if (cfa_rule.kind == cfa_rule_kind::register_offset && regs.has(cfa_rule.reg)) {
+            cfa = regs.regs[cfa_rule.reg] + cfa_rule.offset;
+        } else if (cfa_rule.kind == cfa_rule_kind::expression) {
+            //x86-64 PLT entries, among others
+            std::optional<uint64_t> v = evaluate(cfa_rule.compiled, std::nullopt);
+            if (!v) {
+                break;
+            }
+            cfa = *v;
+        } else {
+            break;
+        }
+
+        register_set caller = regs;
+        uint16_t ra = l->fde->return_address_register;
+        if (ra < max_unwind_registers) {
+            //the return address column usually isn't a real register, no rule means no value
+            caller.valid &= ~(1ULL << ra);
+        }
+        for (const register_rule& rule: l->rules) {
+            if (rule.reg >= max_unwind_registers) {
+                continue;
+            }
+            uint64_t bit = 1ULL << rule.reg;
+            switch (rule.kind) {
+                case register_rule_kind::undefined:
+                    caller.valid &= ~bit;
+                    break;
+                case register_rule_kind::same_value:
+                    caller.valid = (caller.valid & ~bit) | (regs.valid & bit);
+                    caller.regs[rule.reg] = regs.regs[rule.reg];
+                    break;
+                case register_rule_kind::offset:
+                    {
+                        uint64_t value;
+                        if (load(cfa + rule.value, value)) {
+                            caller.set(rule.reg, value);
+                        } else {
+                            caller.valid &= ~bit;
+                        }
+                        break;
+                    }
+                case register_rule_kind::val_offset:
+                    caller.set(rule.reg, cfa + rule.value);
+                    break;
+                case register_rule_kind::register_:
+                    if (regs.has(rule.value)) {
+                        caller.set(rule.reg, regs.regs[rule.value]);
+                    } else {
+                        caller.valid &= ~bit;
+                    }
+                    break;
+                case register_rule_kind::expression:
+                    {
+                        //the expression gives the address the register was saved at
+                        std::optional<uint64_t> address = evaluate(rule.compiled, cfa);
+                        std::optional<uint64_t> value = address ? load_sized(*address, address_size) : std::nullopt;
+                        if (value) {
+                            caller.set(rule.reg, *value);
+                        } else {
+                            caller.valid &= ~bit;
+                        }
+                        break;
+                    }
+                case register_rule_kind::val_expression:
+                    if (std::optional<uint64_t> value = evaluate(rule.compiled, cfa)) {
+                        caller.set(rule.reg, *value);
+                    } else {
+                        caller.valid &= ~bit;
+                    }
+                    break;
+            }
+        }
+        if (!caller.has(ra) || caller.regs[ra] == 0) {
+            break;
+        }
+        //stacks grow down, a caller's CFA below ours means we've gone wrong somewhere
+        if (regs.has(sp_register) && cfa <= regs.regs[sp_register] && !l->fde->signal_frame) {
+            break;
+        }
+        caller.pc = caller.regs[ra];
+        caller.set(sp_register, cfa);
+        exact_pc = l->fde->signal_frame;
+        regs = caller;
+    }
+    return depth;
+}
+
+unwound_stacks unwinder::unwind(std::span<const stack_sample> samples) const {
+    unwound_stacks result;
+    result.max_frames = max_frames;
+    result.pcs.resize(samples.size() * max_frames);
+    result.depths.resize(samples.size());
+
+    unsigned workers = parallel_threads(threads);
+    std::vector<unwind_cache> caches(workers);
+    parallel_for(samples.size(), 256, workers, [&](unsigned worker, size_t begin, size_t end) {
+        unwind_cache& cache = caches[worker];
+        for (size_t i = begin; i < end; i++) {
+            std::span<uint64_t> out = std::span{result.pcs}.subspan(i * max_frames, max_frames);
+            result.depths[i] = unwind(samples[i], out, cache);
+        }
+    });
+    return result;
+}
+
+}
@@ -0,0 +1,169 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+#include "elfy.hh"
+#include "mapped-file.hh"
+#include "symbolizer-protocol.hh"
+
+//load generator for the symbolizer daemon
+//each client sends batches of addresses from the module's own function symbols, one request in flight
+//at a time, and times the round trip
+
+namespace {
+
+int connect_to(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), std::min(path.size() + 1, sizeof(addr.sun_path) - 1));
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        throw std::runtime_error(path + ": " + strerror(errno));
+    }
+    return fd;
+}
+
+void write_all(int fd, std::span<const std::byte> data) {
+    while (!data.empty()) {
+        ssize_t n = write(fd, data.data(), data.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("write: "s + strerror(errno));
+        }
+        data = data.subspan(n);
+    }
+}
+
+void read_response(int fd, std::vector<std::byte>& buffer, dwarfy::protocol::response& res) {
+    while (true) {
+        std::span<std::byte> payload = dwarfy::protocol::next_message(buffer);
+        if (!payload.empty()) {
+            dwarfy::protocol::decode(payload, res);
+            buffer.erase(buffer.begin(), buffer.begin() + sizeof(uint32_t) + payload.size());
+            return;
+        }
+        std::byte chunk[64 * 1024];
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("connection closed by the symbolizer");
+        }
+        buffer.insert(buffer.end(), chunk, chunk + n);
+    }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s SOCKET MODULE [CLIENTS] [REQUESTS_PER_CLIENT] [ADDRESSES_PER_REQUEST]\n", argv[0]);
+        return 1;
+    }
+    std::string socket_path = argv[1];
+    std::string module = argv[2];
+    unsigned clients = argc > 3 ? atoi(argv[3]) : 8;
+    size_t requests = argc > 4 ? atoi(argv[4]) : 1000;
+    size_t batch = argc > 5 ? atoi(argv[5]) : 64;
+
+    std::vector<uint64_t> functions;
+    try {
+        elfy::mapped_file mf{module};
+        elfy::elf e{mf.data};
+        std::vector<elfy::symbol> symbols = e.symbols(".symtab");
+        if (symbols.empty()) {
+            symbols = e.symbols(".dynsym");
+        }
+        for (const elfy::symbol& s: symbols) {
+            if (s.is_function() && s.shndx != 0 && s.size > 0) {
+                functions.push_back(s.value + s.size / 2);
+            }
+        }
+    } catch (std::runtime_error &e) {
+        fprintf(stderr, "error reading module '%s': %s\n", module.c_str(), e.what());
+        return 1;
+    }
+    if (functions.empty()) {
+        fprintf(stderr, "module '%s' has no function symbols to ask about\n", module.c_str());
+        return 1;
+    }
+
+    std::vector<std::vector<double>> latencies(clients);
+    std::vector<size_t> resolved(clients);
+    std::vector<std::string> errors(clients);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned c = 0; c < clients; c++) {
+        threads.emplace_back([&, c]() {
+            try {
+                int fd = connect_to(socket_path);
+                std::mt19937_64 rng{c};
+                std::uniform_int_distribution<size_t> pick{0, functions.size() - 1};
+                std::vector<std::byte> out;
+                std::vector<std::byte> in;
+                dwarfy::protocol::request req {0, module, 0, std::vector<uint64_t>(batch)};
+                dwarfy::protocol::response res;
+                latencies[c].reserve(requests);
+                for (size_t r = 0; r < requests; r++) {
+                    req.id = r;
+                    for (uint64_t& a: req.addresses) {
+                        a = functions[pick(rng)];
+                    }
+                    out.clear();
+                    dwarfy::protocol::encode(req, out);
+                    auto t0 = std::chrono::steady_clock::now();
+                    write_all(fd, out);
+                    read_response(fd, in, res);
+                    auto t1 = std::chrono::steady_clock::now();
+                    latencies[c].push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+                    if (res.id != req.id) {
+                        throw std::runtime_error("response id mismatch");
+                    }
+                    for (const dwarfy::protocol::frame& f: res.frames) {
+                        resolved[c] += f.resolved;
+                    }
+                }
+                close(fd);
+            } catch (std::runtime_error& e) {
+                errors[c] = e.what();
+            }
+        });
+    }
+    for (std::thread& t: threads) {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (unsigned c = 0; c < clients; c++) {
+        if (!errors[c].empty()) {
+            fprintf(stderr, "client %u failed: %s\n", c, errors[c].c_str());
+            return 1;
+        }
+    }
+    std::vector<double> all;
+    size_t total_resolved = 0;
+    for (unsigned c = 0; c < clients; c++) {
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        total_resolved += resolved[c];
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) {
+        return all.empty() ? 0.0 : all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))];
+    };
+    size_t addresses = all.size() * batch;
+    printf("%u clients, %zu requests of %zu addresses\n", clients, all.size(), batch);
+    printf("throughput: %.0f requests/s, %.0f addresses/s\n", all.size() / seconds, addresses / seconds);
+    printf("latency: p50 %.1fus, p99 %.1fus, max %.1fus\n", percentile(0.50), percentile(0.99), all.empty() ? 0.0 : all.back());
+    printf("resolved: %zu/%zu\n", total_resolved, addresses);
+    return 0;
+}
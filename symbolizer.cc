@@ -0,0 +1,373 @@
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <cstdio>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "module-set.hh"
+#include "symbolizer-protocol.hh"
+
+//long running symbolizer, keeps modules mapped and indexed between clients
+//clients send batches of addresses for one module over a Unix socket (see symbolizer-protocol.hh);
+//an epoll loop does all socket io and hands complete requests to a pool of workers
+//responses on a connection may come back in a different order to its requests, match them by id
+
+namespace {
+
+struct connection {
+    int fd;
+    std::vector<std::byte> in;
+    std::vector<std::byte> out;
+    size_t written = 0;
+    //requests handed to the workers whose responses haven't been queued on out yet
+    size_t pending = 0;
+    //the client shut down its side, the connection stays open until its responses are written
+    bool eof = false;
+};
+
+struct job {
+    uint64_t connection;
+    dwarfy::protocol::request request;
+};
+
+struct completion {
+    uint64_t connection;
+    std::vector<std::byte> message;
+};
+
+class server {
+    int listen_fd;
+    int epoll_fd;
+    //workers signal finished jobs through this
+    int event_fd;
+
+    std::unordered_map<uint64_t, connection> connections;
+    uint64_t next_connection = 1;
+
+    std::mutex jobs_m;
+    std::condition_variable jobs_cv;
+    std::deque<job> jobs;
+    bool stopping = false;
+
+    std::mutex completions_m;
+    std::vector<completion> completions;
+
+    std::vector<std::thread> workers;
+    //by path, opened and indexed by whichever worker asks first
+    dwarfy::module_cache modules;
+
+    void add(int fd, uint64_t key, uint32_t events) {
+        epoll_event ev {};
+        ev.events = events;
+        ev.data.u64 = key;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            throw std::runtime_error("epoll_ctl: "s + strerror(errno));
+        }
+    }
+    void modify(int fd, uint64_t key, uint32_t events) {
+        epoll_event ev {};
+        ev.events = events;
+        ev.data.u64 = key;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    }
+
+    static uint32_t interest(const connection& c) {
+        uint32_t events = c.eof ? 0 : EPOLLIN | EPOLLRDHUP;
+        return c.written < c.out.size() ? events | EPOLLOUT : events;
+    }
+    static bool finished(const connection& c) {
+        return c.eof && c.pending == 0 && c.out.empty();
+    }
+
+    void close_connection(uint64_t key) {
+        auto it = connections.find(key);
+        if (it != connections.end()) {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+            close(it->second.fd);
+            connections.erase(it);
+        }
+    }
+
+    void accept_all() {
+        while (true) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            uint64_t key = next_connection++;
+            connections.emplace(key, connection{fd, {}, {}, 0, 0, false});
+            add(fd, key, EPOLLIN | EPOLLRDHUP);
+        }
+    }
+
+    void read_from(uint64_t key) {
+        connection& c = connections.at(key);
+        std::byte buffer[64 * 1024];
+        while (true) {
+            ssize_t n = read(c.fd, buffer, sizeof(buffer));
+            if (n > 0) {
+                c.in.insert(c.in.end(), buffer, buffer + n);
+                continue;
+            }
+            if (n == 0) {
+                //a half-close: answer what was already sent before closing
+                c.eof = true;
+                break;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                close_connection(key);
+                return;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        size_t consumed = 0;
+        try {
+            std::span<std::byte> payload;
+            while (!(payload = dwarfy::protocol::next_message(std::span{c.in}.subspan(consumed))).empty()) {
+                job j {key, {}};
+                dwarfy::protocol::decode(payload, j.request);
+                consumed += sizeof(uint32_t) + payload.size();
+                c.pending++;
+                {
+                    std::lock_guard lock{jobs_m};
+                    jobs.push_back(std::move(j));
+                }
+                jobs_cv.notify_one();
+            }
+        } catch (std::runtime_error& e) {
+            fprintf(stderr, "dropping client: %s\n", e.what());
+            close_connection(key);
+            return;
+        }
+        c.in.erase(c.in.begin(), c.in.begin() + consumed);
+        if (c.eof) {
+            //a partial request left in c.in will never be completed
+            if (finished(c)) {
+                close_connection(key);
+            } else {
+                modify(c.fd, key, interest(c));
+            }
+        }
+    }
+
+    void write_to(uint64_t key) {
+        auto it = connections.find(key);
+        if (it == connections.end()) {
+            return;
+        }
+        connection& c = it->second;
+        while (c.written < c.out.size()) {
+            ssize_t n = write(c.fd, c.out.data() + c.written, c.out.size() - c.written);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    close_connection(key);
+                    return;
+                }
+                break;
+            }
+            c.written += n;
+        }
+        if (c.written == c.out.size()) {
+            c.out.clear();
+            c.written = 0;
+        }
+        if (finished(c)) {
+            close_connection(key);
+        } else {
+            modify(c.fd, key, interest(c));
+        }
+    }
+
+    void drain_completions() {
+        uint64_t count;
+        while (read(event_fd, &count, sizeof(count)) > 0) {
+        }
+        std::vector<completion> done;
+        {
+            std::lock_guard lock{completions_m};
+            done.swap(completions);
+        }
+        for (completion& c: done) {
+            //the client may have gone away while its request was being worked on
+            auto it = connections.find(c.connection);
+            if (it == connections.end()) {
+                continue;
+            }
+            it->second.pending--;
+            it->second.out.insert(it->second.out.end(), c.message.begin(), c.message.end());
+            write_to(c.connection);
+        }
+    }
+
+    void work() {
+        while (true) {
+            job j;
+            {
+                std::unique_lock lock{jobs_m};
+                jobs_cv.wait(lock, [&]() {
+                    return stopping || !jobs.empty();
+                });
+                if (stopping) {
+                    return;
+                }
+                j = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            dwarfy::protocol::response res;
+            res.id = j.request.id;
+            res.frames.resize(j.request.addresses.size());
+            std::shared_ptr<dwarfy::loaded_module> m;
+            try {
+                m = modules.get(j.request.module);
+            } catch (std::exception& e) {
+                fprintf(stderr, "can't open module '%s': %s\n", j.request.module.c_str(), e.what());
+            }
+            for (size_t i = 0; m && i < j.request.addresses.size(); i++) {
+                dwarfy::symbolized_frame f;
+                dwarfy::protocol::frame& out = res.frames[i];
+                out.resolved = dwarfy::symbolize(*m, j.request.addresses[i] - j.request.load_bias, f);
+                out.offset = f.offset;
+                out.function = std::move(f.function);
+            }
+
+            completion c {j.connection, {}};
+            dwarfy::protocol::encode(res, c.message);
+            {
+                std::lock_guard lock{completions_m};
+                completions.push_back(std::move(c));
+            }
+            uint64_t one = 1;
+            if (write(event_fd, &one, sizeof(one)) < 0) {
+                perror("eventfd write");
+            }
+        }
+    }
+
+public:
+    static constexpr uint64_t listen_key = 0;
+    static constexpr uint64_t event_key = ~0ULL;
+
+    server(const std::string& path, unsigned threads, size_t max_modules):
+        modules(max_modules)
+    {
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0) {
+            throw std::runtime_error("socket: "s + strerror(errno));
+        }
+        sockaddr_un addr {};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("socket path too long: " + path);
+        }
+        memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        unlink(path.c_str());
+        if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            throw std::runtime_error(path + ": " + strerror(errno));
+        }
+        if (listen(listen_fd, SOMAXCONN) < 0) {
+            throw std::runtime_error("listen: "s + strerror(errno));
+        }
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd < 0 || event_fd < 0) {
+            throw std::runtime_error("epoll/eventfd: "s + strerror(errno));
+        }
+        add(listen_fd, listen_key, EPOLLIN);
+        add(event_fd, event_key, EPOLLIN);
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([this]() {
+                work();
+            });
+        }
+    }
+
+    ~server() {
+        {
+            std::lock_guard lock{jobs_m};
+            stopping = true;
+        }
+        jobs_cv.notify_all();
+        for (std::thread& t: workers) {
+            t.join();
+        }
+        for (auto& [key, c]: connections) {
+            close(c.fd);
+        }
+        close(event_fd);
+        close(epoll_fd);
+        close(listen_fd);
+    }
+
+    void run() {
+        epoll_event events[256];
+        while (true) {
+            int n = epoll_wait(epoll_fd, events, 256, -1);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("epoll_wait: "s + strerror(errno));
+            }
+            for (int i = 0; i < n; i++) {
+                uint64_t key = events[i].data.u64;
+                if (key == listen_key) {
+                    accept_all();
+                } else if (key == event_key) {
+                    drain_completions();
+                } else {
+                    if (events[i].events & EPOLLIN) {
+                        read_from(key);
+                    }
+                    if (events[i].events & EPOLLOUT) {
+                        write_to(key);
+                    }
+                    if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                        close_connection(key);
+                    }
+                }
+            }
+        }
+    }
+};
+
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s SOCKET [WORKER_THREADS] [MAX_MODULES]\n", argv[0]);
+        return 1;
+    }
+    unsigned threads = argc > 2 ? atoi(argv[2]) : std::max(std::thread::hardware_concurrency(), 1u);
+    size_t max_modules = argc > 3 ? atoi(argv[3]) : 1024;
+    //clients going away mid write shouldn't take the daemon with them
+    signal(SIGPIPE, SIG_IGN);
+
+    try {
+        server s{argv[1], std::max(threads, 1u), std::max<size_t>(max_modules, 1)};
+        printf("listening on '%s' with %u workers\n", argv[1], threads);
+        fflush(stdout);
+        s.run();
+    } catch (std::runtime_error &e) {
+        fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,218 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "elfy.hh"
+#include "call-frame.hh"
+#include "unwind.hh"
+#include "expression.hh"
+#include "parallel.hh"
+
+//builds stacks that unwind through randomly chosen rows of the binary's own unwind table
+struct synthetic_corpus {
+    std::vector<std::vector<std::byte>> stacks;
+    std::vector<dwarfy::stack_sample> samples;
+    std::vector<std::vector<uint64_t>> expected;
+
+    synthetic_corpus(const dwarfy::unwind_table& t, uint16_t sp, size_t count, size_t depth, uint64_t seed) {
+        //rows we can fabricate a frame for: CFA is sp+n and the return address is saved relative to it
+        struct candidate {
+            const dwarfy::unwind_row* row;
+            int64_t ra_offset;
+        };
+        std::vector<candidate> candidates;
+        for (const auto& f: t.fdes) {
+            for (size_t i = 0; i < f.rows_count; i++) {
+                const auto& r = t.rows[f.rows_begin + i];
+                uint64_t end = i + 1 < f.rows_count ? t.rows[f.rows_begin + i + 1].address : f.pc_end;
+                if (r.cfa.kind != dwarfy::cfa_rule_kind::register_offset || r.cfa.reg != sp || r.cfa.offset <= 0 || end - r.address < 2 || f.signal_frame) {
+                    continue;
+                }
+                for (size_t j = 0; j < r.rules_count; j++) {
+                    const auto& rule = t.rules[r.rules_begin + j];
+                    if (rule.reg == f.return_address_register && rule.kind == dwarfy::register_rule_kind::offset &&
+                        rule.value < 0 && -rule.value <= r.cfa.offset) {
+                        candidates.push_back({&r, rule.value});
+                    }
+                }
+            }
+        }
+        if (candidates.empty()) {
+            throw std::runtime_error("no usable unwind rows to build a synthetic corpus from");
+        }
+
+        std::mt19937_64 rng(seed);
+        std::uniform_int_distribution<size_t> pick(0, candidates.size() - 1);
+        const uint64_t stack_top = 0x7ffff0000000;
+        stacks.resize(count);
+        expected.resize(count);
+        samples.resize(count);
+        for (size_t s = 0; s < count; s++) {
+            std::vector<candidate> frames;
+            size_t size = 0;
+            for (size_t i = 0; i < depth; i++) {
+                frames.push_back(candidates[pick(rng)]);
+                size += frames.back().row->cfa.offset;
+            }
+            auto& stack = stacks[s];
+            stack.resize(size + 8);
+            uint64_t sp_value = stack_top - stack.size();
+            dwarfy::stack_sample& sample = samples[s];
+            sample.stack_address = sp_value;
+            sample.regs.pc = frames[0].row->address;
+            sample.regs.set(sp, sp_value);
+            expected[s].push_back(sample.regs.pc);
+            for (size_t i = 0; i < frames.size(); i++) {
+                uint64_t cfa = sp_value + frames[i].row->cfa.offset;
+                //the caller's pc is a return address, so unwinding looks up pc - 1
+                uint64_t ra = i + 1 < frames.size() ? frames[i + 1].row->address + 1 : 0;
+                std::memcpy(stack.data() + (cfa + frames[i].ra_offset - sample.stack_address), &ra, sizeof(ra));
+                if (ra != 0) {
+                    expected[s].push_back(ra);
+                }
+                sp_value = cfa;
+            }
+            sample.stack = stack;
+        }
+    }
+};
+
+//samples stopped in rows whose CFA is an expression (x86-64 PLT entries), one per row and a caller
+//that can't be unwound further, so each should unwind to exactly its pc and its return address
+struct expression_corpus {
+    std::vector<std::vector<std::byte>> stacks;
+    std::vector<dwarfy::stack_sample> samples;
+    std::vector<std::vector<uint64_t>> expected;
+
+    expression_corpus(const dwarfy::unwind_table& t, uint16_t sp, size_t address_size) {
+        const uint64_t sp_value = 0x7ffff0000000;
+        for (const auto& f: t.fdes) {
+            for (size_t i = 0; i < f.rows_count; i++) {
+                const auto& r = t.rows[f.rows_begin + i];
+                if (r.cfa.kind != dwarfy::cfa_rule_kind::expression || f.signal_frame) {
+                    continue;
+                }
+                std::optional<int64_t> ra_offset;
+                for (size_t j = 0; j < r.rules_count; j++) {
+                    const auto& rule = t.rules[r.rules_begin + j];
+                    if (rule.reg == f.return_address_register && rule.kind == dwarfy::register_rule_kind::offset) {
+                        ra_offset = rule.value;
+                    }
+                }
+                uint64_t end = i + 1 < f.rows_count ? t.rows[f.rows_begin + i + 1].address : f.pc_end;
+                if (!ra_offset) {
+                    continue;
+                }
+                //every pc of the row, the PLT expression depends on where in the entry the pc is
+                for (uint64_t pc = r.address; pc < end; pc++) {
+                    dwarfy::expression_context context;
+                    context.address_size = address_size;
+                    context.read_register = [&](uint16_t reg) -> std::optional<uint64_t> {
+                        if (reg == sp) {
+                            return sp_value;
+                        }
+                        return reg == f.return_address_register ? std::optional<uint64_t>{pc} : std::nullopt;
+                    };
+                    dwarfy::location l = dwarfy::evaluate_expression(r.cfa.expression, context);
+                    if (l.size() != 1 || l[0].kind != dwarfy::location_kind::memory) {
+                        continue;
+                    }
+                    uint64_t cfa = l[0].value;
+                    if (cfa + *ra_offset < sp_value) {
+                        continue;
+                    }
+                    std::vector<std::byte> stack(cfa + *ra_offset - sp_value + sizeof(uint64_t));
+                    //outside any fde, so unwinding stops after it
+                    uint64_t ra = 1;
+                    std::memcpy(stack.data() + (cfa + *ra_offset - sp_value), &ra, sizeof(ra));
+                    stacks.push_back(std::move(stack));
+                    dwarfy::stack_sample sample;
+                    sample.stack_address = sp_value;
+                    sample.regs.pc = pc;
+                    sample.regs.set(sp, sp_value);
+                    samples.push_back(sample);
+                    expected.push_back({pc, ra});
+                }
+            }
+        }
+        for (size_t i = 0; i < samples.size(); i++) {
+            samples[i].stack = stacks[i];
+        }
+    }
+};
+
+std::vector<std::byte> read_file(const char* filename) {
+    std::ifstream f(filename, std::ios::binary);
+    if (!f) {
+        throw std::runtime_error(filename + ": could not open"s);
+    }
+    std::vector<char> chars{std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+    std::vector<std::byte> bytes(chars.size());
+    std::memcpy(bytes.data(), chars.data(), chars.size());
+    return bytes;
+}
+
+int main(int argc, char *argv[]) {
+    const char* filename = argc > 1 ? argv[1] : "/proc/self/exe";
+    size_t count = argc > 2 ? std::stoul(argv[2]) : 200000;
+    size_t depth = argc > 3 ? std::stoul(argv[3]) : 16;
+
+    try {
+        std::vector<std::byte> data = read_file(filename);
+        elfy::elf e{data};
+
+        auto start = std::chrono::steady_clock::now();
+        dwarfy::unwind_table table{e};
+        auto built = std::chrono::steady_clock::now();
+        printf("unwind table: %zu fdes, %zu rows, %zu rules in %.3f ms\n",
+            table.fdes.size(), table.rows.size(), table.rules.size(),
+            std::chrono::duration<double, std::milli>(built - start).count());
+
+        uint16_t sp = dwarfy::stack_pointer_register(e.machine());
+        synthetic_corpus corpus{table, sp, count, depth, 42};
+
+        for (unsigned threads: {1u, dwarfy::parallel_threads()}) {
+            dwarfy::unwinder u{table, sp};
+            u.max_frames = depth + 1;
+            u.threads = threads;
+            auto begin = std::chrono::steady_clock::now();
+            dwarfy::unwound_stacks result = u.unwind(corpus.samples);
+            auto end = std::chrono::steady_clock::now();
+
+            size_t correct = 0;
+            for (size_t i = 0; i < result.size(); i++) {
+                auto pcs = result[i];
+                if (std::equal(pcs.begin(), pcs.end(), corpus.expected[i].begin(), corpus.expected[i].end())) {
+                    correct++;
+                }
+            }
+            double seconds = std::chrono::duration<double>(end - begin).count();
+            printf("threads %u: %zu samples x %zu frames in %.3f s, %.0f samples/s, %zu/%zu correct\n",
+                threads, count, depth, seconds, count / seconds, correct, count);
+        }
+
+        expression_corpus plt{table, sp, e.ident.bitwidth()};
+        dwarfy::unwinder u{table, e};
+        dwarfy::unwound_stacks result = u.unwind(plt.samples);
+        size_t correct = 0;
+        for (size_t i = 0; i < result.size(); i++) {
+            auto pcs = result[i];
+            if (std::equal(pcs.begin(), pcs.end(), plt.expected[i].begin(), plt.expected[i].end())) {
+                correct++;
+            }
+        }
+        printf("CFA expressions: %zu/%zu samples unwound through\n", correct, result.size());
+        if (correct != result.size()) {
+            return 1;
+        }
+    } catch (std::runtime_error &e) {
+        fprintf(stderr, "error processing file '%s': %s\n", filename, e.what());
+        return 1;
+    }
+    return 0;
+}